@@ -306,6 +306,17 @@ intern int pth_attr_ctrl(int cmd, pth_attr_t a, int op, va_list ap)
             *dst = (a->a_tid != NULL ? TRUE : FALSE);
             break;
         }
+        case PTH_ATTR_STACK_USED: {
+            unsigned int *dst;
+            if (cmd == PTH_ATTR_SET)
+                return pth_error(FALSE, EPERM);
+            dst = va_arg(ap, unsigned int *);
+            if (a->a_tid != NULL)
+                *dst = pth_tcb_stack_used(a->a_tid);
+            else
+                *dst = pth_tcb_prof_max(a->a_name);
+            break;
+        }
         default:
             return pth_error(FALSE, EINVAL);
     }
@@ -66,8 +66,11 @@ int pth_cancel(pth_t thread)
     if (thread->state == PTH_STATE_DEAD)
         return pth_error(FALSE, EPERM);
 
-    /* now mark the thread as cancelled */
+    /* now mark the thread as cancelled (and wake it up
+       if it is waiting, so it can act upon the request) */
     thread->cancelreq = TRUE;
+    if (pth_pqueue_contains(&pth_WQ, thread))
+        pth_sched_wakeup(thread);
 
     /* when cancellation is enabled in async mode we cancel the thread immediately */
     if (   thread->cancelstate & PTH_CANCEL_ENABLE
@@ -84,7 +87,10 @@ int pth_cancel(pth_t thread)
             return pth_error(FALSE, ESRCH);
         if (!pth_pqueue_contains(q, thread))
             return pth_error(FALSE, ESRCH);
-        pth_pqueue_delete(q, thread);
+        if (q == &pth_WQ)
+            pth_sched_wq_delete(thread);
+        else
+            pth_pqueue_delete(q, thread);
 
         /* execute cleanups */
         pth_thread_cleanup(thread);
@@ -99,6 +105,8 @@ int pth_cancel(pth_t thread)
             thread->join_arg = PTH_CANCELED;
             thread->state = PTH_STATE_DEAD;
             pth_pqueue_insert(&pth_DQ, PTH_PRIO_STD, thread);
+            pth_event_tidnotify(thread);
+            pth_event_tidnotify(NULL);
         }
     }
     return TRUE;
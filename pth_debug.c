@@ -83,6 +83,12 @@ intern void pth_dumpstate(FILE *fp)
     fprintf(fp, "+----------------------------------------------------------------------\n");
     fprintf(fp, "| Pth Version: %s\n", PTH_VERSION_STR);
     fprintf(fp, "| Load Average: %.2f\n", pth_loadval);
+    fprintf(fp, "| I/O Multiplexer: %s\n", pth_iomux_name());
+    fprintf(fp, "| Signal Multiplexer: %s\n", pth_sigmux_name());
+#ifdef PTH_URING
+    fprintf(fp, "| I/O Completion: %s\n", pth_uring_name());
+#endif
+    pth_offload_dump(fp);
     pth_dumpqueue(fp, "NEW", &pth_NQ);
     pth_dumpqueue(fp, "READY", &pth_RQ);
     fprintf(fp, "| Thread Queue RUNNING:\n");
@@ -91,6 +97,7 @@ intern void pth_dumpstate(FILE *fp)
     pth_dumpqueue(fp, "WAITING", &pth_WQ);
     pth_dumpqueue(fp, "SUSPENDED", &pth_SQ);
     pth_dumpqueue(fp, "DEAD", &pth_DQ);
+    pth_tcb_prof_dump(fp);
     fprintf(fp, "+----------------------------------------------------------------------\n");
     return;
 }
@@ -34,6 +34,15 @@
    (mainly to workaround va_arg(3) problems below) */
 typedef int (*pth_event_func_t)(void *);
 
+/* event wait node (links an armed event into the waiters of its source) */
+typedef struct pth_evnode_st pth_evnode_t;
+struct pth_evnode_st {
+    pth_ringnode_t en_node;   /* ring linkage (has to be first!) */
+    pth_event_t    en_event;  /* event the node belongs to */
+    int            en_fd;     /* filedescriptor (for I/O events) or signal number */
+    int            en_mask;   /* readiness waited for (for I/O events) */
+};
+
 /* event structure */
 struct pth_event_st {
     struct pth_event_st *ev_next;
@@ -41,9 +50,17 @@ struct pth_event_st {
     pth_status_t ev_status;
     int ev_type;
     int ev_goal;
+    pth_t ev_thread;          /* thread waiting for the event while armed */
+    pth_task_t ev_task;       /* task waiting for the event while armed (or NULL) */
+    pth_evnode_t ev_node;     /* wait node of armed event */
+    pth_evnode_t *ev_nodes;   /* per-filedescriptor (or per-signal) wait nodes */
+    int ev_nnodes;            /* number of per-filedescriptor (or per-signal) wait nodes */
+    int ev_heapidx;           /* position in timer index (or -1) */
+    pth_time_t ev_due;        /* deadline while in timer index */
     union {
         struct { int fd; }                                          FD;
         struct { int *n; int nfd; fd_set *rfds, *wfds, *efds; }     SELECT;
+        struct { int *n; struct pollfd *pfd; nfds_t nfd; }          POLL;
         struct { sigset_t *sigs; int *sig; }                        SIGS;
         struct { pth_time_t tv; }                                   TIME;
         struct { pth_msgport_t mp; }                                MSG;
@@ -112,7 +129,13 @@ pth_event_t pth_event(unsigned long spec, ...)
     }
 
     /* initialize common ingredients */
-    ev->ev_status = PTH_STATUS_PENDING;
+    ev->ev_status  = PTH_STATUS_PENDING;
+    ev->ev_thread  = NULL;
+    ev->ev_task    = NULL;
+    ev->ev_nodes   = NULL;
+    ev->ev_nnodes  = 0;
+    ev->ev_heapidx = -1;
+    ev->ev_node.en_event = NULL;
 
     /* initialize event specific ingredients */
     if (spec & PTH_EVENT_FD) {
@@ -141,6 +164,17 @@ pth_event_t pth_event(unsigned long spec, ...)
         ev->ev_args.SELECT.wfds = wfds;
         ev->ev_args.SELECT.efds = efds;
     }
+    else if (spec & PTH_EVENT_POLL) {
+        /* filedescriptor array poll event */
+        int *n = va_arg(ap, int *);
+        struct pollfd *pfd = va_arg(ap, struct pollfd *);
+        nfds_t nfd = va_arg(ap, nfds_t);
+        ev->ev_type = PTH_EVENT_POLL;
+        ev->ev_goal = (int)(spec & (PTH_UNTIL_OCCURRED));
+        ev->ev_args.POLL.n   = n;
+        ev->ev_args.POLL.pfd = pfd;
+        ev->ev_args.POLL.nfd = nfd;
+    }
     else if (spec & PTH_EVENT_SIGS) {
         /* signal set event */
         sigset_t *sigs = va_arg(ap, sigset_t *);
@@ -168,7 +202,7 @@ pth_event_t pth_event(unsigned long spec, ...)
         /* mutual exclusion lock */
         pth_mutex_t *mutex = va_arg(ap, pth_mutex_t *);
         ev->ev_type = PTH_EVENT_MUTEX;
-        ev->ev_goal = (int)(spec & (PTH_UNTIL_OCCURRED));
+        ev->ev_goal = (int)(spec & (PTH_UNTIL_OCCURRED|PTH_UNTIL_MUTEX_OWNED));
         ev->ev_args.MUTEX.mutex = mutex;
     }
     else if (spec & PTH_EVENT_COND) {
@@ -382,6 +416,261 @@ int pth_event_free(pth_event_t ev, int mode)
     return TRUE;
 }
 
+/* determine the wait queue of the source of a synchronization event */
+static pth_ring_t *pth_event_waitq(pth_event_t ev)
+{
+    if (ev->ev_type == PTH_EVENT_MSG)
+        return &(ev->ev_args.MSG.mp->mp_waitq);
+    else if (ev->ev_type == PTH_EVENT_MUTEX)
+        return &(ev->ev_args.MUTEX.mutex->mx_waitq);
+    else if (ev->ev_type == PTH_EVENT_COND)
+        return &(ev->ev_args.COND.cond->cn_waitq);
+    else if (ev->ev_type == PTH_EVENT_TID) {
+        if (ev->ev_args.TID.tid == NULL)
+            return &pth_DQwaiters;
+        return &(ev->ev_args.TID.tid->waiters);
+    }
+    return NULL;
+}
+
+/* check whether a thread termination event occurred */
+static int pth_event_tid_ready(pth_event_t ev)
+{
+    if (ev->ev_args.TID.tid == NULL)
+        return (pth_pqueue_elements(&pth_DQ) > 0);
+    return (ev->ev_args.TID.tid->state == ev->ev_goal);
+}
+
+/* check whether a synchronization event can occur immediately */
+static int pth_event_sync_ready(pth_event_t ev, pth_t t)
+{
+    pth_cond_t *cond;
+
+    if (ev->ev_type == PTH_EVENT_MSG)
+        return (pth_ring_elements(&(ev->ev_args.MSG.mp->mp_queue)) > 0);
+    else if (ev->ev_type == PTH_EVENT_MUTEX) {
+        if (ev->ev_args.MUTEX.mutex->mx_state & PTH_MUTEX_LOCKED)
+            return FALSE;
+        if (ev->ev_goal & PTH_UNTIL_MUTEX_OWNED)
+            pth_mutex_grant(ev->ev_args.MUTEX.mutex, t);
+        return TRUE;
+    }
+    else if (ev->ev_type == PTH_EVENT_COND) {
+        /* consume a signal which was sent while nobody was waiting */
+        cond = ev->ev_args.COND.cond;
+        if (!(cond->cn_state & PTH_COND_SIGNALED))
+            return FALSE;
+        cond->cn_state &= ~(PTH_COND_SIGNALED);
+        return TRUE;
+    }
+    else if (ev->ev_type == PTH_EVENT_TID)
+        return pth_event_tid_ready(ev);
+    return FALSE;
+}
+
+/* remove the first waiter from the wait queue of a synchronization
+   object and set the status of its event (the caller has to wake up
+   the returned event's waiter) */
+intern pth_event_t pth_event_waitq_pop(pth_ring_t *waitq, pth_status_t status)
+{
+    pth_evnode_t *en;
+    pth_event_t ev;
+
+    if ((en = (pth_evnode_t *)pth_ring_pop(waitq)) == NULL)
+        return NULL;
+    ev = en->en_event;
+    en->en_event = NULL;
+    ev->ev_status = status;
+    return ev;
+}
+
+/*
+ * Let the events waiting for a thread know that it changed its state
+ * (or, for a NULL thread, that a thread entered the dead queue). A
+ * dead thread never changes its state again, so events waiting for
+ * another state of it fail then.
+ */
+intern void pth_event_tidnotify(pth_t t)
+{
+    pth_ring_t *waitq;
+    pth_ringnode_t *rn, *rnn;
+    pth_event_t ev;
+    pth_status_t status;
+
+    waitq = (t != NULL ? &(t->waiters) : &pth_DQwaiters);
+    if ((rn = pth_ring_first(waitq)) == NULL)
+        return;
+    do {
+        rnn = pth_ring_next(waitq, rn);
+        ev = ((pth_evnode_t *)rn)->en_event;
+        if (pth_event_tid_ready(ev))
+            status = PTH_STATUS_OCCURRED;
+        else if (t != NULL && t->state == PTH_STATE_DEAD)
+            status = PTH_STATUS_FAILED;
+        else
+            continue;
+        pth_ring_delete(waitq, rn);
+        ev->ev_node.en_event = NULL;
+        ev->ev_status = status;
+        pth_event_wakeup(ev);
+    } while ((rn = rnn) != NULL);
+    return;
+}
+
+/* let the waiter of an armed event know that the event occurred or
+   failed: a thread is queued for being moved to the ready queue and a
+   task is queued for dispatching */
+intern void pth_event_wakeup(pth_event_t ev)
+{
+    if (ev->ev_task != NULL)
+        pth_task_wakeup(ev->ev_task);
+    else
+        pth_sched_wakeup(ev->ev_thread);
+    return;
+}
+
+/* the same, but move a waiting thread to the ready queue immediately */
+intern void pth_event_ready(pth_event_t ev)
+{
+    if (ev->ev_task != NULL)
+        pth_task_wakeup(ev->ev_task);
+    else
+        pth_sched_ready(ev->ev_thread);
+    return;
+}
+
+/* an event occurred or failed already on arming it, so it is not
+   registered with its source and its waiter is woken up immediately */
+static void pth_event_armed(pth_event_t ev, pth_status_t status)
+{
+    pth_t t;
+    pth_task_t task;
+
+    t = ev->ev_thread;
+    task = ev->ev_task;
+    ev->ev_thread = NULL;
+    ev->ev_task = NULL;
+    ev->ev_status = status;
+    if (task != NULL)
+        pth_task_wakeup(task);
+    else
+        pth_sched_wakeup(t);
+    return;
+}
+
+/* arm an event, i.e. register it with its source for a waiting thread */
+intern void pth_event_arm(pth_event_t ev, pth_t t)
+{
+    if (ev->ev_status != PTH_STATUS_PENDING || ev->ev_thread != NULL)
+        return;
+    ev->ev_thread = t;
+    if (   ev->ev_type == PTH_EVENT_FD || ev->ev_type == PTH_EVENT_SELECT
+        || ev->ev_type == PTH_EVENT_POLL) {
+        /* filedescriptor interest is kept by the I/O multiplexer */
+        if (!pth_iomux_arm(ev)) {
+            pth_event_armed(ev, PTH_STATUS_FAILED);
+        }
+    }
+    else if (ev->ev_type == PTH_EVENT_SIGS) {
+        /* signal interest is kept by the signal multiplexer */
+        if (!pth_sigmux_arm(ev)) {
+            pth_event_armed(ev, PTH_STATUS_FAILED);
+        }
+    }
+    else if (ev->ev_type == PTH_EVENT_TIME) {
+        /* timeouts are kept by the timer index */
+        pth_time_set(&(ev->ev_due), &(ev->ev_args.TIME.tv));
+        if (!pth_timer_insert(ev)) {
+            pth_event_armed(ev, PTH_STATUS_FAILED);
+        }
+    }
+    else if (ev->ev_type == PTH_EVENT_FUNC) {
+        /* the check interval is kept by the timer index
+           (where it elapses right away for the first check) */
+        pth_time_set(&(ev->ev_due), PTH_TIME_NOW);
+        if (!pth_timer_insert(ev)) {
+            pth_event_armed(ev, PTH_STATUS_FAILED);
+        }
+    }
+    else if (   ev->ev_type == PTH_EVENT_MSG
+             || ev->ev_type == PTH_EVENT_MUTEX
+             || ev->ev_type == PTH_EVENT_COND
+             || ev->ev_type == PTH_EVENT_TID) {
+        /* synchronization objects (and threads) keep their own FIFO of waiters */
+        if (pth_event_sync_ready(ev, t)) {
+            pth_event_armed(ev, PTH_STATUS_OCCURRED);
+        }
+        else {
+            ev->ev_node.en_event = ev;
+            pth_ring_append(pth_event_waitq(ev), &(ev->ev_node.en_node));
+        }
+    }
+    return;
+}
+
+/* arm an event for a waiting task (the scheduler thread stands in
+   as the waiting thread, which can never own a mutex this way) */
+intern void pth_event_arm_task(pth_event_t ev, pth_task_t task)
+{
+    if (ev->ev_status != PTH_STATUS_PENDING || ev->ev_thread != NULL)
+        return;
+    ev->ev_task = task;
+    pth_event_arm(ev, pth_sched);
+    return;
+}
+
+/* disarm an event, i.e. unregister it from its source */
+intern void pth_event_disarm(pth_event_t ev)
+{
+    pth_ring_t *waitq;
+
+    if (ev->ev_thread == NULL)
+        return;
+    if (   ev->ev_type == PTH_EVENT_FD || ev->ev_type == PTH_EVENT_SELECT
+        || ev->ev_type == PTH_EVENT_POLL)
+        pth_iomux_disarm(ev);
+    else if (ev->ev_type == PTH_EVENT_SIGS)
+        pth_sigmux_disarm(ev);
+    else if (ev->ev_type == PTH_EVENT_TIME || ev->ev_type == PTH_EVENT_FUNC)
+        pth_timer_delete(ev);
+    else if (ev->ev_node.en_event != NULL && (waitq = pth_event_waitq(ev)) != NULL) {
+        pth_ring_delete(waitq, &(ev->ev_node.en_node));
+        ev->ev_node.en_event = NULL;
+    }
+    ev->ev_thread = NULL;
+    ev->ev_task = NULL;
+    return;
+}
+
+/*
+ * Let the current thread wait until the party it handed a request to
+ * wakes it up on completion (with pth_sched_wakeup()) or one of the
+ * optional extra events occurred. Unlike pth_wait(3) this is no
+ * cancellation point. Returns whether one of the extra events occurred.
+ */
+intern int pth_wait_wakeup(pth_event_t ev_extra)
+{
+    pth_event_t ev;
+
+    if ((ev = ev_extra) != NULL) {
+        do {
+            ev->ev_status = PTH_STATUS_PENDING;
+        } while ((ev = ev->ev_next) != ev_extra);
+    }
+    pth_current->events = ev_extra;
+    pth_current->state = PTH_STATE_WAITING;
+    pth_event_tidnotify(pth_current);
+    pth_yield(NULL);
+    pth_current->events = NULL;
+    if ((ev = ev_extra) != NULL) {
+        do {
+            if (ev->ev_status != PTH_STATUS_PENDING)
+                return TRUE;
+        } while ((ev = ev->ev_next) != ev_extra);
+    }
+    return FALSE;
+}
+
 /* wait for one or more events */
 int pth_wait(pth_event_t ev_ring)
 {
@@ -407,6 +696,7 @@ int pth_wait(pth_event_t ev_ring)
     /* move thread into waiting state
        and transfer control to scheduler */
     pth_current->state = PTH_STATE_WAITING;
+    pth_event_tidnotify(pth_current);
     pth_yield(NULL);
 
     /* check for cancellation */
@@ -89,6 +89,15 @@ pid_t pth_fork(void)
         /* kick out all threads except for the current one and the scheduler */
         pth_scheduler_drop();
 
+        /* do not share the kernel side of the multiplexers with the parent
+           (and forget the offloading workers, which are not inherited) */
+        pth_offload_atfork();
+#ifdef PTH_URING
+        pth_uring_atfork();
+#endif
+        pth_sigmux_atfork();
+        pth_iomux_atfork();
+
         /* run child handlers in FIFO order */
         for (i = 0; i <= pth_atfork_idx-1; i++)
             if (pth_atfork_list[i].child != NULL)
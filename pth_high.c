@@ -33,8 +33,14 @@
  *  block, these variants let only the thread sleep.
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* for preadv2(2) */
+#endif
 #include "pth_p.h"
 
+/* whether I/O is attempted before polling (PTH_CTRL_IOFIRST) */
+intern int pth_high_iofirst = FALSE;
+
 /* Pth variant of nanosleep(2) */
 int pth_nanosleep(const struct timespec *rqtp, struct timespec *rmtp)
 {
@@ -130,13 +136,9 @@ int pth_sigmask(int how, const sigset_t *set, sigset_t *oset)
 {
     int rv;
 
-    /* change the explicitly remembered signal mask copy for the scheduler */
-    if (set != NULL)
-        pth_sc(sigprocmask)(how, &(pth_current->mctx.sigs), NULL);
-
-    /* change the real (per-thread saved/restored) signal mask */
-    rv = pth_sc(sigprocmask)(how, set, oset);
-
+    /* change the signal mask of the machine context of the current thread */
+    if ((rv = pth_mctx_sigmask(&pth_current->mctx, how, set, oset)) == 0 && set != NULL)
+        pth_current->sigmaskown = TRUE;
     return rv;
 }
 
@@ -238,7 +240,7 @@ int pth_system(const char *cmd)
     /* block SIGCHLD signal */
     sigemptyset(&ss_block);
     sigaddset(&ss_block, SIGCHLD);
-    pth_sc(sigprocmask)(SIG_BLOCK, &ss_block, &ss_old);
+    pth_sigmask(SIG_BLOCK, &ss_block, &ss_old);
 
     /* fork the current process */
     pstat = -1;
@@ -270,7 +272,7 @@ int pth_system(const char *cmd)
     /* restore original signal dispositions and execute the command */
     sigaction(SIGINT,  &sa_int,  NULL);
     sigaction(SIGQUIT, &sa_quit, NULL);
-    pth_sc(sigprocmask)(SIG_SETMASK, &ss_old, NULL);
+    pth_sigmask(SIG_SETMASK, &ss_old, NULL);
 
     /* return error or child process result code */
     return (pid == -1 ? -1 : pstat);
@@ -442,14 +444,14 @@ int pth_pselect(int nfds, fd_set *rfds, fd_set *wfds, fd_set *efds,
 
     /* optionally set signal mask */
     if (mask != NULL)
-        if (pth_sc(sigprocmask)(SIG_SETMASK, mask, &omask) < 0)
+        if (pth_sigmask(SIG_SETMASK, mask, &omask) < 0)
             return pth_error(-1, errno);
 
     rv = pth_select(nfds, rfds, wfds, efds, tvp);
 
     /* optionally set signal mask */
     if (mask != NULL)
-        pth_shield { pth_sc(sigprocmask)(SIG_SETMASK, &omask, NULL); }
+        pth_shield { pth_sigmask(SIG_SETMASK, &omask, NULL); }
 
     return rv;
 }
@@ -460,131 +462,77 @@ int pth_poll(struct pollfd *pfd, nfds_t nfd, int timeout)
     return pth_poll_ev(pfd, nfd, timeout, NULL);
 }
 
-/* Pth variant of poll(2) with extra events:
-   NOTICE: THIS HAS TO BE BASED ON pth_select(2) BECAUSE
-           INTERNALLY THE SCHEDULER IS ONLY select(2) BASED!! */
+/* Pth variant of poll(2) with extra events */
 int pth_poll_ev(struct pollfd *pfd, nfds_t nfd, int timeout, pth_event_t ev_extra)
 {
-    fd_set rfds, wfds, efds, xfds;
-    struct timeval tv, *ptv;
-    int maxfd, rc, n;
-    unsigned int i;
-    char data[64];
+    pth_event_t ev;
+    pth_event_t ev_poll;
+    pth_event_t ev_timeout;
+    static pth_key_t ev_key_poll    = PTH_KEY_INIT;
+    static pth_key_t ev_key_timeout = PTH_KEY_INIT;
+    nfds_t i;
+    int rc;
 
     pth_implicit_init();
     pth_debug2("pth_poll_ev: called from thread \"%s\"", pth_current->name);
 
     /* argument sanity checks */
-    if (pfd == NULL)
+    if (pfd == NULL && nfd > 0)
         return pth_error(-1, EFAULT);
-    if (nfd < 0 || nfd > FD_SETSIZE)
+    if (timeout < 0 && timeout != INFTIM /* (-1) */)
         return pth_error(-1, EINVAL);
 
-    /* convert timeout number into a timeval structure */
-    ptv = &tv;
-    if (timeout == 0) {
-        /* return immediately */
-        ptv->tv_sec  = 0;
-        ptv->tv_usec = 0;
-    }
-    else if (timeout == INFTIM /* (-1) */) {
-        /* wait forever */
-        ptv = NULL;
-    }
-    else if (timeout > 0) {
-        /* return after timeout */
-        ptv->tv_sec  = (timeout / 1000);
-        ptv->tv_usec = (timeout % 1000) * 1000;
-    }
-    else
-        return pth_error(-1, EINVAL);
+#if !PTH_FAKE_POLL
+    /* now directly poll the filedescriptors to avoid unnecessary
+       (and resource consuming because of context switches, etc) event
+       handling through the scheduler. This also determines the
+       conditions as reported by the kernel, including the invalid
+       filedescriptors, hangups and errors. */
+    while ((rc = pth_sc(poll)(pfd, nfd, 0)) < 0
+           && errno == EINTR) ;
+    if (rc < 0)
+        /* pass-through immediate error */
+        return pth_error(-1, errno);
+    else if (rc > 0 || timeout == 0)
+        /* pass-through immediate success */
+        return rc;
+#else
+    for (i = 0; i < nfd; i++)
+        pfd[i].revents = 0;
+#endif
 
-    /* create fd sets and determine max fd */
-    maxfd = -1;
-    FD_ZERO(&rfds);
-    FD_ZERO(&wfds);
-    FD_ZERO(&efds);
-    FD_ZERO(&xfds);
-    for (i = 0; i < nfd; i++) {
-        /* convert into fd_sets but remember that BSD select(2) says
-           "the only exceptional condition detectable is out-of-band
-           data received on a socket", hence we push POLLWRBAND events
-           onto wfds instead of efds. Additionally, remember invalid
-           filedescriptors in an extra fd_set xfds. */
-        if (!pth_util_fd_valid(pfd[i].fd)) {
-            FD_SET(pfd[i].fd, &xfds);
-            continue;
-        }
-        if (pfd[i].events & (POLLIN|POLLRDNORM))
-            FD_SET(pfd[i].fd, &rfds);
-        if (pfd[i].events & (POLLOUT|POLLWRNORM|POLLWRBAND))
-            FD_SET(pfd[i].fd, &wfds);
-        if (pfd[i].events & (POLLPRI|POLLRDBAND))
-            FD_SET(pfd[i].fd, &efds);
-        if (   pfd[i].fd >= maxfd
-            && (pfd[i].events & (POLLIN|POLLOUT|POLLPRI|
-                                 POLLRDNORM|POLLRDBAND|
-                                 POLLWRNORM|POLLWRBAND)))
-            maxfd = pfd[i].fd;
-    }
-
-    /* examine fd sets with pth_select(3) */
-    rc = -1;
-    if (maxfd != -1) {
-        rc = pth_select_ev(maxfd+1, &rfds, &wfds, &efds, ptv, ev_extra);
-        if (rc < 0)
-            return pth_error(-1, errno);
-        else if (rc == 0)
-            return 0;
+    /* suspend current thread until one filedescriptor is ready
+       or the timeout occurred (the interest is fed into the I/O
+       multiplexer of the scheduler directly, which also delivers
+       the conditions into the array) */
+    rc = 0;
+    ev = ev_poll = pth_event(PTH_EVENT_POLL|PTH_MODE_STATIC,
+                             &ev_key_poll, &rc, pfd, nfd);
+    ev_timeout = NULL;
+    if (timeout != INFTIM) {
+        ev_timeout = pth_event(PTH_EVENT_TIME|PTH_MODE_STATIC, &ev_key_timeout,
+                               pth_timeout(timeout / 1000, (timeout % 1000) * 1000));
+        pth_event_concat(ev, ev_timeout, NULL);
     }
+    if (ev_extra != NULL)
+        pth_event_concat(ev, ev_extra, NULL);
+    pth_wait(ev);
+    if (ev_extra != NULL)
+        pth_event_isolate(ev_extra);
+    if (ev_timeout != NULL)
+        pth_event_isolate(ev_timeout);
 
-    /* POSIX.1-2001/SUSv3 compliant result establishment */
-    n = 0;
-    for (i = 0; i < nfd; i++) {
+    /* poll return code semantics */
+    if (pth_event_status(ev_poll) == PTH_STATUS_FAILED)
+        return pth_error(-1, EINVAL);
+    if (pth_event_status(ev_poll) == PTH_STATUS_OCCURRED)
+        return rc;
+    for (i = 0; i < nfd; i++)
         pfd[i].revents = 0;
-        if (FD_ISSET(pfd[i].fd, &xfds)) {
-            if (pfd[i].fd >= 0) {
-                pfd[i].revents |= POLLNVAL;
-                n++;
-            }
-            continue;
-        }
-        if (maxfd == -1)
-            continue;
-        if (FD_ISSET(pfd[i].fd, &rfds)) {
-            if (pfd[i].events & POLLIN)
-                pfd[i].revents |= POLLIN;
-            if (pfd[i].events & POLLRDNORM)
-                pfd[i].revents |= POLLRDNORM;
-            n++;
-            /* support for POLLHUP */
-            if (   recv(pfd[i].fd, data, sizeof(data), MSG_PEEK) == -1
-                && (   errno == ESHUTDOWN    || errno == ECONNRESET
-                    || errno == ECONNABORTED || errno == ENETRESET    )) {
-                pfd[i].revents &= ~(POLLIN);
-                pfd[i].revents &= ~(POLLRDNORM);
-                pfd[i].revents |= POLLHUP;
-            }
-        }
-        else if (FD_ISSET(pfd[i].fd, &wfds)) {
-            if (pfd[i].events & POLLOUT)
-                pfd[i].revents |= POLLOUT;
-            if (pfd[i].events & POLLWRNORM)
-                pfd[i].revents |= POLLWRNORM;
-            if (pfd[i].events & POLLWRBAND)
-                pfd[i].revents |= POLLWRBAND;
-            n++;
-        }
-        else if (FD_ISSET(pfd[i].fd, &efds)) {
-            if (pfd[i].events & POLLPRI)
-                pfd[i].revents |= POLLPRI;
-            if (pfd[i].events & POLLRDBAND)
-                pfd[i].revents |= POLLRDBAND;
-            n++;
-        }
-    }
-
-    return n;
+    if (   ev_timeout != NULL
+        && pth_event_status(ev_timeout) == PTH_STATUS_OCCURRED)
+        return 0;
+    return pth_error(-1, EINTR);
 }
 
 /* Pth variant of connect(2) */
@@ -601,6 +549,9 @@ int pth_connect_ev(int s, const struct sockaddr *addr, socklen_t addrlen, pth_ev
     int rv, err;
     socklen_t errlen;
     int fdmode;
+#ifdef PTH_URING
+    ssize_t rc;
+#endif
 
     pth_implicit_init();
     pth_debug2("pth_connect_ev: enter from thread \"%s\"", pth_current->name);
@@ -609,6 +560,18 @@ int pth_connect_ev(int s, const struct sockaddr *addr, socklen_t addrlen, pth_ev
     if (!pth_util_fd_valid(s))
         return pth_error(-1, EBADF);
 
+#ifdef PTH_URING
+    /* let the kernel perform the connect on a blocking filedescriptor
+       through io_uring(7), so the thread just waits for its completion */
+    if (   pth_uring_usable(IORING_OP_CONNECT) && !pth_iomux_pinned(s)
+        && pth_fdmode(s, PTH_FDMODE_POLL) == PTH_FDMODE_BLOCK
+        && pth_uring_io(&rc, IORING_OP_CONNECT, s, (void *)addr, 0,
+                        (unsigned long long)addrlen, 0, ev_extra)) {
+        pth_debug2("pth_connect_ev: leave to thread \"%s\"", pth_current->name);
+        return (int)rc;
+    }
+#endif
+
     /* force filedescriptor into non-blocking mode */
     if ((fdmode = pth_fdmode(s, PTH_FDMODE_NONBLOCK)) == PTH_FDMODE_ERROR)
         return pth_error(-1, EBADF);
@@ -627,6 +590,7 @@ int pth_connect_ev(int s, const struct sockaddr *addr, socklen_t addrlen, pth_ev
             return pth_error(-1, errno);
         if (ev_extra != NULL)
             pth_event_concat(ev, ev_extra, NULL);
+        pth_iomux_uncache(s, PTH_UNTIL_FD_WRITEABLE);
         pth_wait(ev);
         if (ev_extra != NULL) {
             pth_event_isolate(ev);
@@ -658,6 +622,9 @@ int pth_accept_ev(int s, struct sockaddr *addr, socklen_t *addrlen, pth_event_t
     static pth_key_t ev_key = PTH_KEY_INIT;
     int fdmode;
     int rv;
+#ifdef PTH_URING
+    ssize_t rc;
+#endif
 
     pth_implicit_init();
     pth_debug2("pth_accept_ev: enter from thread \"%s\"", pth_current->name);
@@ -666,6 +633,20 @@ int pth_accept_ev(int s, struct sockaddr *addr, socklen_t *addrlen, pth_event_t
     if (!pth_util_fd_valid(s))
         return pth_error(-1, EBADF);
 
+#ifdef PTH_URING
+    /* let the kernel perform the accept on a blocking filedescriptor
+       through io_uring(7), so the thread just waits for its completion */
+    if (   pth_uring_usable(IORING_OP_ACCEPT) && !pth_iomux_pinned(s)
+        && pth_fdmode(s, PTH_FDMODE_POLL) == PTH_FDMODE_BLOCK
+        && pth_uring_io(&rc, IORING_OP_ACCEPT, s, (void *)addr, 0,
+                        (unsigned long long)(unsigned long)addrlen, 0, ev_extra)) {
+        if (rc >= 0)
+            pth_fdmode_forget((int)rc, FALSE);
+        pth_debug2("pth_accept_ev: leave to thread \"%s\"", pth_current->name);
+        return (int)rc;
+    }
+#endif
+
     /* force filedescriptor into non-blocking mode */
     if ((fdmode = pth_fdmode(s, PTH_FDMODE_NONBLOCK)) == PTH_FDMODE_ERROR)
         return pth_error(-1, EBADF);
@@ -683,6 +664,7 @@ int pth_accept_ev(int s, struct sockaddr *addr, socklen_t *addrlen, pth_event_t
                 pth_event_concat(ev, ev_extra, NULL);
         }
         /* wait until accept has a chance */
+        pth_iomux_uncache(s, PTH_UNTIL_FD_READABLE);
         pth_wait(ev);
         /* check for the extra events */
         if (ev_extra != NULL) {
@@ -697,14 +679,86 @@ int pth_accept_ev(int s, struct sockaddr *addr, socklen_t *addrlen, pth_event_t
     /* restore filedescriptor mode */
     pth_shield {
         pth_fdmode(s, fdmode);
-        if (rv != -1)
+        if (rv != -1) {
+            pth_fdmode_forget(rv, FALSE);
             pth_fdmode(rv, fdmode);
+        }
     }
 
     pth_debug2("pth_accept_ev: leave to thread \"%s\"", pth_current->name);
     return rv;
 }
 
+/* wait until a pinned filedescriptor is signalled ready again */
+intern int pth_high_pinwait(int fd, int goal, pth_key_t *ev_key, pth_event_t ev_extra)
+{
+    pth_event_t ev;
+
+    /* the cached readiness turned out to be outdated */
+    pth_iomux_uncache(fd, goal);
+
+    /* let thread sleep until the next edge or the extra event occurs */
+    ev = pth_event(PTH_EVENT_FD|goal|PTH_MODE_STATIC, ev_key, fd);
+    if (ev_extra != NULL)
+        pth_event_concat(ev, ev_extra, NULL);
+    pth_wait(ev);
+    if (ev_extra != NULL)
+        pth_event_isolate(ev);
+    if (pth_event_status(ev) == PTH_STATUS_FAILED)
+        return pth_error(FALSE, EBADF);
+    if (pth_event_status(ev) != PTH_STATUS_OCCURRED)
+        return pth_error(FALSE, EINTR);
+    return TRUE;
+}
+
+/* attempt a read from a filedescriptor in blocking mode without blocking:
+   returns the result of the read or -2 if this is not possible */
+intern ssize_t pth_high_tryreadv(int fd, const struct iovec *iov, int iovcnt)
+{
+    ssize_t n;
+
+    /* a filedescriptor kept in non-blocking mode can be read directly */
+    if (pth_fdmode_kept(fd)) {
+#if PTH_FAKE_RWV
+        while ((n = pth_readv_faked(fd, iov, iovcnt)) < 0
+               && errno == EINTR) ;
+#else
+        while ((n = pth_sc(readv)(fd, iov, iovcnt)) < 0
+               && errno == EINTR) ;
+#endif
+        return n;
+    }
+
+#ifdef RWF_NOWAIT
+    /* sockets and pipes can be read without switching their mode,
+       but not all filedescriptors support this (e.g. terminals) */
+    while ((n = preadv2(fd, iov, iovcnt, -1, RWF_NOWAIT)) < 0
+           && errno == EINTR) ;
+    if (n >= 0 || (errno != EOPNOTSUPP && errno != ENOSYS && errno != EINVAL))
+        return n;
+#endif
+    return -2;
+}
+
+/* attempt a receive from a socket in blocking mode without blocking:
+   returns the result of the receive or -2 if this is not possible */
+intern ssize_t pth_high_tryrecvfrom(int fd, void *buf, size_t nbytes, int flags,
+                                    struct sockaddr *from, socklen_t *fromlen)
+{
+    ssize_t n;
+
+    if (!pth_fdmode_kept(fd)) {
+#ifdef MSG_DONTWAIT
+        flags |= MSG_DONTWAIT;
+#else
+        return -2;
+#endif
+    }
+    while ((n = pth_sc(recvfrom)(fd, buf, nbytes, flags, from, fromlen)) < 0
+           && errno == EINTR) ;
+    return n;
+}
+
 /* Pth variant of read(2) */
 ssize_t pth_read(int fd, void *buf, size_t nbytes)
 {
@@ -714,12 +768,15 @@ ssize_t pth_read(int fd, void *buf, size_t nbytes)
 /* Pth variant of read(2) with extra event(s) */
 ssize_t pth_read_ev(int fd, void *buf, size_t nbytes, pth_event_t ev_extra)
 {
-    struct timeval delay;
     pth_event_t ev;
     static pth_key_t ev_key = PTH_KEY_INIT;
-    fd_set fds;
+    pth_offload_job_t job;
+    struct iovec iov;
     int fdmode;
     int n;
+#ifdef PTH_URING
+    ssize_t rv;
+#endif
 
     pth_implicit_init();
     pth_debug2("pth_read_ev: enter from thread \"%s\"", pth_current->name);
@@ -734,20 +791,74 @@ ssize_t pth_read_ev(int fd, void *buf, size_t nbytes, pth_event_t ev_extra)
     if ((fdmode = pth_fdmode(fd, PTH_FDMODE_POLL)) == PTH_FDMODE_ERROR)
         return pth_error(-1, EBADF);
 
+#ifdef PTH_URING
+    /* let the kernel perform the read on a blocking filedescriptor
+       through io_uring(7), so the thread just waits for its completion */
+    if (   fdmode == PTH_FDMODE_BLOCK && !pth_iomux_pinned(fd)
+        && pth_uring_io(&rv, IORING_OP_READ, fd, buf, nbytes,
+                        (unsigned long long)-1, 0, ev_extra)) {
+        pth_debug2("pth_read_ev: leave to thread \"%s\"", pth_current->name);
+        return rv;
+    }
+#endif
+
+    /* regular files and block devices are always readable, so a read
+       from a slow disk would block the whole process: let a worker
+       perform the read, so the thread just waits for its completion */
+    if (pth_offload_file(fd)) {
+        job.op  = PTH_OFFLOAD_READ;
+        job.fd  = fd;
+        job.buf = buf;
+        job.len = nbytes;
+        job.off = (off_t)-1;
+        if (pth_offload_submit(&job, ev_extra)) {
+            pth_debug2("pth_read_ev: leave to thread \"%s\"", pth_current->name);
+            return (ssize_t)job.res;
+        }
+    }
+
+    /* pinned filedescriptors are permanently in non-blocking mode and
+       have their readiness cached, so the thread has to sleep only if the
+       cache is empty or the filedescriptor is actually found exhausted */
+    if (fdmode == PTH_FDMODE_BLOCK && pth_iomux_pinned(fd)) {
+        if (   !pth_iomux_cached(fd, PTH_UNTIL_FD_READABLE)
+            && !pth_high_pinwait(fd, PTH_UNTIL_FD_READABLE, &ev_key, ev_extra))
+            return -1;
+        while (   (n = pth_sc(read)(fd, buf, nbytes)) < 0
+               && (   errno == EINTR
+                   || (   (errno == EAGAIN || errno == EWOULDBLOCK)
+                       && pth_high_pinwait(fd, PTH_UNTIL_FD_READABLE, &ev_key, ev_extra)))) ;
+        pth_debug2("pth_read_ev: leave to thread \"%s\"", pth_current->name);
+        return n;
+    }
+
+    /* optimistically attempt the read first, as on a busy filedescriptor
+       the data is usually already there, so polling would be wasted */
+    n = -2;
+    if (fdmode == PTH_FDMODE_BLOCK && pth_high_iofirst) {
+        iov.iov_base = buf;
+        iov.iov_len  = nbytes;
+        n = pth_high_tryreadv(fd, &iov, 1);
+        if (n >= 0 || (n == -1 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+            pth_debug2("pth_read_ev: leave to thread \"%s\"", pth_current->name);
+            return n;
+        }
+    }
+
     /* poll filedescriptor if not already in non-blocking operation */
     if (fdmode == PTH_FDMODE_BLOCK) {
 
         /* now directly poll filedescriptor for readability
            to avoid unneccessary (and resource consuming because of context
-           switches, etc) event handling through the scheduler */
-        FD_ZERO(&fds);
-        FD_SET(fd, &fds);
-        delay.tv_sec  = 0;
-        delay.tv_usec = 0;
-        while ((n = pth_sc(select)(fd+1, &fds, NULL, NULL, &delay)) < 0
-               && errno == EINTR) ;
-        if (n < 0 && (errno == EINVAL || errno == EBADF))
-            return pth_error(-1, errno);
+           switches, etc) event handling through the scheduler
+           (unless the read attempt already found it exhausted) */
+        if (n == -2) {
+            n = pth_util_fd_poll(fd, PTH_UNTIL_FD_READABLE);
+            if (n < 0 && (errno == EINVAL || errno == EBADF))
+                return pth_error(-1, errno);
+        }
+        else
+            n = 0;
 
         /* if filedescriptor is still not readable,
            let thread sleep until it is or the extra event occurs */
@@ -785,10 +896,9 @@ ssize_t pth_write(int fd, const void *buf, size_t nbytes)
 /* Pth variant of write(2) with extra event(s) */
 ssize_t pth_write_ev(int fd, const void *buf, size_t nbytes, pth_event_t ev_extra)
 {
-    struct timeval delay;
     pth_event_t ev;
     static pth_key_t ev_key = PTH_KEY_INIT;
-    fd_set fds;
+    pth_offload_job_t job;
     int fdmode;
     ssize_t rv;
     ssize_t s;
@@ -803,6 +913,48 @@ ssize_t pth_write_ev(int fd, const void *buf, size_t nbytes, pth_event_t ev_extr
     if (!pth_util_fd_valid(fd))
         return pth_error(-1, EBADF);
 
+#ifdef PTH_URING
+    /* let the kernel perform the write on a blocking filedescriptor
+       through io_uring(7), so the thread just waits for its completion
+       (iterating on partial writes to mimic the blocking write(2)) */
+    if (   pth_uring_usable(IORING_OP_WRITE) && !pth_iomux_pinned(fd)
+        && pth_fdmode(fd, PTH_FDMODE_POLL) == PTH_FDMODE_BLOCK) {
+        rv = 0;
+        n = 0;
+        while (pth_uring_io(&s, IORING_OP_WRITE, fd, (void *)buf, nbytes,
+                            (unsigned long long)-1, 0, ev_extra)) {
+            n++;
+            if (s > 0)
+                rv += s;
+            if (s <= 0 || s >= (ssize_t)nbytes)
+                break;
+            nbytes -= s;
+            buf = (void *)((char *)buf + s);
+        }
+        if (n > 0) {
+            if (s < 0 && rv == 0)
+                rv = -1;
+            pth_debug2("pth_write_ev: leave to thread \"%s\"", pth_current->name);
+            return rv;
+        }
+    }
+#endif
+
+    /* regular files and block devices are always writeable, so a write
+       to a slow disk would block the whole process: let a worker
+       perform the write, so the thread just waits for its completion */
+    if (pth_offload_file(fd)) {
+        job.op  = PTH_OFFLOAD_WRITE;
+        job.fd  = fd;
+        job.buf = (void *)buf;
+        job.len = nbytes;
+        job.off = (off_t)-1;
+        if (pth_offload_submit(&job, ev_extra)) {
+            pth_debug2("pth_write_ev: leave to thread \"%s\"", pth_current->name);
+            return (ssize_t)job.res;
+        }
+    }
+
     /* force filedescriptor into non-blocking mode */
     if ((fdmode = pth_fdmode(fd, PTH_FDMODE_NONBLOCK)) == PTH_FDMODE_ERROR)
         return pth_error(-1, EBADF);
@@ -812,13 +964,9 @@ ssize_t pth_write_ev(int fd, const void *buf, size_t nbytes, pth_event_t ev_extr
 
         /* now directly poll filedescriptor for writeability
            to avoid unneccessary (and resource consuming because of context
-           switches, etc) event handling through the scheduler */
-        FD_ZERO(&fds);
-        FD_SET(fd, &fds);
-        delay.tv_sec  = 0;
-        delay.tv_usec = 0;
-        while ((n = pth_sc(select)(fd+1, NULL, &fds, NULL, &delay)) < 0
-               && errno == EINTR) ;
+           switches, etc) event handling through the scheduler
+           (unless the write is optimistically attempted first) */
+        n = (pth_high_iofirst ? 1 : pth_util_fd_poll(fd, PTH_UNTIL_FD_WRITEABLE));
         if (n < 0 && (errno == EINVAL || errno == EBADF))
             return pth_error(-1, errno);
 
@@ -852,6 +1000,17 @@ ssize_t pth_write_ev(int fd, const void *buf, size_t nbytes, pth_event_t ev_extr
             if (s > 0 && s < (ssize_t)nbytes) {
                 nbytes -= s;
                 buf = (void *)((char *)buf + s);
+                pth_iomux_uncache(fd, PTH_UNTIL_FD_WRITEABLE);
+                n = 0;
+                continue;
+            }
+
+            /* a pinned filedescriptor can be found exhausted although
+               its cached readiness claimed the opposite, and so can one
+               written optimistically without polling, so wait again */
+            if (   s < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)
+                && (pth_iomux_pinned(fd) || pth_high_iofirst)) {
+                pth_iomux_uncache(fd, PTH_UNTIL_FD_WRITEABLE);
                 n = 0;
                 continue;
             }
@@ -886,12 +1045,13 @@ ssize_t pth_readv(int fd, const struct iovec *iov, int iovcnt)
 /* Pth variant of readv(2) with extra event(s) */
 ssize_t pth_readv_ev(int fd, const struct iovec *iov, int iovcnt, pth_event_t ev_extra)
 {
-    struct timeval delay;
     pth_event_t ev;
     static pth_key_t ev_key = PTH_KEY_INIT;
-    fd_set fds;
     int fdmode;
     int n;
+#ifdef PTH_URING
+    ssize_t rv;
+#endif
 
     pth_implicit_init();
     pth_debug2("pth_readv_ev: enter from thread \"%s\"", pth_current->name);
@@ -906,18 +1066,55 @@ ssize_t pth_readv_ev(int fd, const struct iovec *iov, int iovcnt, pth_event_t ev
     if ((fdmode = pth_fdmode(fd, PTH_FDMODE_POLL)) == PTH_FDMODE_ERROR)
         return pth_error(-1, EBADF);
 
+#ifdef PTH_URING
+    /* let the kernel perform the read on a blocking filedescriptor
+       through io_uring(7), so the thread just waits for its completion */
+    if (   fdmode == PTH_FDMODE_BLOCK && !pth_iomux_pinned(fd)
+        && pth_uring_io(&rv, IORING_OP_READV, fd, (void *)iov, iovcnt,
+                        (unsigned long long)-1, 0, ev_extra)) {
+        pth_debug2("pth_readv_ev: leave to thread \"%s\"", pth_current->name);
+        return rv;
+    }
+#endif
+
+    /* pinned filedescriptors are permanently in non-blocking mode and
+       have their readiness cached, so the thread has to sleep only if the
+       cache is empty or the filedescriptor is actually found exhausted */
+    if (fdmode == PTH_FDMODE_BLOCK && pth_iomux_pinned(fd)) {
+        if (   !pth_iomux_cached(fd, PTH_UNTIL_FD_READABLE)
+            && !pth_high_pinwait(fd, PTH_UNTIL_FD_READABLE, &ev_key, ev_extra))
+            return -1;
+#if PTH_FAKE_RWV
+        while (   (n = pth_readv_faked(fd, iov, iovcnt)) < 0
+#else
+        while (   (n = pth_sc(readv)(fd, iov, iovcnt)) < 0
+#endif
+               && (   errno == EINTR
+                   || (   (errno == EAGAIN || errno == EWOULDBLOCK)
+                       && pth_high_pinwait(fd, PTH_UNTIL_FD_READABLE, &ev_key, ev_extra)))) ;
+        pth_debug2("pth_readv_ev: leave to thread \"%s\"", pth_current->name);
+        return n;
+    }
+
+    /* optimistically attempt the read first, as on a busy filedescriptor
+       the data is usually already there, so polling would be wasted */
+    n = -2;
+    if (fdmode == PTH_FDMODE_BLOCK && pth_high_iofirst) {
+        n = pth_high_tryreadv(fd, iov, iovcnt);
+        if (n >= 0 || (n == -1 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+            pth_debug2("pth_readv_ev: leave to thread \"%s\"", pth_current->name);
+            return n;
+        }
+    }
+
     /* poll filedescriptor if not already in non-blocking operation */
     if (fdmode == PTH_FDMODE_BLOCK) {
 
         /* first directly poll filedescriptor for readability
            to avoid unneccessary (and resource consuming because of context
-           switches, etc) event handling through the scheduler */
-        FD_ZERO(&fds);
-        FD_SET(fd, &fds);
-        delay.tv_sec  = 0;
-        delay.tv_usec = 0;
-        while ((n = pth_sc(select)(fd+1, &fds, NULL, NULL, &delay)) < 0
-               && errno == EINTR) ;
+           switches, etc) event handling through the scheduler
+           (unless the read attempt already found it exhausted) */
+        n = (n == -2 ? pth_util_fd_poll(fd, PTH_UNTIL_FD_READABLE) : 0);
 
         /* if filedescriptor is still not readable,
            let thread sleep until it is or event occurs */
@@ -1004,10 +1201,8 @@ ssize_t pth_writev(int fd, const struct iovec *iov, int iovcnt)
 /* Pth variant of writev(2) with extra event(s) */
 ssize_t pth_writev_ev(int fd, const struct iovec *iov, int iovcnt, pth_event_t ev_extra)
 {
-    struct timeval delay;
     pth_event_t ev;
     static pth_key_t ev_key = PTH_KEY_INIT;
-    fd_set fds;
     int fdmode;
     struct iovec *liov;
     int liovcnt;
@@ -1028,6 +1223,39 @@ ssize_t pth_writev_ev(int fd, const struct iovec *iov, int iovcnt, pth_event_t e
     if (!pth_util_fd_valid(fd))
         return pth_error(-1, EBADF);
 
+#ifdef PTH_URING
+    /* let the kernel perform the write on a blocking filedescriptor
+       through io_uring(7), so the thread just waits for its completion
+       (iterating on partial writes to mimic the blocking writev(2), as
+       long as the vector fits into the temporary one for advancing it) */
+    if (   iovcnt <= (int)(sizeof(tiov_stack) / sizeof(struct iovec))
+        && pth_uring_usable(IORING_OP_WRITEV) && !pth_iomux_pinned(fd)
+        && pth_fdmode(fd, PTH_FDMODE_POLL) == PTH_FDMODE_BLOCK) {
+        rv      = 0;
+        nbytes  = pth_writev_iov_bytes(iov, iovcnt);
+        liov    = NULL;
+        liovcnt = 0;
+        pth_writev_iov_advance(iov, iovcnt, 0, &liov, &liovcnt, tiov_stack, iovcnt);
+        n = 0;
+        while (pth_uring_io(&s, IORING_OP_WRITEV, fd, liov, liovcnt,
+                            (unsigned long long)-1, 0, ev_extra)) {
+            n++;
+            if (s > 0)
+                rv += s;
+            if (s <= 0 || s >= (ssize_t)nbytes)
+                break;
+            nbytes -= s;
+            pth_writev_iov_advance(iov, iovcnt, s, &liov, &liovcnt, tiov_stack, iovcnt);
+        }
+        if (n > 0) {
+            if (s < 0 && rv == 0)
+                rv = -1;
+            pth_debug2("pth_writev_ev: leave to thread \"%s\"", pth_current->name);
+            return rv;
+        }
+    }
+#endif
+
     /* force filedescriptor into non-blocking mode */
     if ((fdmode = pth_fdmode(fd, PTH_FDMODE_NONBLOCK)) == PTH_FDMODE_ERROR)
         return pth_error(-1, EBADF);
@@ -1056,13 +1284,9 @@ ssize_t pth_writev_ev(int fd, const struct iovec *iov, int iovcnt, pth_event_t e
 
         /* first directly poll filedescriptor for writeability
            to avoid unneccessary (and resource consuming because of context
-           switches, etc) event handling through the scheduler */
-        FD_ZERO(&fds);
-        FD_SET(fd, &fds);
-        delay.tv_sec  = 0;
-        delay.tv_usec = 0;
-        while ((n = pth_sc(select)(fd+1, NULL, &fds, NULL, &delay)) < 0
-               && errno == EINTR) ;
+           switches, etc) event handling through the scheduler
+           (unless the write is optimistically attempted first) */
+        n = (pth_high_iofirst ? 1 : pth_util_fd_poll(fd, PTH_UNTIL_FD_WRITEABLE));
 
         for (;;) {
             /* if filedescriptor is still not writeable,
@@ -1100,6 +1324,17 @@ ssize_t pth_writev_ev(int fd, const struct iovec *iov, int iovcnt, pth_event_t e
             if (s > 0 && s < (ssize_t)nbytes) {
                 nbytes -= s;
                 pth_writev_iov_advance(iov, iovcnt, s, &liov, &liovcnt, tiov, tiovcnt);
+                pth_iomux_uncache(fd, PTH_UNTIL_FD_WRITEABLE);
+                n = 0;
+                continue;
+            }
+
+            /* a pinned filedescriptor can be found exhausted although
+               its cached readiness claimed the opposite, and so can one
+               written optimistically without polling, so wait again */
+            if (   s < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)
+                && (pth_iomux_pinned(fd) || pth_high_iofirst)) {
+                pth_iomux_uncache(fd, PTH_UNTIL_FD_WRITEABLE);
                 n = 0;
                 continue;
             }
@@ -1231,126 +1466,535 @@ intern ssize_t pth_writev_faked(int fd, const struct iovec *iov, int iovcnt)
 /* Pth variant of POSIX pread(3) */
 ssize_t pth_pread(int fd, void *buf, size_t nbytes, off_t offset)
 {
-    static pth_mutex_t mutex = PTH_MUTEX_INIT;
-    off_t old_offset;
-    ssize_t rc;
+    pth_offload_job_t job;
+    ssize_t n;
 
-    /* protect us: pth_read can yield! */
-    if (!pth_mutex_acquire(&mutex, FALSE, NULL))
-        return (-1);
+    pth_implicit_init();
+    pth_debug2("pth_pread: enter from thread \"%s\"", pth_current->name);
 
-    /* remember current offset */
-    if ((old_offset = lseek(fd, 0, SEEK_CUR)) == (off_t)(-1)) {
-        pth_mutex_release(&mutex);
-        return (-1);
-    }
-    /* seek to requested offset */
-    if (lseek(fd, offset, SEEK_SET) == (off_t)(-1)) {
-        pth_mutex_release(&mutex);
-        return (-1);
+    /* POSIX compliance */
+    if (nbytes == 0)
+        return 0;
+    if (!pth_util_fd_valid(fd))
+        return pth_error(-1, EBADF);
+    if (offset < 0)
+        return pth_error(-1, EINVAL);
+
+#ifdef PTH_URING
+    /* let the kernel perform the read on a blocking filedescriptor
+       through io_uring(7), so the thread just waits for its completion */
+    if (   !pth_iomux_pinned(fd) && pth_fdmode(fd, PTH_FDMODE_POLL) == PTH_FDMODE_BLOCK
+        && pth_uring_io(&n, IORING_OP_READ, fd, buf, nbytes,
+                        (unsigned long long)offset, 0, NULL)) {
+        pth_debug2("pth_pread: leave to thread \"%s\"", pth_current->name);
+        return n;
     }
+#endif
 
-    /* perform the read operation */
-    rc = pth_read(fd, buf, nbytes);
+    /* let a worker perform the read from a disk file */
+    if (pth_offload_file(fd)) {
+        job.op  = PTH_OFFLOAD_READ;
+        job.fd  = fd;
+        job.buf = buf;
+        job.len = nbytes;
+        job.off = offset;
+        if (pth_offload_submit(&job, NULL)) {
+            pth_debug2("pth_pread: leave to thread \"%s\"", pth_current->name);
+            return (ssize_t)job.res;
+        }
+    }
 
-    /* restore the old offset situation */
-    pth_shield { lseek(fd, old_offset, SEEK_SET); }
+    /* Positioned I/O is possible on seekable files only, which are always
+       readable, so there is no readiness to wait for. And as it neither
+       uses nor moves the file offset, there is no need to serialize it
+       with other threads accessing the same file. */
+    while ((n = pth_sc(pread)(fd, buf, nbytes, offset)) < 0
+           && errno == EINTR) ;
 
-    /* unprotect and return result of read */
-    pth_mutex_release(&mutex);
-    return rc;
+    pth_debug2("pth_pread: leave to thread \"%s\"", pth_current->name);
+    return n;
 }
 
 /* Pth variant of POSIX pwrite(3) */
 ssize_t pth_pwrite(int fd, const void *buf, size_t nbytes, off_t offset)
 {
-    static pth_mutex_t mutex = PTH_MUTEX_INIT;
-    off_t old_offset;
-    ssize_t rc;
-
-    /* protect us: pth_write can yield! */
-    if (!pth_mutex_acquire(&mutex, FALSE, NULL))
-        return (-1);
+    pth_offload_job_t job;
+    ssize_t n;
 
-    /* remember current offset */
-    if ((old_offset = lseek(fd, 0, SEEK_CUR)) == (off_t)(-1)) {
-        pth_mutex_release(&mutex);
-        return (-1);
-    }
-    /* seek to requested offset */
-    if (lseek(fd, offset, SEEK_SET) == (off_t)(-1)) {
-        pth_mutex_release(&mutex);
-        return (-1);
-    }
-
-    /* perform the write operation */
-    rc = pth_write(fd, buf, nbytes);
+    pth_implicit_init();
+    pth_debug2("pth_pwrite: enter from thread \"%s\"", pth_current->name);
 
-    /* restore the old offset situation */
-    pth_shield { lseek(fd, old_offset, SEEK_SET); }
+    /* POSIX compliance */
+    if (nbytes == 0)
+        return 0;
+    if (!pth_util_fd_valid(fd))
+        return pth_error(-1, EBADF);
+    if (offset < 0)
+        return pth_error(-1, EINVAL);
 
-    /* unprotect and return result of write */
-    pth_mutex_release(&mutex);
-    return rc;
-}
+#ifdef PTH_URING
+    /* let the kernel perform the write on a blocking filedescriptor
+       through io_uring(7), so the thread just waits for its completion */
+    if (   !pth_iomux_pinned(fd) && pth_fdmode(fd, PTH_FDMODE_POLL) == PTH_FDMODE_BLOCK
+        && pth_uring_io(&n, IORING_OP_WRITE, fd, (void *)buf, nbytes,
+                        (unsigned long long)offset, 0, NULL)) {
+        pth_debug2("pth_pwrite: leave to thread \"%s\"", pth_current->name);
+        return n;
+    }
+#endif
 
-/* Pth variant of SUSv2 recv(2) */
-ssize_t pth_recv(int s, void *buf, size_t len, int flags)
-{
-    return pth_recv_ev(s, buf, len, flags, NULL);
-}
+    /* let a worker perform the write to a disk file */
+    if (pth_offload_file(fd)) {
+        job.op  = PTH_OFFLOAD_WRITE;
+        job.fd  = fd;
+        job.buf = (void *)buf;
+        job.len = nbytes;
+        job.off = offset;
+        if (pth_offload_submit(&job, NULL)) {
+            pth_debug2("pth_pwrite: leave to thread \"%s\"", pth_current->name);
+            return (ssize_t)job.res;
+        }
+    }
 
-/* Pth variant of SUSv2 recv(2) with extra event(s) */
-ssize_t pth_recv_ev(int s, void *buf, size_t len, int flags, pth_event_t ev)
-{
-    return pth_recvfrom_ev(s, buf, len, flags, NULL, 0, ev);
-}
+    /* perform the write directly (see pth_pread() above) */
+    while ((n = pth_sc(pwrite)(fd, buf, nbytes, offset)) < 0
+           && errno == EINTR) ;
 
-/* Pth variant of SUSv2 recvfrom(2) */
-ssize_t pth_recvfrom(int s, void *buf, size_t len, int flags, struct sockaddr *from, socklen_t *fromlen)
-{
-    return pth_recvfrom_ev(s, buf, len, flags, from, fromlen, NULL);
+    pth_debug2("pth_pwrite: leave to thread \"%s\"", pth_current->name);
+    return n;
 }
 
-/* Pth variant of SUSv2 recvfrom(2) with extra event(s) */
-ssize_t pth_recvfrom_ev(int fd, void *buf, size_t nbytes, int flags, struct sockaddr *from, socklen_t *fromlen, pth_event_t ev_extra)
+/* Pth variant of preadv(2) */
+ssize_t pth_preadv(int fd, const struct iovec *iov, int iovcnt, off_t offset)
 {
-    struct timeval delay;
-    pth_event_t ev;
-    static pth_key_t ev_key = PTH_KEY_INIT;
-    fd_set fds;
-    int fdmode;
-    int n;
+#if defined(HAVE_PREADV) && defined(HAVE_PWRITEV)
+    pth_offload_job_t job;
+#endif
+    ssize_t n;
 
     pth_implicit_init();
-    pth_debug2("pth_recvfrom_ev: enter from thread \"%s\"", pth_current->name);
+    pth_debug2("pth_preadv: enter from thread \"%s\"", pth_current->name);
 
     /* POSIX compliance */
-    if (nbytes == 0)
-        return 0;
+    if (iovcnt <= 0 || iovcnt > UIO_MAXIOV)
+        return pth_error(-1, EINVAL);
     if (!pth_util_fd_valid(fd))
         return pth_error(-1, EBADF);
+    if (offset < 0)
+        return pth_error(-1, EINVAL);
 
-    /* check mode of filedescriptor */
-    if ((fdmode = pth_fdmode(fd, PTH_FDMODE_POLL)) == PTH_FDMODE_ERROR)
-        return pth_error(-1, EBADF);
+#ifdef PTH_URING
+    /* let the kernel perform the read on a blocking filedescriptor
+       through io_uring(7), so the thread just waits for its completion */
+    if (   !pth_iomux_pinned(fd) && pth_fdmode(fd, PTH_FDMODE_POLL) == PTH_FDMODE_BLOCK
+        && pth_uring_io(&n, IORING_OP_READV, fd, (void *)iov, iovcnt,
+                        (unsigned long long)offset, 0, NULL)) {
+        pth_debug2("pth_preadv: leave to thread \"%s\"", pth_current->name);
+        return n;
+    }
+#endif
 
-    /* poll filedescriptor if not already in non-blocking operation */
-    if (fdmode == PTH_FDMODE_BLOCK) {
+#if defined(HAVE_PREADV) && defined(HAVE_PWRITEV)
+    /* let a worker perform the read from a disk file */
+    if (pth_offload_file(fd)) {
+        job.op  = PTH_OFFLOAD_READV;
+        job.fd  = fd;
+        job.buf = (void *)iov;
+        job.len = (size_t)iovcnt;
+        job.off = offset;
+        if (pth_offload_submit(&job, NULL)) {
+            pth_debug2("pth_preadv: leave to thread \"%s\"", pth_current->name);
+            return (ssize_t)job.res;
+        }
+    }
 
-        /* now directly poll filedescriptor for readability
-           to avoid unneccessary (and resource consuming because of context
-           switches, etc) event handling through the scheduler */
-        if (!pth_util_fd_valid(fd))
-            return pth_error(-1, EBADF);
-        FD_ZERO(&fds);
-        FD_SET(fd, &fds);
-        delay.tv_sec  = 0;
-        delay.tv_usec = 0;
-        while ((n = pth_sc(select)(fd+1, &fds, NULL, NULL, &delay)) < 0
-               && errno == EINTR) ;
-        if (n < 0 && (errno == EINVAL || errno == EBADF))
-            return pth_error(-1, errno);
+    /* perform the read directly (see pth_pread() above) */
+    while ((n = pth_sc(preadv)(fd, iov, iovcnt, offset)) < 0
+           && errno == EINTR) ;
+#else
+    n = pth_preadv_faked(fd, iov, iovcnt, offset);
+#endif
+
+    pth_debug2("pth_preadv: leave to thread \"%s\"", pth_current->name);
+    return n;
+}
+
+/* A faked version of preadv(2) */
+intern ssize_t pth_preadv_faked(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    char *buffer;
+    char *cp;
+    size_t bytes, copy;
+    ssize_t rv;
+    int i;
+
+    /* determine total number of bytes to read */
+    bytes = 0;
+    for (i = 0; i < iovcnt; i++)
+        bytes += iov[i].iov_len;
+    if (bytes == 0)
+        return 0;
+
+    /* allocate a temporary buffer */
+    if ((buffer = (char *)malloc(bytes)) == NULL)
+        return (ssize_t)(-1);
+
+    /* read data into temporary buffer */
+    rv = pth_pread(fd, buffer, bytes, offset);
+
+    /* scatter read data into callers vector */
+    if (rv > 0) {
+        bytes = (size_t)rv;
+        cp = buffer;
+        for (i = 0; i < iovcnt && bytes > 0; i++) {
+            copy = pth_util_min(iov[i].iov_len, bytes);
+            memcpy(iov[i].iov_base, cp, copy);
+            cp    += copy;
+            bytes -= copy;
+        }
+    }
+
+    /* remove the temporary buffer */
+    pth_shield { free(buffer); }
+
+    /* return number of read bytes */
+    return rv;
+}
+
+/* Pth variant of pwritev(2) */
+ssize_t pth_pwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+#if defined(HAVE_PREADV) && defined(HAVE_PWRITEV)
+    pth_offload_job_t job;
+#endif
+    ssize_t n;
+
+    pth_implicit_init();
+    pth_debug2("pth_pwritev: enter from thread \"%s\"", pth_current->name);
+
+    /* POSIX compliance */
+    if (iovcnt <= 0 || iovcnt > UIO_MAXIOV)
+        return pth_error(-1, EINVAL);
+    if (!pth_util_fd_valid(fd))
+        return pth_error(-1, EBADF);
+    if (offset < 0)
+        return pth_error(-1, EINVAL);
+
+#ifdef PTH_URING
+    /* let the kernel perform the write on a blocking filedescriptor
+       through io_uring(7), so the thread just waits for its completion */
+    if (   !pth_iomux_pinned(fd) && pth_fdmode(fd, PTH_FDMODE_POLL) == PTH_FDMODE_BLOCK
+        && pth_uring_io(&n, IORING_OP_WRITEV, fd, (void *)iov, iovcnt,
+                        (unsigned long long)offset, 0, NULL)) {
+        pth_debug2("pth_pwritev: leave to thread \"%s\"", pth_current->name);
+        return n;
+    }
+#endif
+
+#if defined(HAVE_PREADV) && defined(HAVE_PWRITEV)
+    /* let a worker perform the write to a disk file */
+    if (pth_offload_file(fd)) {
+        job.op  = PTH_OFFLOAD_WRITEV;
+        job.fd  = fd;
+        job.buf = (void *)iov;
+        job.len = (size_t)iovcnt;
+        job.off = offset;
+        if (pth_offload_submit(&job, NULL)) {
+            pth_debug2("pth_pwritev: leave to thread \"%s\"", pth_current->name);
+            return (ssize_t)job.res;
+        }
+    }
+
+    /* perform the write directly (see pth_pread() above) */
+    while ((n = pth_sc(pwritev)(fd, iov, iovcnt, offset)) < 0
+           && errno == EINTR) ;
+#else
+    n = pth_pwritev_faked(fd, iov, iovcnt, offset);
+#endif
+
+    pth_debug2("pth_pwritev: leave to thread \"%s\"", pth_current->name);
+    return n;
+}
+
+/* A faked version of pwritev(2) */
+intern ssize_t pth_pwritev_faked(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    char *buffer;
+    char *cp;
+    size_t bytes;
+    ssize_t rv;
+    int i;
+
+    /* determine total number of bytes to write */
+    bytes = 0;
+    for (i = 0; i < iovcnt; i++)
+        bytes += iov[i].iov_len;
+    if (bytes == 0)
+        return 0;
+
+    /* allocate a temporary buffer */
+    if ((buffer = (char *)malloc(bytes)) == NULL)
+        return (ssize_t)(-1);
+
+    /* concatenate the data from callers vector into buffer */
+    cp = buffer;
+    for (i = 0; i < iovcnt; i++) {
+        memcpy(cp, iov[i].iov_base, iov[i].iov_len);
+        cp += iov[i].iov_len;
+    }
+
+    /* write continuous chunk of data */
+    rv = pth_pwrite(fd, buffer, bytes, offset);
+
+    /* remove the temporary buffer */
+    pth_shield { free(buffer); }
+
+    /* return number of written bytes */
+    return rv;
+}
+
+/* Pth variant of open(2) */
+int pth_open(const char *path, int flags, ...)
+{
+    pth_offload_job_t job;
+    va_list ap;
+    mode_t mode;
+
+    pth_implicit_init();
+    mode = 0;
+#ifdef O_TMPFILE
+    if ((flags & O_CREAT) || (flags & O_TMPFILE) == O_TMPFILE) {
+#else
+    if (flags & O_CREAT) {
+#endif
+        va_start(ap, flags);
+        mode = (mode_t)va_arg(ap, int);
+        va_end(ap);
+    }
+
+    /* opening a file can require disk accesses, so let a worker do it */
+    job.op    = PTH_OFFLOAD_OPEN;
+    job.path  = path;
+    job.flags = flags;
+    job.mode  = mode;
+    if (!pth_offload_submit(&job, NULL))
+        job.res = (long)open(path, flags, mode);
+    if (job.res != -1)
+        pth_fdmode_forget((int)job.res, FALSE);
+    return (int)job.res;
+}
+
+/* Pth variant of fsync(2) */
+int pth_fsync(int fd)
+{
+    pth_offload_job_t job;
+
+    pth_implicit_init();
+    if (!pth_util_fd_valid(fd))
+        return pth_error(-1, EBADF);
+
+    /* flushing to disk can take long, so let a worker do it */
+    job.op = PTH_OFFLOAD_FSYNC;
+    job.fd = fd;
+    if (pth_offload_submit(&job, NULL))
+        return (int)job.res;
+    return fsync(fd);
+}
+
+/* Pth variant of stat(2) */
+int pth_stat(const char *path, struct stat *sb)
+{
+    pth_offload_job_t job;
+
+    pth_implicit_init();
+
+    /* looking up a path can require disk accesses, so let a worker do it */
+    job.op   = PTH_OFFLOAD_STAT;
+    job.path = path;
+    job.buf  = sb;
+    if (pth_offload_submit(&job, NULL))
+        return (int)job.res;
+    return stat(path, sb);
+}
+
+/* Pth variant of close(2) */
+int pth_close(int fd)
+{
+    /* the filedescriptor number can be reused by the next
+       filedescriptor, so forget everything known about it */
+    if (pth_iomux_pinned(fd))
+        pth_iomux_unpin(fd);
+    pth_fdmode_forget(fd, FALSE);
+    return close(fd);
+}
+
+/* Pth variant of dup(2) */
+int pth_dup(int fd)
+{
+    int rc;
+
+    /* duplicates share their I/O mode */
+    if ((rc = dup(fd)) != -1) {
+        pth_fdmode_forget(fd, TRUE);
+        pth_fdmode_forget(rc, TRUE);
+    }
+    return rc;
+}
+
+/* Pth variant of dup2(2) */
+int pth_dup2(int fd, int fd2)
+{
+    int rc;
+
+    if (fd != fd2)
+        pth_fdmode_forget(fd2, FALSE);
+    if ((rc = dup2(fd, fd2)) != -1 && fd != fd2) {
+        pth_fdmode_forget(fd, TRUE);
+        pth_fdmode_forget(fd2, TRUE);
+    }
+    return rc;
+}
+
+/* Pth variant of fcntl(2) */
+int pth_fcntl(int fd, int cmd, ...)
+{
+    va_list ap;
+    void *arg;
+    int rc;
+
+    va_start(ap, cmd);
+    arg = va_arg(ap, void *);
+    va_end(ap);
+    if ((rc = fcntl(fd, cmd, arg)) == -1)
+        return rc;
+    if (cmd == F_SETFL)
+        pth_fdmode_forget(fd, -1);
+    else if (cmd == F_DUPFD
+#ifdef F_DUPFD_CLOEXEC
+             || cmd == F_DUPFD_CLOEXEC
+#endif
+            ) {
+        pth_fdmode_forget(fd, TRUE);
+        pth_fdmode_forget(rc, TRUE);
+    }
+    return rc;
+}
+
+/* Pth variant of SUSv2 recv(2) */
+ssize_t pth_recv(int s, void *buf, size_t len, int flags)
+{
+    return pth_recv_ev(s, buf, len, flags, NULL);
+}
+
+/* Pth variant of SUSv2 recv(2) with extra event(s) */
+ssize_t pth_recv_ev(int s, void *buf, size_t len, int flags, pth_event_t ev)
+{
+    return pth_recvfrom_ev(s, buf, len, flags, NULL, 0, ev);
+}
+
+/* Pth variant of SUSv2 recvfrom(2) */
+ssize_t pth_recvfrom(int s, void *buf, size_t len, int flags, struct sockaddr *from, socklen_t *fromlen)
+{
+    return pth_recvfrom_ev(s, buf, len, flags, from, fromlen, NULL);
+}
+
+/* Pth variant of SUSv2 recvfrom(2) with extra event(s) */
+ssize_t pth_recvfrom_ev(int fd, void *buf, size_t nbytes, int flags, struct sockaddr *from, socklen_t *fromlen, pth_event_t ev_extra)
+{
+    pth_event_t ev;
+    static pth_key_t ev_key = PTH_KEY_INIT;
+    int fdmode;
+    int n;
+#ifdef PTH_URING
+    struct msghdr msg;
+    struct iovec iov;
+    ssize_t rv;
+#endif
+
+    pth_implicit_init();
+    pth_debug2("pth_recvfrom_ev: enter from thread \"%s\"", pth_current->name);
+
+    /* POSIX compliance */
+    if (nbytes == 0)
+        return 0;
+    if (!pth_util_fd_valid(fd))
+        return pth_error(-1, EBADF);
+
+    /* check mode of filedescriptor */
+    if ((fdmode = pth_fdmode(fd, PTH_FDMODE_POLL)) == PTH_FDMODE_ERROR)
+        return pth_error(-1, EBADF);
+
+#ifdef PTH_URING
+    /* let the kernel perform the receive on a blocking filedescriptor
+       through io_uring(7), so the thread just waits for its completion */
+    if (fdmode == PTH_FDMODE_BLOCK && !pth_iomux_pinned(fd)) {
+        if (from == NULL || fromlen == NULL) {
+            if (pth_uring_io(&rv, IORING_OP_RECV, fd, buf, nbytes,
+                             0, flags, ev_extra)) {
+                pth_debug2("pth_recvfrom_ev: leave to thread \"%s\"", pth_current->name);
+                return rv;
+            }
+        }
+        else {
+            memset(&msg, 0, sizeof(msg));
+            iov.iov_base    = buf;
+            iov.iov_len     = nbytes;
+            msg.msg_name    = from;
+            msg.msg_namelen = *fromlen;
+            msg.msg_iov     = &iov;
+            msg.msg_iovlen  = 1;
+            if (pth_uring_io(&rv, IORING_OP_RECVMSG, fd, &msg, 1, 0, flags, ev_extra)) {
+                if (rv >= 0)
+                    *fromlen = msg.msg_namelen;
+                pth_debug2("pth_recvfrom_ev: leave to thread \"%s\"", pth_current->name);
+                return rv;
+            }
+        }
+    }
+#endif
+
+    /* pinned filedescriptors are permanently in non-blocking mode and
+       have their readiness cached, so the thread has to sleep only if the
+       cache is empty or the filedescriptor is actually found exhausted */
+    if (fdmode == PTH_FDMODE_BLOCK && pth_iomux_pinned(fd)) {
+        if (   !pth_iomux_cached(fd, PTH_UNTIL_FD_READABLE)
+            && !pth_high_pinwait(fd, PTH_UNTIL_FD_READABLE, &ev_key, ev_extra))
+            return -1;
+        while (   (n = pth_sc(recvfrom)(fd, buf, nbytes, flags, from, fromlen)) < 0
+               && (   errno == EINTR
+                   || (   (errno == EAGAIN || errno == EWOULDBLOCK)
+                       && pth_high_pinwait(fd, PTH_UNTIL_FD_READABLE, &ev_key, ev_extra)))) ;
+        pth_debug2("pth_recvfrom_ev: leave to thread \"%s\"", pth_current->name);
+        return n;
+    }
+
+    /* optimistically attempt the receive first, as on a busy socket
+       the data is usually already there, so polling would be wasted */
+    n = -2;
+    if (fdmode == PTH_FDMODE_BLOCK && pth_high_iofirst) {
+        n = pth_high_tryrecvfrom(fd, buf, nbytes, flags, from, fromlen);
+        if (n >= 0 || (n == -1 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+            pth_debug2("pth_recvfrom_ev: leave to thread \"%s\"", pth_current->name);
+            return n;
+        }
+    }
+
+    /* poll filedescriptor if not already in non-blocking operation */
+    if (fdmode == PTH_FDMODE_BLOCK) {
+
+        /* now directly poll filedescriptor for readability
+           to avoid unneccessary (and resource consuming because of context
+           switches, etc) event handling through the scheduler
+           (unless the receive attempt already found it exhausted) */
+        if (n == -2) {
+            if (!pth_util_fd_valid(fd))
+                return pth_error(-1, EBADF);
+            n = pth_util_fd_poll(fd, PTH_UNTIL_FD_READABLE);
+            if (n < 0 && (errno == EINVAL || errno == EBADF))
+                return pth_error(-1, errno);
+        }
+        else
+            n = 0;
 
         /* if filedescriptor is still not readable,
            let thread sleep until it is or the extra event occurs */
@@ -1400,14 +2044,16 @@ ssize_t pth_sendto(int s, const void *buf, size_t len, int flags, const struct s
 /* Pth variant of SUSv2 sendto(2) with extra event(s) */
 ssize_t pth_sendto_ev(int fd, const void *buf, size_t nbytes, int flags, const struct sockaddr *to, socklen_t tolen, pth_event_t ev_extra)
 {
-    struct timeval delay;
     pth_event_t ev;
     static pth_key_t ev_key = PTH_KEY_INIT;
-    fd_set fds;
     int fdmode;
     ssize_t rv;
     ssize_t s;
     int n;
+#ifdef PTH_URING
+    struct msghdr msg;
+    struct iovec iov;
+#endif
 
     pth_implicit_init();
     pth_debug2("pth_sendto_ev: enter from thread \"%s\"", pth_current->name);
@@ -1418,6 +2064,48 @@ ssize_t pth_sendto_ev(int fd, const void *buf, size_t nbytes, int flags, const s
     if (!pth_util_fd_valid(fd))
         return pth_error(-1, EBADF);
 
+#ifdef PTH_URING
+    /* let the kernel perform the send on a blocking filedescriptor
+       through io_uring(7), so the thread just waits for its completion
+       (iterating on partial sends to mimic the blocking sendto(2)) */
+    if (   pth_uring_usable(to == NULL ? IORING_OP_SEND : IORING_OP_SENDMSG)
+        && !pth_iomux_pinned(fd) && pth_fdmode(fd, PTH_FDMODE_POLL) == PTH_FDMODE_BLOCK) {
+        rv = 0;
+        n = 0;
+        for (;;) {
+            if (to == NULL) {
+                if (!pth_uring_io(&s, IORING_OP_SEND, fd, (void *)buf, nbytes,
+                                  0, flags, ev_extra))
+                    break;
+            }
+            else {
+                memset(&msg, 0, sizeof(msg));
+                iov.iov_base    = (void *)buf;
+                iov.iov_len     = nbytes;
+                msg.msg_name    = (void *)to;
+                msg.msg_namelen = tolen;
+                msg.msg_iov     = &iov;
+                msg.msg_iovlen  = 1;
+                if (!pth_uring_io(&s, IORING_OP_SENDMSG, fd, &msg, 1, 0, flags, ev_extra))
+                    break;
+            }
+            n++;
+            if (s > 0)
+                rv += s;
+            if (s <= 0 || s >= (ssize_t)nbytes)
+                break;
+            nbytes -= s;
+            buf = (void *)((char *)buf + s);
+        }
+        if (n > 0) {
+            if (s < 0 && rv == 0)
+                rv = -1;
+            pth_debug2("pth_sendto_ev: leave to thread \"%s\"", pth_current->name);
+            return rv;
+        }
+    }
+#endif
+
     /* force filedescriptor into non-blocking mode */
     if ((fdmode = pth_fdmode(fd, PTH_FDMODE_NONBLOCK)) == PTH_FDMODE_ERROR)
         return pth_error(-1, EBADF);
@@ -1427,17 +2115,13 @@ ssize_t pth_sendto_ev(int fd, const void *buf, size_t nbytes, int flags, const s
 
         /* now directly poll filedescriptor for writeability
            to avoid unneccessary (and resource consuming because of context
-           switches, etc) event handling through the scheduler */
+           switches, etc) event handling through the scheduler
+           (unless the write is optimistically attempted first) */
         if (!pth_util_fd_valid(fd)) {
             pth_fdmode(fd, fdmode);
             return pth_error(-1, EBADF);
         }
-        FD_ZERO(&fds);
-        FD_SET(fd, &fds);
-        delay.tv_sec  = 0;
-        delay.tv_usec = 0;
-        while ((n = pth_sc(select)(fd+1, NULL, &fds, NULL, &delay)) < 0
-               && errno == EINTR) ;
+        n = (pth_high_iofirst ? 1 : pth_util_fd_poll(fd, PTH_UNTIL_FD_WRITEABLE));
         if (n < 0 && (errno == EINVAL || errno == EBADF))
             return pth_error(-1, errno);
 
@@ -1471,6 +2155,17 @@ ssize_t pth_sendto_ev(int fd, const void *buf, size_t nbytes, int flags, const s
             if (s > 0 && s < (ssize_t)nbytes) {
                 nbytes -= s;
                 buf = (void *)((char *)buf + s);
+                pth_iomux_uncache(fd, PTH_UNTIL_FD_WRITEABLE);
+                n = 0;
+                continue;
+            }
+
+            /* a pinned filedescriptor can be found exhausted although
+               its cached readiness claimed the opposite, and so can one
+               written optimistically without polling, so wait again */
+            if (   s < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)
+                && (pth_iomux_pinned(fd) || pth_high_iofirst)) {
+                pth_iomux_uncache(fd, PTH_UNTIL_FD_WRITEABLE);
                 n = 0;
                 continue;
             }
@@ -1496,3 +2191,367 @@ ssize_t pth_sendto_ev(int fd, const void *buf, size_t nbytes, int flags, const s
     return rv;
 }
 
+#if defined(HAVE_SYS_SENDFILE_H) && defined(HAVE_SENDFILE)
+/* perform a single sendfile(2) transfer */
+static ssize_t pth_high_sendfile(int out_fd, int in_fd, off_t *offset, size_t count, pth_event_t ev_extra)
+{
+    pth_offload_job_t job;
+    ssize_t s;
+
+    /* the input is a file, so reading it from a slow disk would block
+       the whole process: let a worker perform the transfer (the output
+       stays in non-blocking mode), so the thread just waits for it */
+    if (pth_offload_file(in_fd)) {
+        job.op  = PTH_OFFLOAD_SENDFILE;
+        job.fd  = out_fd;
+        job.fd2 = in_fd;
+        job.off = (offset != NULL ? *offset : (off_t)-1);
+        job.len = count;
+        if (pth_offload_submit(&job, ev_extra)) {
+            if (offset != NULL)
+                *offset = job.off;
+            return (ssize_t)job.res;
+        }
+    }
+    while ((s = sendfile(out_fd, in_fd, offset, count)) < 0
+           && errno == EINTR) ;
+    return s;
+}
+#endif
+
+/* Pth variant of Linux sendfile(2) */
+ssize_t pth_sendfile(int out_fd, int in_fd, off_t *offset, size_t count)
+{
+    return pth_sendfile_ev(out_fd, in_fd, offset, count, NULL);
+}
+
+/* Pth variant of Linux sendfile(2) with extra event(s) */
+ssize_t pth_sendfile_ev(int out_fd, int in_fd, off_t *offset, size_t count, pth_event_t ev_extra)
+{
+#if defined(HAVE_SYS_SENDFILE_H) && defined(HAVE_SENDFILE)
+    pth_event_t ev;
+    static pth_key_t ev_key = PTH_KEY_INIT;
+    int fdmode;
+    ssize_t rv;
+    ssize_t s;
+    int n;
+#endif
+
+    pth_implicit_init();
+    pth_debug2("pth_sendfile_ev: enter from thread \"%s\"", pth_current->name);
+
+    /* POSIX compliance */
+    if (count == 0)
+        return 0;
+    if (!pth_util_fd_valid(out_fd) || !pth_util_fd_valid(in_fd))
+        return pth_error(-1, EBADF);
+
+#if defined(HAVE_SYS_SENDFILE_H) && defined(HAVE_SENDFILE)
+    /* force output filedescriptor into non-blocking mode
+       (the input filedescriptor has to be a file, which cannot be polled) */
+    if ((fdmode = pth_fdmode(out_fd, PTH_FDMODE_NONBLOCK)) == PTH_FDMODE_ERROR)
+        return pth_error(-1, EBADF);
+
+    /* poll filedescriptor if not already in non-blocking operation */
+    if (fdmode != PTH_FDMODE_NONBLOCK) {
+
+        /* now directly poll filedescriptor for writeability
+           (unless the transfer is optimistically attempted first) */
+        n = (pth_high_iofirst ? 1 : pth_util_fd_poll(out_fd, PTH_UNTIL_FD_WRITEABLE));
+        if (n < 0 && (errno == EINVAL || errno == EBADF)) {
+            pth_fdmode(out_fd, fdmode);
+            return pth_error(-1, errno);
+        }
+
+        rv = 0;
+        for (;;) {
+            /* if filedescriptor is still not writeable,
+               let thread sleep until it is or event occurs */
+            if (n < 1) {
+                ev = pth_event(PTH_EVENT_FD|PTH_UNTIL_FD_WRITEABLE|PTH_MODE_STATIC, &ev_key, out_fd);
+                if (ev_extra != NULL)
+                    pth_event_concat(ev, ev_extra, NULL);
+                pth_wait(ev);
+                if (ev_extra != NULL) {
+                    pth_event_isolate(ev);
+                    if (pth_event_status(ev) != PTH_STATUS_OCCURRED) {
+                        /* the data already transferred cannot be taken
+                           back, so report it instead of the interruption */
+                        if (rv == 0)
+                            rv = pth_error(-1, EINTR);
+                        break;
+                    }
+                }
+            }
+
+            /* now perform the actual transfer operation
+               (which also advances the offset or the file position) */
+            s = pth_high_sendfile(out_fd, in_fd, offset, count, ev_extra);
+            if (s > 0)
+                rv += s;
+
+            /* although we're physically now in non-blocking mode,
+               iterate unless all data is transferred, the end of the input
+               file is reached or an error occurs, because we've to mimic
+               the usual blocking I/O behaviour of sendfile(2). */
+            if (s > 0 && s < (ssize_t)count) {
+                count -= s;
+                pth_iomux_uncache(out_fd, PTH_UNTIL_FD_WRITEABLE);
+                n = 0;
+                continue;
+            }
+
+            /* the filedescriptor can be found exhausted although it
+               was polled writeable (or not polled at all), so wait again */
+            if (s < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                pth_iomux_uncache(out_fd, PTH_UNTIL_FD_WRITEABLE);
+                n = 0;
+                continue;
+            }
+
+            /* pass error to caller, but not for partial transfers (rv > 0) */
+            if (s < 0 && rv == 0)
+                rv = -1;
+
+            /* stop looping */
+            break;
+        }
+    }
+    else {
+        /* just perform the actual transfer operation */
+        rv = pth_high_sendfile(out_fd, in_fd, offset, count, ev_extra);
+    }
+
+    /* restore filedescriptor mode */
+    pth_shield { pth_fdmode(out_fd, fdmode); }
+
+    pth_debug2("pth_sendfile_ev: leave to thread \"%s\"", pth_current->name);
+    return rv;
+#else
+    return pth_sendfile_faked(out_fd, in_fd, offset, count, ev_extra);
+#endif
+}
+
+/* A faked version of sendfile(2) (copying through a temporary buffer) */
+intern ssize_t pth_sendfile_faked(int out_fd, int in_fd, off_t *offset, size_t count, pth_event_t ev_extra)
+{
+    char *buffer;
+    size_t bytes;
+    ssize_t rv;
+    ssize_t n;
+    ssize_t s;
+
+    /* allocate a temporary buffer */
+    bytes = pth_util_min(count, 64*1024);
+    if ((buffer = (char *)malloc(bytes)) == NULL)
+        return (ssize_t)(-1);
+
+    rv = 0;
+    while (count > 0) {
+        /* read the next chunk of data */
+        bytes = pth_util_min(count, 64*1024);
+        if (offset != NULL)
+            n = pth_pread(in_fd, buffer, bytes, *offset);
+        else
+            n = pth_read_ev(in_fd, buffer, bytes, ev_extra);
+        if (n <= 0) {
+            if (n < 0 && rv == 0)
+                rv = -1;
+            break;
+        }
+
+        /* write it to the output filedescriptor */
+        s = pth_write_ev(out_fd, buffer, n, ev_extra);
+        if (s > 0) {
+            rv += s;
+            if (offset != NULL)
+                *offset += s;
+        }
+        if (s < n) {
+            /* leave the file position after the written data */
+            if (offset == NULL)
+                lseek(in_fd, (off_t)(s > 0 ? s : 0) - n, SEEK_CUR);
+            if (s < 0 && rv == 0)
+                rv = -1;
+            break;
+        }
+        count -= n;
+    }
+
+    /* remove the temporary buffer */
+    pth_shield { free(buffer); }
+
+    return rv;
+}
+
+#ifdef HAVE_SPLICE
+/* perform a single splice(2) transfer */
+static ssize_t pth_high_splice(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out,
+                               size_t len, unsigned int flags, pth_event_t ev_extra)
+{
+    pth_offload_job_t job;
+    ssize_t s;
+
+    /* one side can be a file, so reading or writing it on a slow disk
+       would block the whole process (SPLICE_F_NONBLOCK only applies to
+       the pipes): let a worker perform the transfer instead */
+    if (pth_offload_file(fd_in) || pth_offload_file(fd_out)) {
+        job.op    = PTH_OFFLOAD_SPLICE;
+        job.fd    = fd_in;
+        job.off   = (off_in != NULL ? (off_t)*off_in : (off_t)-1);
+        job.fd2   = fd_out;
+        job.off2  = (off_out != NULL ? (off_t)*off_out : (off_t)-1);
+        job.len   = len;
+        job.flags = (int)flags;
+        if (pth_offload_submit(&job, ev_extra)) {
+            if (off_in != NULL)
+                *off_in = (loff_t)job.off;
+            if (off_out != NULL)
+                *off_out = (loff_t)job.off2;
+            return (ssize_t)job.res;
+        }
+    }
+    while ((s = splice(fd_in, off_in, fd_out, off_out, len, flags)) < 0
+           && errno == EINTR) ;
+    return s;
+}
+#endif
+
+/* Pth variant of Linux splice(2) */
+ssize_t pth_splice(int fd_in, off_t *off_in, int fd_out, off_t *off_out, size_t len, unsigned int flags)
+{
+    return pth_splice_ev(fd_in, off_in, fd_out, off_out, len, flags, NULL);
+}
+
+/* Pth variant of Linux splice(2) with extra event(s) */
+ssize_t pth_splice_ev(int fd_in, off_t *off_in, int fd_out, off_t *off_out, size_t len, unsigned int flags, pth_event_t ev_extra)
+{
+#ifdef HAVE_SPLICE
+    pth_event_t ev;
+    static pth_key_t ev_key = PTH_KEY_INIT;
+    loff_t loff_in;
+    loff_t loff_out;
+    int fdmode_in;
+    int fdmode_out;
+    int waitfd;
+    int goal;
+    ssize_t rv;
+    ssize_t s;
+#endif
+
+    pth_implicit_init();
+    pth_debug2("pth_splice_ev: enter from thread \"%s\"", pth_current->name);
+
+    /* POSIX compliance */
+    if (len == 0)
+        return 0;
+    if (!pth_util_fd_valid(fd_in) || !pth_util_fd_valid(fd_out))
+        return pth_error(-1, EBADF);
+
+#ifdef HAVE_SPLICE
+    /* force both filedescriptors into non-blocking mode */
+    if ((fdmode_in = pth_fdmode(fd_in, PTH_FDMODE_NONBLOCK)) == PTH_FDMODE_ERROR)
+        return pth_error(-1, EBADF);
+    if ((fdmode_out = pth_fdmode(fd_out, PTH_FDMODE_NONBLOCK)) == PTH_FDMODE_ERROR) {
+        pth_fdmode(fd_in, fdmode_in);
+        return pth_error(-1, EBADF);
+    }
+
+    /* the kernel updates its own copies of the offsets */
+    if (off_in != NULL)
+        loff_in = (loff_t)*off_in;
+    if (off_out != NULL)
+        loff_out = (loff_t)*off_out;
+
+    if (   fdmode_in != PTH_FDMODE_NONBLOCK && fdmode_out != PTH_FDMODE_NONBLOCK
+        && !(flags & SPLICE_F_NONBLOCK)) {
+        rv = 0;
+        waitfd = -1;
+        goal = 0;
+        for (;;) {
+            /* let thread sleep until the side found exhausted
+               is ready again or the extra event occurs */
+            if (waitfd != -1) {
+                ev = pth_event(PTH_EVENT_FD|goal|PTH_MODE_STATIC, &ev_key, waitfd);
+                if (ev_extra != NULL)
+                    pth_event_concat(ev, ev_extra, NULL);
+                pth_wait(ev);
+                if (ev_extra != NULL) {
+                    pth_event_isolate(ev);
+                    if (pth_event_status(ev) != PTH_STATUS_OCCURRED) {
+                        if (rv == 0)
+                            rv = pth_error(-1, EINTR);
+                        break;
+                    }
+                }
+            }
+
+            /* now perform the actual transfer operation */
+            s = pth_high_splice(fd_in, (off_in != NULL ? &loff_in : NULL),
+                                fd_out, (off_out != NULL ? &loff_out : NULL),
+                                len, flags|SPLICE_F_NONBLOCK, ev_extra);
+
+            /* iterate on partial transfers, because the remaining data
+               can be already available while the output was exhausted */
+            if (s > 0) {
+                rv += s;
+                if (s >= (ssize_t)len)
+                    break;
+                len -= s;
+                waitfd = -1;
+                continue;
+            }
+
+            /* find out which side is exhausted: if the input has no data,
+               either return the data transferred so far (like read(2)
+               would) or wait for more; else the output is exhausted and
+               we've to wait for it to mimic the blocking write(2) */
+            if (s < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                if (pth_util_fd_poll(fd_in, PTH_UNTIL_FD_READABLE) < 1) {
+                    if (rv > 0)
+                        break;
+                    pth_iomux_uncache(fd_in, PTH_UNTIL_FD_READABLE);
+                    waitfd = fd_in;
+                    goal = PTH_UNTIL_FD_READABLE;
+                }
+                else {
+                    pth_iomux_uncache(fd_out, PTH_UNTIL_FD_WRITEABLE);
+                    waitfd = fd_out;
+                    goal = PTH_UNTIL_FD_WRITEABLE;
+                }
+                continue;
+            }
+
+            /* pass error to caller, but not for partial transfers (rv > 0) */
+            if (s < 0 && rv == 0)
+                rv = -1;
+
+            /* stop looping (on errors or the end of the input) */
+            break;
+        }
+    }
+    else {
+        /* just perform the actual transfer operation */
+        rv = pth_high_splice(fd_in, (off_in != NULL ? &loff_in : NULL),
+                             fd_out, (off_out != NULL ? &loff_out : NULL),
+                             len, flags, ev_extra);
+    }
+
+    /* pass back the updated offsets */
+    if (off_in != NULL)
+        *off_in = (off_t)loff_in;
+    if (off_out != NULL)
+        *off_out = (off_t)loff_out;
+
+    /* restore filedescriptor modes */
+    pth_shield {
+        pth_fdmode(fd_out, fdmode_out);
+        pth_fdmode(fd_in, fdmode_in);
+    }
+
+    pth_debug2("pth_splice_ev: leave to thread \"%s\"", pth_current->name);
+    return rv;
+#else
+    return pth_error(-1, ENOSYS);
+#endif
+}
@@ -0,0 +1,1001 @@
+/*
+**  GNU Pth - The GNU Portable Threads
+**  Copyright (c) 1999-2006 Ralf S. Engelschall <rse@engelschall.com>
+**
+**  This file is part of GNU Pth, a non-preemptive thread scheduling
+**  library which can be found at http://www.gnu.org/software/pth/.
+**
+**  This library is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU Lesser General Public
+**  License as published by the Free Software Foundation; either
+**  version 2.1 of the License, or (at your option) any later version.
+**
+**  This library is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**  Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public
+**  License along with this library; if not, write to the Free Software
+**  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+**  USA, or contact Ralf S. Engelschall <rse@engelschall.com>.
+**
+**  pth_iomux.c: Pth I/O readiness multiplexing
+*/
+                             /* ``The best way to predict
+                                  the future is to invent it.''
+                                            -- Alan Kay */
+
+/*
+ * This is the filedescriptor readiness multiplexer of the scheduler.
+ * Instead of collecting the filedescriptors of all waiting threads on
+ * every scheduler pass, the interest in a filedescriptor is registered
+ * once when a thread starts waiting for it (the event is "armed") and
+ * unregistered when the thread stops waiting (the event is "disarmed").
+ * The per-filedescriptor interest is kept in a table indexed by the
+ * filedescriptor and changes are forwarded to the kernel lazily right
+ * before the next poll, so an event which is disarmed and re-armed
+ * between two scheduler passes causes no system call at all.
+ *
+ * Two backends exist: epoll(7) where available (no limit on the
+ * filedescriptor numbers and O(ready) polling) and the portable
+ * select(2) as the fallback. Besides the readiness in the sense of
+ * select(2), the conditions in the sense of poll(2) are kept for the
+ * poll events, so the ones reported by the kernel (like a hangup)
+ * can be passed through.
+ *
+ * Additionally a filedescriptor can be "pinned" for the lifetime of a
+ * connection. Its interest is then registered once (edge-triggered
+ * with epoll(7)) and the reported readiness is cached until an I/O
+ * operation finds the filedescriptor exhausted, so threads reading or
+ * writing it in a loop cause no interest changes at all.
+ */
+
+#include "pth_p.h"
+
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_EPOLL_CREATE)
+#define PTH_IOMUX_EPOLL_AVAILABLE 1
+#endif
+
+/* the available backends */
+#define PTH_IOMUX_SELECT 1
+#define PTH_IOMUX_EPOLL  2
+
+/* the readiness conditions of a filedescriptor */
+#define PTH_IOMUX_IN     _BIT(0) /* readable                 */
+#define PTH_IOMUX_OUT    _BIT(1) /* writeable                */
+#define PTH_IOMUX_PRI    _BIT(2) /* exceptional condition    */
+#define PTH_IOMUX_BAD    _BIT(3) /* filedescriptor invalid   */
+#define PTH_IOMUX_EDGE   _BIT(4) /* edge-triggered interest  */
+#define PTH_IOMUX_HUP    _BIT(5) /* error or hangup          */
+
+/* the maximum number of events fetched from the kernel at once */
+#define PTH_IOMUX_MAXEVENTS 256
+
+/* the per-filedescriptor interest record */
+typedef struct {
+    pth_ring_t waiters;    /* wait nodes of the events armed for the fd */
+    int        perm;       /* permanent interest (not bound to events)  */
+    int        want;       /* interest currently wanted                 */
+    int        kern;       /* interest currently known to the kernel    */
+    int        ready;      /* readiness determined by the last poll     */
+    int        revents;    /* poll(2) conditions of the last poll       */
+    int        dirty;      /* whether fd is already on the change list  */
+    int        lapsed;     /* whether interest lapsed since last flush  */
+    int        always;     /* whether fd cannot be polled at all        */
+    int        pinned;     /* whether fd is pinned by pth_fdpin(3)      */
+    int        mode;       /* pinned: I/O mode as seen by the threads   */
+    int        cache;      /* pinned: readiness cached from the polls   */
+} pth_iomux_fd_t;
+
+static int             pth_iomux_type    = 0;    /* backend in use                  */
+static pth_iomux_fd_t *pth_iomux_tab     = NULL; /* interest table indexed by fd    */
+static int             pth_iomux_tabsize = 0;    /* number of entries in table      */
+static int            *pth_iomux_chg     = NULL; /* fds with changed interest       */
+static int             pth_iomux_chgnum  = 0;    /* number of fds with changes      */
+static int            *pth_iomux_rdy     = NULL; /* fds determined as ready         */
+static int             pth_iomux_rdynum  = 0;    /* number of ready fds             */
+static fd_set          pth_iomux_rfds;           /* select(2): read  interest       */
+static fd_set          pth_iomux_wfds;           /* select(2): write interest       */
+static fd_set          pth_iomux_efds;           /* select(2): exception interest   */
+static int             pth_iomux_fdmax   = -1;   /* select(2): highest fd of sets   */
+#ifdef PTH_IOMUX_EPOLL_AVAILABLE
+static int             pth_iomux_epfd    = -1;   /* epoll(7): instance              */
+static struct epoll_event pth_iomux_epev[PTH_IOMUX_MAXEVENTS];
+#endif
+
+/* create the kernel side of the backend */
+static int pth_iomux_open(void)
+{
+#ifdef PTH_IOMUX_EPOLL_AVAILABLE
+    if ((pth_iomux_epfd = epoll_create(1024)) != -1) {
+        fcntl(pth_iomux_epfd, F_SETFD, FD_CLOEXEC);
+        pth_iomux_type = PTH_IOMUX_EPOLL;
+        return TRUE;
+    }
+#endif
+    FD_ZERO(&pth_iomux_rfds);
+    FD_ZERO(&pth_iomux_wfds);
+    FD_ZERO(&pth_iomux_efds);
+    pth_iomux_fdmax = -1;
+    pth_iomux_type = PTH_IOMUX_SELECT;
+    return TRUE;
+}
+
+/* destroy the kernel side of the backend */
+static void pth_iomux_close(void)
+{
+#ifdef PTH_IOMUX_EPOLL_AVAILABLE
+    if (pth_iomux_epfd != -1) {
+        close(pth_iomux_epfd);
+        pth_iomux_epfd = -1;
+    }
+#endif
+    return;
+}
+
+/* initialize the multiplexer */
+intern int pth_iomux_init(void)
+{
+    pth_iomux_tab     = NULL;
+    pth_iomux_tabsize = 0;
+    pth_iomux_chg     = NULL;
+    pth_iomux_chgnum  = 0;
+    pth_iomux_rdy     = NULL;
+    pth_iomux_rdynum  = 0;
+    return pth_iomux_open();
+}
+
+/* kill the multiplexer */
+intern void pth_iomux_kill(void)
+{
+    pth_iomux_close();
+    if (pth_iomux_tab != NULL)
+        free(pth_iomux_tab);
+    if (pth_iomux_chg != NULL)
+        free(pth_iomux_chg);
+    if (pth_iomux_rdy != NULL)
+        free(pth_iomux_rdy);
+    pth_iomux_tab     = NULL;
+    pth_iomux_tabsize = 0;
+    pth_iomux_chg     = NULL;
+    pth_iomux_chgnum  = 0;
+    pth_iomux_rdy     = NULL;
+    pth_iomux_rdynum  = 0;
+    pth_iomux_type    = 0;
+    return;
+}
+
+/* re-create the kernel side in a forked child (which shares it with the parent) */
+intern void pth_iomux_atfork(void)
+{
+    int fd;
+
+    if (pth_iomux_type != PTH_IOMUX_EPOLL)
+        return;
+    pth_iomux_close();
+    pth_iomux_open();
+    pth_iomux_chgnum = 0;
+    pth_iomux_rdynum = 0;
+    for (fd = 0; fd < pth_iomux_tabsize; fd++) {
+        pth_iomux_tab[fd].kern   = 0;
+        pth_iomux_tab[fd].ready  = 0;
+        pth_iomux_tab[fd].revents = 0;
+        pth_iomux_tab[fd].always = FALSE;
+        pth_iomux_tab[fd].dirty  = FALSE;
+        pth_iomux_tab[fd].lapsed = FALSE;
+        if (pth_iomux_tab[fd].want != 0) {
+            pth_iomux_tab[fd].dirty = TRUE;
+            pth_iomux_chg[pth_iomux_chgnum++] = fd;
+        }
+    }
+    return;
+}
+
+/* return the name of the backend in use */
+intern const char *pth_iomux_name(void)
+{
+    if (pth_iomux_type == PTH_IOMUX_EPOLL)
+        return "epoll";
+    return "select";
+}
+
+/* check whether filedescriptors beyond FD_SETSIZE can be handled */
+intern int pth_iomux_unbounded(void)
+{
+    return (pth_iomux_type == PTH_IOMUX_EPOLL);
+}
+
+/* make sure the interest table covers a filedescriptor */
+static int pth_iomux_grow(int fd)
+{
+    pth_iomux_fd_t *tab;
+    int *lst;
+    int size;
+    int i;
+
+    if (fd < pth_iomux_tabsize)
+        return TRUE;
+    size = (pth_iomux_tabsize > 0 ? pth_iomux_tabsize : 64);
+    while (size <= fd)
+        size *= 2;
+    if ((tab = (pth_iomux_fd_t *)realloc(pth_iomux_tab, size*sizeof(pth_iomux_fd_t))) == NULL)
+        return FALSE;
+    pth_iomux_tab = tab;
+    if ((lst = (int *)realloc(pth_iomux_chg, size*sizeof(int))) == NULL)
+        return FALSE;
+    pth_iomux_chg = lst;
+    if ((lst = (int *)realloc(pth_iomux_rdy, size*sizeof(int))) == NULL)
+        return FALSE;
+    pth_iomux_rdy = lst;
+    for (i = pth_iomux_tabsize; i < size; i++) {
+        pth_ring_init(&tab[i].waiters);
+        tab[i].perm   = 0;
+        tab[i].want   = 0;
+        tab[i].kern   = 0;
+        tab[i].ready  = 0;
+        tab[i].revents = 0;
+        tab[i].dirty  = FALSE;
+        tab[i].lapsed = FALSE;
+        tab[i].always = FALSE;
+        tab[i].pinned = FALSE;
+        tab[i].mode   = PTH_FDMODE_BLOCK;
+        tab[i].cache  = 0;
+    }
+    pth_iomux_tabsize = size;
+    return TRUE;
+}
+
+/* check whether a filedescriptor can be handled by the backend at all */
+#define pth_iomux_fd_ok(fd) \
+    ((fd) >= 0 && ((fd) < FD_SETSIZE || pth_iomux_type == PTH_IOMUX_EPOLL))
+
+/* map event goal to readiness conditions */
+static int pth_iomux_goal2mask(int goal)
+{
+    int mask = 0;
+
+    if (goal & PTH_UNTIL_FD_READABLE)
+        mask |= PTH_IOMUX_IN;
+    if (goal & PTH_UNTIL_FD_WRITEABLE)
+        mask |= PTH_IOMUX_OUT;
+    if (goal & PTH_UNTIL_FD_EXCEPTION)
+        mask |= PTH_IOMUX_PRI;
+    return mask;
+}
+
+/* map poll(2) events to readiness conditions */
+static int pth_iomux_poll2mask(int events)
+{
+    int mask = 0;
+
+    if (events & (POLLIN|POLLRDNORM))
+        mask |= PTH_IOMUX_IN;
+    if (events & (POLLOUT|POLLWRNORM|POLLWRBAND))
+        mask |= PTH_IOMUX_OUT;
+    if (events & (POLLPRI|POLLRDBAND))
+        mask |= PTH_IOMUX_PRI;
+    return mask;
+}
+
+/* map readiness conditions to poll(2) events */
+static int pth_iomux_mask2poll(int mask)
+{
+    int events = 0;
+
+    if (mask & PTH_IOMUX_IN)
+        events |= (POLLIN|POLLRDNORM);
+    if (mask & PTH_IOMUX_OUT)
+        events |= (POLLOUT|POLLWRNORM|POLLWRBAND);
+    if (mask & PTH_IOMUX_PRI)
+        events |= (POLLPRI|POLLRDBAND);
+    if (mask & PTH_IOMUX_BAD)
+        events |= POLLNVAL;
+    return events;
+}
+
+/* remember readiness of a filedescriptor (and its poll(2)
+   conditions as reported by the kernel) for the next dispatching */
+static void pth_iomux_setrevents(int fd, int mask, int revents)
+{
+    if (pth_iomux_tab[fd].ready == 0)
+        pth_iomux_rdy[pth_iomux_rdynum++] = fd;
+    pth_iomux_tab[fd].ready   |= mask;
+    pth_iomux_tab[fd].revents |= revents;
+    return;
+}
+
+/* remember readiness of a filedescriptor for the next dispatching */
+static void pth_iomux_setready(int fd, int mask)
+{
+    pth_iomux_setrevents(fd, mask, pth_iomux_mask2poll(mask));
+    return;
+}
+
+/* append a wait node to a filedescriptor */
+static void pth_iomux_enqueue(pth_evnode_t *en)
+{
+    pth_iomux_fd_t *fe;
+
+    fe = &pth_iomux_tab[en->en_fd];
+    pth_ring_append(&fe->waiters, &en->en_node);
+    /* an edge-triggered registration reports no readiness which was
+       already reported before, so deliver it from the cache instead */
+    if (fe->pinned && (fe->cache & en->en_mask))
+        pth_iomux_setready(en->en_fd, fe->cache & en->en_mask);
+    return;
+}
+
+/* recalculate the wanted interest of a filedescriptor */
+static void pth_iomux_update(int fd)
+{
+    pth_iomux_fd_t *fe;
+    pth_ringnode_t *rn;
+    int want;
+
+    fe = &pth_iomux_tab[fd];
+    want = fe->perm;
+    if (fe->pinned && pth_iomux_type == PTH_IOMUX_EPOLL)
+        want |= PTH_IOMUX_EDGE;
+    rn = pth_ring_first(&fe->waiters);
+    while (rn != NULL) {
+        want |= ((pth_evnode_t *)rn)->en_mask;
+        rn = pth_ring_next(&fe->waiters, rn);
+    }
+    if (want == 0) {
+        /* without any interest the filedescriptor can be closed
+           and its number be reused before the next flush, so
+           its kernel registration has to be re-confirmed then */
+        fe->always = FALSE;
+        if (fe->kern != 0)
+            fe->lapsed = TRUE;
+    }
+    fe->want = want;
+    if ((fe->want != fe->kern || fe->always || fe->lapsed) && !fe->dirty) {
+        fe->dirty = TRUE;
+        pth_iomux_chg[pth_iomux_chgnum++] = fd;
+    }
+    return;
+}
+
+/* register a permanent interest in a filedescriptor (used for internal pipes) */
+intern int pth_iomux_watch(int fd, int goal)
+{
+    if (!pth_iomux_fd_ok(fd))
+        return pth_error(FALSE, EBADF);
+    if (!pth_iomux_grow(fd))
+        return pth_error(FALSE, ENOMEM);
+    pth_iomux_tab[fd].perm = pth_iomux_goal2mask(goal);
+    pth_iomux_update(fd);
+    return TRUE;
+}
+
+/* pin the interest in a filedescriptor (mode is its original I/O mode) */
+intern int pth_iomux_pin(int fd, int mode)
+{
+    pth_iomux_fd_t *fe;
+
+    if (!pth_iomux_fd_ok(fd))
+        return pth_error(FALSE, EBADF);
+    if (!pth_iomux_grow(fd))
+        return pth_error(FALSE, ENOMEM);
+    fe = &pth_iomux_tab[fd];
+    fe->pinned = TRUE;
+    fe->mode   = mode;
+    fe->lapsed = TRUE;
+    /* assume readiness initially: at worst the first
+       I/O operation finds out the opposite immediately */
+    fe->cache  = (PTH_IOMUX_IN|PTH_IOMUX_OUT);
+    /* a permanent level-triggered interest would
+       make select(2) return immediately all the time */
+    if (pth_iomux_type == PTH_IOMUX_EPOLL)
+        fe->perm = (PTH_IOMUX_IN|PTH_IOMUX_OUT);
+    pth_iomux_update(fd);
+    return TRUE;
+}
+
+/* unpin the interest in a filedescriptor (returns its original I/O mode) */
+intern int pth_iomux_unpin(int fd)
+{
+    pth_iomux_fd_t *fe;
+
+    if (!pth_iomux_pinned(fd))
+        return PTH_FDMODE_ERROR;
+    fe = &pth_iomux_tab[fd];
+    fe->pinned = FALSE;
+    fe->perm   = 0;
+    fe->cache  = 0;
+    pth_iomux_update(fd);
+    return fe->mode;
+}
+
+/* check whether a filedescriptor is pinned */
+intern int pth_iomux_pinned(int fd)
+{
+    if (fd < 0 || fd >= pth_iomux_tabsize)
+        return FALSE;
+    return pth_iomux_tab[fd].pinned;
+}
+
+/* switch the I/O mode of a pinned filedescriptor as seen by the threads */
+intern int pth_iomux_fdmode(int fd, int newmode)
+{
+    int oldmode;
+
+    if (!pth_iomux_pinned(fd))
+        return PTH_FDMODE_ERROR;
+    oldmode = pth_iomux_tab[fd].mode;
+    if (newmode == PTH_FDMODE_BLOCK || newmode == PTH_FDMODE_NONBLOCK)
+        pth_iomux_tab[fd].mode = newmode;
+    return oldmode;
+}
+
+/* check the cached readiness of a pinned filedescriptor */
+intern int pth_iomux_cached(int fd, int goal)
+{
+    if (!pth_iomux_pinned(fd))
+        return FALSE;
+    return ((pth_iomux_tab[fd].cache & pth_iomux_goal2mask(goal)) != 0);
+}
+
+/* forget the cached readiness of a pinned filedescriptor (after EAGAIN) */
+intern void pth_iomux_uncache(int fd, int goal)
+{
+    if (!pth_iomux_pinned(fd))
+        return;
+    pth_iomux_tab[fd].cache &= ~(pth_iomux_goal2mask(goal));
+    return;
+}
+
+/* check whether a filedescriptor was found ready by the last poll */
+intern int pth_iomux_ready(int fd)
+{
+    if (fd < 0 || fd >= pth_iomux_tabsize)
+        return FALSE;
+    return (pth_iomux_tab[fd].ready != 0);
+}
+
+/* arm a filedescriptor related event */
+intern int pth_iomux_arm(pth_event_t ev)
+{
+    pth_evnode_t *en;
+    struct pollfd *pfd;
+    int mask;
+    int nfd;
+    int fd;
+    int n;
+    int i;
+
+    if (ev->ev_type == PTH_EVENT_FD) {
+        fd = ev->ev_args.FD.fd;
+        if (!pth_iomux_fd_ok(fd))
+            return pth_error(FALSE, EBADF);
+        if (!pth_iomux_grow(fd))
+            return pth_error(FALSE, ENOMEM);
+        en = &ev->ev_node;
+        en->en_event = ev;
+        en->en_fd    = fd;
+        en->en_mask  = pth_iomux_goal2mask(ev->ev_goal);
+        pth_iomux_enqueue(en);
+        pth_iomux_update(fd);
+    }
+    else if (ev->ev_type == PTH_EVENT_SELECT) {
+        nfd = ev->ev_args.SELECT.nfd;
+        if (nfd < 0 || nfd > FD_SETSIZE)
+            return pth_error(FALSE, EINVAL);
+        if (nfd > 0 && !pth_iomux_grow(nfd-1))
+            return pth_error(FALSE, ENOMEM);
+        /* count the filedescriptors of the sets */
+        n = 0;
+        for (fd = 0; fd < nfd; fd++) {
+            if (   (ev->ev_args.SELECT.rfds != NULL && FD_ISSET(fd, ev->ev_args.SELECT.rfds))
+                || (ev->ev_args.SELECT.wfds != NULL && FD_ISSET(fd, ev->ev_args.SELECT.wfds))
+                || (ev->ev_args.SELECT.efds != NULL && FD_ISSET(fd, ev->ev_args.SELECT.efds)))
+                n++;
+        }
+        ev->ev_nodes  = NULL;
+        ev->ev_nnodes = 0;
+        if (n == 0)
+            return TRUE;
+        if ((ev->ev_nodes = (pth_evnode_t *)malloc(n*sizeof(pth_evnode_t))) == NULL)
+            return pth_error(FALSE, ENOMEM);
+        /* register one wait node per filedescriptor */
+        for (fd = 0; fd < nfd; fd++) {
+            mask = 0;
+            if (ev->ev_args.SELECT.rfds != NULL && FD_ISSET(fd, ev->ev_args.SELECT.rfds))
+                mask |= PTH_IOMUX_IN;
+            if (ev->ev_args.SELECT.wfds != NULL && FD_ISSET(fd, ev->ev_args.SELECT.wfds))
+                mask |= PTH_IOMUX_OUT;
+            if (ev->ev_args.SELECT.efds != NULL && FD_ISSET(fd, ev->ev_args.SELECT.efds))
+                mask |= PTH_IOMUX_PRI;
+            if (mask == 0)
+                continue;
+            en = &ev->ev_nodes[ev->ev_nnodes++];
+            en->en_event = ev;
+            en->en_fd    = fd;
+            en->en_mask  = mask;
+            pth_iomux_enqueue(en);
+            pth_iomux_update(fd);
+        }
+    }
+    else if (ev->ev_type == PTH_EVENT_POLL) {
+        pfd = ev->ev_args.POLL.pfd;
+        nfd = (int)ev->ev_args.POLL.nfd;
+        /* check and count the filedescriptors of interest
+           (negative ones are ignored as with poll(2)) */
+        n = 0;
+        for (i = 0; i < nfd; i++) {
+            if (pfd[i].fd < 0)
+                continue;
+            if (!pth_iomux_fd_ok(pfd[i].fd))
+                return pth_error(FALSE, EINVAL);
+            if (!pth_iomux_grow(pfd[i].fd))
+                return pth_error(FALSE, ENOMEM);
+            n++;
+        }
+        ev->ev_nodes  = NULL;
+        ev->ev_nnodes = 0;
+        if (n == 0)
+            return TRUE;
+        if ((ev->ev_nodes = (pth_evnode_t *)malloc(n*sizeof(pth_evnode_t))) == NULL)
+            return pth_error(FALSE, ENOMEM);
+        /* register one wait node per entry (as poll(2) always
+           reports errors and hangups, even without any events) */
+        for (i = 0; i < nfd; i++) {
+            if (pfd[i].fd < 0)
+                continue;
+            en = &ev->ev_nodes[ev->ev_nnodes++];
+            en->en_event = ev;
+            en->en_fd    = pfd[i].fd;
+            en->en_mask  = pth_iomux_poll2mask(pfd[i].events) | PTH_IOMUX_HUP;
+            pth_iomux_enqueue(en);
+            pth_iomux_update(en->en_fd);
+        }
+    }
+    else
+        return pth_error(FALSE, EINVAL);
+    return TRUE;
+}
+
+/* disarm a filedescriptor related event */
+intern void pth_iomux_disarm(pth_event_t ev)
+{
+    pth_evnode_t *en;
+    int i;
+
+    if (ev->ev_type == PTH_EVENT_FD) {
+        en = &ev->ev_node;
+        pth_ring_delete(&pth_iomux_tab[en->en_fd].waiters, &en->en_node);
+        pth_iomux_update(en->en_fd);
+    }
+    else if (ev->ev_type == PTH_EVENT_SELECT || ev->ev_type == PTH_EVENT_POLL) {
+        for (i = 0; i < ev->ev_nnodes; i++) {
+            en = &ev->ev_nodes[i];
+            pth_ring_delete(&pth_iomux_tab[en->en_fd].waiters, &en->en_node);
+            pth_iomux_update(en->en_fd);
+        }
+        if (ev->ev_nodes != NULL)
+            free(ev->ev_nodes);
+        ev->ev_nodes  = NULL;
+        ev->ev_nnodes = 0;
+    }
+    return;
+}
+
+#ifdef PTH_IOMUX_EPOLL_AVAILABLE
+/* epoll(7): forward one interest change to the kernel */
+static void pth_iomux_epoll_ctl(int fd)
+{
+    pth_iomux_fd_t *fe;
+    struct epoll_event epev;
+    int op;
+    int rc;
+
+    fe = &pth_iomux_tab[fd];
+    if (fe->want == 0) {
+        /* no more interest */
+        epoll_ctl(pth_iomux_epfd, EPOLL_CTL_DEL, fd, &epev);
+        fe->kern = 0;
+        return;
+    }
+    if (fe->always) {
+        /* filedescriptor cannot be polled, so it is always ready */
+        pth_iomux_setready(fd, fe->want);
+        return;
+    }
+    memset(&epev, 0, sizeof(epev));
+    if (fe->want & PTH_IOMUX_IN)
+        epev.events |= EPOLLIN;
+    if (fe->want & PTH_IOMUX_OUT)
+        epev.events |= EPOLLOUT;
+    if (fe->want & PTH_IOMUX_PRI)
+        epev.events |= EPOLLPRI;
+    if (fe->want & PTH_IOMUX_EDGE)
+        epev.events |= EPOLLET;
+    epev.data.fd = fd;
+    op = (fe->kern == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD);
+    rc = epoll_ctl(pth_iomux_epfd, op, fd, &epev);
+    if (rc == -1 && op == EPOLL_CTL_ADD && errno == EEXIST)
+        rc = epoll_ctl(pth_iomux_epfd, EPOLL_CTL_MOD, fd, &epev);
+    else if (rc == -1 && op == EPOLL_CTL_MOD && errno == ENOENT)
+        /* the filedescriptor was closed and re-opened in between */
+        rc = epoll_ctl(pth_iomux_epfd, EPOLL_CTL_ADD, fd, &epev);
+    if (rc == 0)
+        fe->kern = fe->want;
+    else if (errno == EPERM) {
+        /* regular files and alike are always ready (as with select(2)) */
+        fe->kern   = 0;
+        fe->always = TRUE;
+        pth_iomux_setready(fd, fe->want);
+    }
+    else {
+        fe->kern = 0;
+        pth_iomux_setready(fd, PTH_IOMUX_BAD);
+    }
+    return;
+}
+#endif
+
+/* select(2): forward one interest change to the fd sets */
+static void pth_iomux_select_ctl(int fd)
+{
+    pth_iomux_fd_t *fe;
+
+    fe = &pth_iomux_tab[fd];
+    /* select(2) reports errors and hangups as readability only, so an
+       interest in them alone cannot be forwarded without spinning */
+    if (fe->want & PTH_IOMUX_IN)
+        FD_SET(fd, &pth_iomux_rfds);
+    else
+        FD_CLR(fd, &pth_iomux_rfds);
+    if (fe->want & PTH_IOMUX_OUT)
+        FD_SET(fd, &pth_iomux_wfds);
+    else
+        FD_CLR(fd, &pth_iomux_wfds);
+    if (fe->want & PTH_IOMUX_PRI)
+        FD_SET(fd, &pth_iomux_efds);
+    else
+        FD_CLR(fd, &pth_iomux_efds);
+    if (fe->want != 0 && pth_iomux_fdmax < fd)
+        pth_iomux_fdmax = fd;
+    else if (fe->want == 0 && pth_iomux_fdmax == fd) {
+        while (pth_iomux_fdmax >= 0 && pth_iomux_tab[pth_iomux_fdmax].kern == 0)
+            pth_iomux_fdmax--;
+    }
+    return;
+}
+
+/* forward all pending interest changes */
+static void pth_iomux_flush(void)
+{
+    pth_iomux_fd_t *fe;
+    int fd;
+    int i;
+
+    for (i = 0; i < pth_iomux_chgnum; i++) {
+        fd = pth_iomux_chg[i];
+        fe = &pth_iomux_tab[fd];
+        fe->dirty = FALSE;
+        if (fe->want == fe->kern && !fe->always && !fe->lapsed)
+            continue;
+        fe->lapsed = FALSE;
+#ifdef PTH_IOMUX_EPOLL_AVAILABLE
+        if (pth_iomux_type == PTH_IOMUX_EPOLL) {
+            pth_iomux_epoll_ctl(fd);
+            continue;
+        }
+#endif
+        fe->kern = fe->want;
+        pth_iomux_select_ctl(fd);
+    }
+    pth_iomux_chgnum = 0;
+    return;
+}
+
+/* select(2): determine readiness of all filedescriptors */
+static int pth_iomux_select_poll(pth_time_t *timeout)
+{
+    struct timeval delay;
+    struct timeval *pdelay;
+    fd_set rfds;
+    fd_set wfds;
+    fd_set efds;
+    int mask;
+    int rc;
+    int fd;
+
+    memcpy(&rfds, &pth_iomux_rfds, sizeof(fd_set));
+    memcpy(&wfds, &pth_iomux_wfds, sizeof(fd_set));
+    memcpy(&efds, &pth_iomux_efds, sizeof(fd_set));
+    pdelay = NULL;
+    if (timeout != NULL) {
+        pth_time_set(&delay, timeout);
+        pdelay = &delay;
+    }
+    while ((rc = pth_sc(select)(pth_iomux_fdmax+1, &rfds, &wfds, &efds, pdelay)) < 0
+           && errno == EINTR) ;
+    if (rc > 0) {
+        for (fd = 0; fd <= pth_iomux_fdmax; fd++) {
+            mask = 0;
+            if (FD_ISSET(fd, &rfds))
+                mask |= PTH_IOMUX_IN;
+            if (FD_ISSET(fd, &wfds))
+                mask |= PTH_IOMUX_OUT;
+            if (FD_ISSET(fd, &efds))
+                mask |= PTH_IOMUX_PRI;
+            if (mask != 0)
+                pth_iomux_setready(fd, mask);
+        }
+    }
+    else if (rc < 0) {
+        /* re-check each filedescriptor individually to find the culprit */
+        for (fd = 0; fd <= pth_iomux_fdmax; fd++) {
+            if (pth_iomux_tab[fd].kern == 0)
+                continue;
+            FD_ZERO(&rfds);
+            FD_ZERO(&wfds);
+            FD_ZERO(&efds);
+            if (pth_iomux_tab[fd].kern & PTH_IOMUX_IN)
+                FD_SET(fd, &rfds);
+            if (pth_iomux_tab[fd].kern & PTH_IOMUX_OUT)
+                FD_SET(fd, &wfds);
+            if (pth_iomux_tab[fd].kern & PTH_IOMUX_PRI)
+                FD_SET(fd, &efds);
+            pth_time_set(&delay, PTH_TIME_ZERO);
+            while ((rc = pth_sc(select)(fd+1, &rfds, &wfds, &efds, &delay)) < 0
+                   && errno == EINTR) ;
+            if (rc < 0)
+                pth_iomux_setready(fd, PTH_IOMUX_BAD);
+            else if (rc > 0) {
+                mask = 0;
+                if (FD_ISSET(fd, &rfds))
+                    mask |= PTH_IOMUX_IN;
+                if (FD_ISSET(fd, &wfds))
+                    mask |= PTH_IOMUX_OUT;
+                if (FD_ISSET(fd, &efds))
+                    mask |= PTH_IOMUX_PRI;
+                pth_iomux_setready(fd, mask);
+            }
+        }
+        rc = (pth_iomux_rdynum > 0 ? pth_iomux_rdynum : -1);
+    }
+    return rc;
+}
+
+#ifdef PTH_IOMUX_EPOLL_AVAILABLE
+/* epoll(7): determine readiness of all filedescriptors */
+static int pth_iomux_epoll_poll(pth_time_t *timeout, const sigset_t *sigmask)
+{
+#ifndef HAVE_EPOLL_PWAIT
+    sigset_t osigmask;
+#endif
+    int revents;
+    int mask;
+    int ms;
+    int rc;
+    int fd;
+    int i;
+
+    if (timeout == NULL)
+        ms = -1;
+    else
+        /* round up to not wake up too early */
+        ms = (int)(timeout->tv_sec * 1000) + (int)((timeout->tv_usec + 999) / 1000);
+#ifdef HAVE_EPOLL_PWAIT
+    while ((rc = epoll_pwait(pth_iomux_epfd, pth_iomux_epev, PTH_IOMUX_MAXEVENTS, ms, sigmask)) < 0
+           && errno == EINTR) ;
+#else
+    if (sigmask != NULL)
+        pth_sc(sigprocmask)(SIG_SETMASK, sigmask, &osigmask);
+    while ((rc = epoll_wait(pth_iomux_epfd, pth_iomux_epev, PTH_IOMUX_MAXEVENTS, ms)) < 0
+           && errno == EINTR) ;
+    if (sigmask != NULL)
+        pth_sc(sigprocmask)(SIG_SETMASK, &osigmask, NULL);
+#endif
+    for (i = 0; i < rc; i++) {
+        fd = pth_iomux_epev[i].data.fd;
+        if (fd < 0 || fd >= pth_iomux_tabsize || pth_iomux_tab[fd].want == 0)
+            continue;
+        /* map to the semantics of select(2) */
+        mask = 0;
+        if (pth_iomux_epev[i].events & (EPOLLIN|EPOLLHUP|EPOLLERR))
+            mask |= PTH_IOMUX_IN;
+        if (pth_iomux_epev[i].events & (EPOLLOUT|EPOLLHUP|EPOLLERR))
+            mask |= PTH_IOMUX_OUT;
+        if (pth_iomux_epev[i].events & EPOLLPRI)
+            mask |= PTH_IOMUX_PRI;
+        if (pth_iomux_epev[i].events & (EPOLLHUP|EPOLLERR))
+            mask |= PTH_IOMUX_HUP;
+        mask &= pth_iomux_tab[fd].want;
+        if (mask == 0)
+            continue;
+        /* but keep the conditions of poll(2) as reported */
+        revents = 0;
+        if ((pth_iomux_epev[i].events & EPOLLIN) && (mask & PTH_IOMUX_IN))
+            revents |= pth_iomux_mask2poll(PTH_IOMUX_IN);
+        if ((pth_iomux_epev[i].events & EPOLLOUT) && (mask & PTH_IOMUX_OUT))
+            revents |= pth_iomux_mask2poll(PTH_IOMUX_OUT);
+        if (mask & PTH_IOMUX_PRI)
+            revents |= pth_iomux_mask2poll(PTH_IOMUX_PRI);
+        if (pth_iomux_epev[i].events & EPOLLHUP)
+            revents |= POLLHUP;
+        if (pth_iomux_epev[i].events & EPOLLERR)
+            revents |= POLLERR;
+        pth_iomux_setrevents(fd, mask, revents);
+    }
+    return rc;
+}
+#endif
+
+/*
+ * Wait for filedescriptor readiness: a NULL timeout waits without
+ * limit, a zero timeout just polls. While waiting, the signal mask is
+ * temporarily replaced by sigmask (unless it is NULL), atomically with
+ * epoll_pwait(2). The result is the number of ready filedescriptors
+ * (including the ones already known to be ready) or -1 on error. The
+ * readiness itself is delivered to the waiting events by
+ * pth_iomux_dispatch().
+ */
+intern int pth_iomux_poll(pth_time_t *timeout, const sigset_t *sigmask)
+{
+    pth_time_t zero;
+    sigset_t osigmask;
+    int rc;
+
+    /* forward pending interest changes */
+    pth_iomux_flush();
+
+    /* do not block if readiness is already known */
+    if (pth_iomux_rdynum > 0) {
+        pth_time_set(&zero, PTH_TIME_ZERO);
+        timeout = &zero;
+    }
+
+    /* perform the actual polling */
+#ifdef PTH_IOMUX_EPOLL_AVAILABLE
+    if (pth_iomux_type == PTH_IOMUX_EPOLL)
+        rc = pth_iomux_epoll_poll(timeout, sigmask);
+    else
+#endif
+    {
+        if (sigmask != NULL)
+            pth_sc(sigprocmask)(SIG_SETMASK, sigmask, &osigmask);
+        rc = pth_iomux_select_poll(timeout);
+        if (sigmask != NULL)
+            pth_sc(sigprocmask)(SIG_SETMASK, &osigmask, NULL);
+    }
+
+    if (pth_iomux_rdynum > 0)
+        rc = pth_iomux_rdynum;
+    return rc;
+}
+
+/* determine the result of a select event from the polled readiness */
+static void pth_iomux_dispatch_select(pth_event_t ev)
+{
+    fd_set *rfds;
+    fd_set *wfds;
+    fd_set *efds;
+    int ready;
+    int n;
+    int i;
+    int fd;
+
+    rfds = ev->ev_args.SELECT.rfds;
+    wfds = ev->ev_args.SELECT.wfds;
+    efds = ev->ev_args.SELECT.efds;
+
+    /* first pass: count the ready filedescriptors */
+    n = 0;
+    for (i = 0; i < ev->ev_nnodes; i++) {
+        fd = ev->ev_nodes[i].en_fd;
+        ready = pth_iomux_tab[fd].ready;
+        if (ready & PTH_IOMUX_BAD) {
+            ev->ev_status = PTH_STATUS_FAILED;
+            return;
+        }
+        if (rfds != NULL && FD_ISSET(fd, rfds) && (ready & PTH_IOMUX_IN))
+            n++;
+        if (wfds != NULL && FD_ISSET(fd, wfds) && (ready & PTH_IOMUX_OUT))
+            n++;
+        if (efds != NULL && FD_ISSET(fd, efds) && (ready & PTH_IOMUX_PRI))
+            n++;
+    }
+    if (n == 0)
+        return;
+
+    /* second pass: reduce the sets to the ready filedescriptors */
+    for (i = 0; i < ev->ev_nnodes; i++) {
+        fd = ev->ev_nodes[i].en_fd;
+        ready = pth_iomux_tab[fd].ready;
+        if (rfds != NULL && !(ready & PTH_IOMUX_IN))
+            FD_CLR(fd, rfds);
+        if (wfds != NULL && !(ready & PTH_IOMUX_OUT))
+            FD_CLR(fd, wfds);
+        if (efds != NULL && !(ready & PTH_IOMUX_PRI))
+            FD_CLR(fd, efds);
+    }
+    if (ev->ev_args.SELECT.n != NULL)
+        *(ev->ev_args.SELECT.n) = n;
+    ev->ev_status = PTH_STATUS_OCCURRED;
+    return;
+}
+
+/* determine the result of a poll event from the polled conditions */
+static void pth_iomux_dispatch_poll(pth_event_t ev)
+{
+    struct pollfd *pfd;
+    int revents;
+    int nfd;
+    int n;
+    int i;
+    int fd;
+
+    pfd = ev->ev_args.POLL.pfd;
+    nfd = (int)ev->ev_args.POLL.nfd;
+    n = 0;
+    for (i = 0; i < nfd; i++) {
+        fd = pfd[i].fd;
+        revents = 0;
+        if (fd >= 0 && fd < pth_iomux_tabsize)
+            revents = pth_iomux_tab[fd].revents & (pfd[i].events|POLLHUP|POLLERR|POLLNVAL);
+        pfd[i].revents = (short)revents;
+        if (revents != 0)
+            n++;
+    }
+    if (n == 0)
+        return;
+    if (ev->ev_args.POLL.n != NULL)
+        *(ev->ev_args.POLL.n) = n;
+    ev->ev_status = PTH_STATUS_OCCURRED;
+    return;
+}
+
+/* deliver the polled readiness to the armed events */
+intern void pth_iomux_dispatch(void)
+{
+    pth_iomux_fd_t *fe;
+    pth_ringnode_t *rn;
+    pth_evnode_t *en;
+    pth_event_t ev;
+    int i;
+
+    for (i = 0; i < pth_iomux_rdynum; i++) {
+        fe = &pth_iomux_tab[pth_iomux_rdy[i]];
+        if (fe->pinned)
+            fe->cache |= (fe->ready & (PTH_IOMUX_IN|PTH_IOMUX_OUT|PTH_IOMUX_PRI));
+        rn = pth_ring_first(&fe->waiters);
+        while (rn != NULL) {
+            en = (pth_evnode_t *)rn;
+            ev = en->en_event;
+            if (ev->ev_status == PTH_STATUS_PENDING) {
+                if (ev->ev_type == PTH_EVENT_FD) {
+                    if (fe->ready & PTH_IOMUX_BAD)
+                        ev->ev_status = PTH_STATUS_FAILED;
+                    else if (fe->ready & en->en_mask)
+                        ev->ev_status = PTH_STATUS_OCCURRED;
+                }
+                else if (ev->ev_type == PTH_EVENT_SELECT)
+                    pth_iomux_dispatch_select(ev);
+                else if (ev->ev_type == PTH_EVENT_POLL)
+                    pth_iomux_dispatch_poll(ev);
+                if (ev->ev_status != PTH_STATUS_PENDING) {
+                    pth_debug3("pth_iomux_dispatch: [I/O] event %s for thread \"%s\"",
+                               ev->ev_status == PTH_STATUS_OCCURRED ? "occurred" : "failed",
+                               ev->ev_thread->name);
+                    pth_event_wakeup(ev);
+                }
+            }
+            rn = pth_ring_next(&fe->waiters, rn);
+        }
+    }
+
+    /* forget the readiness again */
+    for (i = 0; i < pth_iomux_rdynum; i++) {
+        pth_iomux_tab[pth_iomux_rdy[i]].ready   = 0;
+        pth_iomux_tab[pth_iomux_rdy[i]].revents = 0;
+    }
+    pth_iomux_rdynum = 0;
+    return;
+}
+
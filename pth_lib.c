@@ -84,6 +84,12 @@ int pth_init(void)
     __ex_terminate = pth_ex_terminate;
 #endif
 
+    /* optionally pre-warm the thread control block pool */
+    pth_tcb_pool_prewarm();
+
+    /* install the reporting of stack overflows */
+    pth_tcb_guard_init();
+
     /* spawn the scheduler thread */
     t_attr = pth_attr_new();
     pth_attr_set(t_attr, PTH_ATTR_PRIO,         PTH_PRIO_MAX);
@@ -97,6 +103,7 @@ int pth_init(void)
         pth_shield {
             pth_attr_destroy(t_attr);
             pth_scheduler_kill();
+            pth_tcb_guard_kill();
             pth_syscall_kill();
         }
         return FALSE;
@@ -114,6 +121,7 @@ int pth_init(void)
         pth_shield {
             pth_attr_destroy(t_attr);
             pth_scheduler_kill();
+            pth_tcb_guard_kill();
             pth_syscall_kill();
         }
         return FALSE;
@@ -148,6 +156,10 @@ int pth_kill(void)
     pth_initialized = FALSE;
     pth_tcb_free(pth_sched);
     pth_tcb_free(pth_main);
+    pth_tcb_pool_kill();
+    pth_tcb_prof_kill();
+    pth_tcb_guard_kill();
+    pth_fdmode_kill();
     pth_syscall_kill();
 #ifdef PTH_EX
     __ex_ctx       = __ex_ctx_default;
@@ -199,6 +211,40 @@ long pth_ctrl(unsigned long query, ...)
         int favournew = va_arg(ap, int);
         pth_favournew = (favournew ? 1 : 0);
     }
+    else if (query & PTH_CTRL_GETBACKEND) {
+        rc = (long)pth_iomux_name();
+    }
+    else if (query & PTH_CTRL_TRIMSTACKS) {
+        pth_t t;
+        for (t = pth_pqueue_head(&pth_WQ); t != NULL;
+             t = pth_pqueue_walk(&pth_WQ, t, PTH_WALK_NEXT))
+            rc += (long)pth_tcb_stack_trim(t);
+    }
+    else if (query & PTH_CTRL_TCBPOOL) {
+        int lowat = va_arg(ap, int);
+        int hiwat = va_arg(ap, int);
+        rc = pth_tcb_pool_ctrl(lowat, hiwat);
+    }
+    else if (query & PTH_CTRL_STACKPROF) {
+        int pct = va_arg(ap, int);
+        if (!pth_tcb_prof_ctrl(pct))
+            rc = -1;
+    }
+    else if (query & PTH_CTRL_OFFLOAD) {
+        int nthreads = va_arg(ap, int);
+        int depth    = va_arg(ap, int);
+        if (!pth_offload_ctrl(nthreads, depth))
+            rc = -1;
+    }
+    else if (query & PTH_CTRL_FDCACHE) {
+        int caching = va_arg(ap, int);
+        if (!pth_fdmode_ctrl(caching))
+            rc = -1;
+    }
+    else if (query & PTH_CTRL_IOFIRST) {
+        int iofirst = va_arg(ap, int);
+        pth_high_iofirst = (iofirst ? TRUE : FALSE);
+    }
     else
         rc = -1;
     va_end(ap);
@@ -221,29 +267,10 @@ static void pth_spawn_trampoline(void)
     /* NOTREACHED */
     abort();
 }
-pth_t pth_spawn(pth_attr_t attr, void *(*func)(void *), void *arg)
+/* initialize a freshly allocated thread control block */
+static int pth_spawn_setup(pth_t t, pth_attr_t attr, void *(*func)(void *), void *arg,
+                           pth_time_t *ts, const char *name)
 {
-    pth_t t;
-    unsigned int stacksize;
-    void *stackaddr;
-    pth_time_t ts;
-
-    pth_debug1("pth_spawn: enter");
-
-    /* consistency */
-    if (func == NULL)
-        return pth_error((pth_t)NULL, EINVAL);
-
-    /* support the special case of main() */
-    if (func == (void *(*)(void *))(-1))
-        func = NULL;
-
-    /* allocate a new thread control block */
-    stacksize = (attr == PTH_ATTR_DEFAULT ? 64*1024 : attr->a_stacksize);
-    stackaddr = (attr == PTH_ATTR_DEFAULT ? NULL    : attr->a_stackaddr);
-    if ((t = pth_tcb_alloc(stacksize, stackaddr)) == NULL)
-        return pth_error((pth_t)NULL, errno);
-
     /* configure remaining attributes */
     if (attr != PTH_ATTR_DEFAULT) {
         /* overtake fields from the attribute structure */
@@ -251,7 +278,6 @@ pth_t pth_spawn(pth_attr_t attr, void *(*func)(void *), void *arg)
         t->joinable    = attr->a_joinable;
         t->cancelstate = attr->a_cancelstate;
         t->dispatches  = attr->a_dispatches;
-        pth_util_cpystrn(t->name, attr->a_name, PTH_TCB_NAMELEN);
     }
     else if (pth_current != NULL) {
         /* overtake some fields from the parent thread */
@@ -259,9 +285,6 @@ pth_t pth_spawn(pth_attr_t attr, void *(*func)(void *), void *arg)
         t->joinable    = pth_current->joinable;
         t->cancelstate = pth_current->cancelstate;
         t->dispatches  = 0;
-        pth_snprintf(t->name, PTH_TCB_NAMELEN, "%s.child@%d=0x%lx",
-                     pth_current->name, (unsigned int)time(NULL),
-                     (unsigned long)pth_current);
     }
     else {
         /* defaults */
@@ -269,23 +292,39 @@ pth_t pth_spawn(pth_attr_t attr, void *(*func)(void *), void *arg)
         t->joinable    = TRUE;
         t->cancelstate = PTH_CANCEL_DEFAULT;
         t->dispatches  = 0;
+    }
+
+    /* name the thread (a batch shares the name of its first thread) */
+    if (name != NULL)
+        memcpy(t->name, name, PTH_TCB_NAMELEN);
+    else if (attr != PTH_ATTR_DEFAULT)
+        pth_util_cpystrn(t->name, attr->a_name, PTH_TCB_NAMELEN);
+    else if (pth_current != NULL)
+        pth_snprintf(t->name, PTH_TCB_NAMELEN, "%s.child@%d=0x%lx",
+                     pth_current->name, (unsigned int)time(NULL),
+                     (unsigned long)pth_current);
+    else
         pth_snprintf(t->name, PTH_TCB_NAMELEN,
                      "user/%x", (unsigned int)time(NULL));
-    }
 
     /* initialize the time points and ranges */
-    pth_time_set(&ts, PTH_TIME_NOW);
-    pth_time_set(&t->spawned, &ts);
-    pth_time_set(&t->lastran, &ts);
+    pth_time_set(&t->spawned, ts);
+    pth_time_set(&t->lastran, ts);
     pth_time_set(&t->running, PTH_TIME_ZERO);
 
     /* initialize events */
-    t->events = NULL;
+    t->events   = NULL;
+    t->wakeup   = FALSE;
+    t->wakenext = NULL;
+    pth_ring_init(&t->waiters);
 
     /* clear raised signals */
     sigemptyset(&t->sigpending);
     t->sigpendcnt = 0;
 
+    /* a thread starts with the signal mask of its creator */
+    t->sigmaskown = (pth_current != NULL ? pth_current->sigmaskown : FALSE);
+
     /* remember the start routine and arguments for our trampoline */
     t->start_func = func;
     t->start_arg  = arg;
@@ -312,10 +351,47 @@ pth_t pth_spawn(pth_attr_t attr, void *(*func)(void *), void *arg)
     /* initialize the machine context of this new thread */
     if (t->stacksize > 0) { /* the "main thread" (indicated by == 0) is special! */
         if (!pth_mctx_set(&t->mctx, pth_spawn_trampoline,
-                          t->stack, ((char *)t->stack+t->stacksize))) {
-            pth_shield { pth_tcb_free(t); }
-            return pth_error((pth_t)NULL, errno);
-        }
+                          t->stack, ((char *)t->stack+t->stacksize)))
+            return FALSE;
+    }
+    else
+        pth_mctx_init(&t->mctx);
+
+    /* a thread of a creator with a changed signal mask starts with it */
+    if (t->sigmaskown)
+        pth_mctx_siginherit(&t->mctx);
+    return TRUE;
+}
+pth_t pth_spawn(pth_attr_t attr, void *(*func)(void *), void *arg)
+{
+    pth_t t;
+    unsigned int stacksize;
+    void *stackaddr;
+    pth_time_t ts;
+
+    pth_debug1("pth_spawn: enter");
+
+    /* consistency */
+    if (func == NULL)
+        return pth_error((pth_t)NULL, EINVAL);
+
+    /* support the special case of main() */
+    if (func == (void *(*)(void *))(-1))
+        func = NULL;
+
+    /* allocate a new thread control block */
+    stacksize = (attr == PTH_ATTR_DEFAULT ? 64*1024 : attr->a_stacksize);
+    stackaddr = (attr == PTH_ATTR_DEFAULT ? NULL    : attr->a_stackaddr);
+    if (attr != PTH_ATTR_DEFAULT && stackaddr == NULL)
+        stacksize = pth_tcb_stack_advise(attr->a_name, stacksize);
+    if ((t = pth_tcb_alloc(stacksize, stackaddr)) == NULL)
+        return pth_error((pth_t)NULL, errno);
+
+    /* initialize it */
+    pth_time_set(&ts, PTH_TIME_NOW);
+    if (!pth_spawn_setup(t, attr, func, arg, &ts, NULL)) {
+        pth_shield { pth_tcb_free(t); }
+        return pth_error((pth_t)NULL, errno);
     }
 
     /* finally insert it into the "new queue" where
@@ -332,6 +408,64 @@ pth_t pth_spawn(pth_attr_t attr, void *(*func)(void *), void *arg)
     return t;
 }
 
+/* spawn a batch of threads with identical attributes and start routine */
+int pth_spawn_n(pth_attr_t attr, void *(*func)(void *), void **args, int n, pth_t *tids)
+{
+    unsigned int stacksize;
+    void *stackaddr;
+    pth_time_t ts;
+    pth_t t;
+    int i;
+
+    pth_debug2("pth_spawn_n: enter (%d threads)", n);
+
+    /* consistency */
+    if (func == NULL || n < 0 || (n > 0 && tids == NULL))
+        return pth_error(FALSE, EINVAL);
+    if (n == 0)
+        return TRUE;
+
+    /* a loaned stack cannot be shared by several threads */
+    if (attr != PTH_ATTR_DEFAULT && attr->a_stackaddr != NULL && n > 1)
+        return pth_error(FALSE, EINVAL);
+
+    /* allocate and initialize all thread control blocks in one pass,
+       sharing a single timestamp and the name of the first thread */
+    stacksize = (attr == PTH_ATTR_DEFAULT ? 64*1024 : attr->a_stacksize);
+    stackaddr = (attr == PTH_ATTR_DEFAULT ? NULL    : attr->a_stackaddr);
+    if (attr != PTH_ATTR_DEFAULT && stackaddr == NULL)
+        stacksize = pth_tcb_stack_advise(attr->a_name, stacksize);
+    pth_time_set(&ts, PTH_TIME_NOW);
+    for (i = 0; i < n; i++) {
+        if ((t = pth_tcb_alloc(stacksize, stackaddr)) == NULL)
+            break;
+        if (!pth_spawn_setup(t, attr, func, (args != NULL ? args[i] : NULL),
+                             &ts, (i > 0 ? tids[0]->name : NULL))) {
+            pth_shield { pth_tcb_free(t); }
+            break;
+        }
+        t->state = PTH_STATE_NEW;
+        tids[i] = t;
+    }
+
+    /* all or nothing */
+    if (i < n) {
+        pth_shield {
+            while (i-- > 0) {
+                pth_tcb_free(tids[i]);
+                tids[i] = NULL;
+            }
+        }
+        return pth_error(FALSE, errno);
+    }
+
+    /* finally splice all of them into the "new queue" at once */
+    pth_pqueue_splice(&pth_NQ, tids[0]->prio, tids, n);
+
+    pth_debug1("pth_spawn_n: leave");
+    return TRUE;
+}
+
 /* returns the current thread */
 pth_t pth_self(void)
 {
@@ -358,6 +492,8 @@ int pth_raise(pth_t t, int sig)
             sigaddset(&t->sigpending, sig);
             t->sigpendcnt++;
         }
+        if (pth_pqueue_contains(&pth_WQ, t))
+            pth_sched_wq_raise(t);
         pth_yield(t);
         return TRUE;
     }
@@ -366,11 +502,13 @@ int pth_raise(pth_t t, int sig)
 /* check whether a thread exists */
 intern int pth_thread_exists(pth_t t)
 {
-    if (!pth_pqueue_contains(&pth_NQ, t))
-        if (!pth_pqueue_contains(&pth_RQ, t))
-            if (!pth_pqueue_contains(&pth_WQ, t))
-                if (!pth_pqueue_contains(&pth_SQ, t))
-                    if (!pth_pqueue_contains(&pth_DQ, t))
+    /* the handle might be stale, so we cannot trust the queue
+       tag in its thread control block and have to search for it */
+    if (!pth_pqueue_search(&pth_NQ, t))
+        if (!pth_pqueue_search(&pth_RQ, t))
+            if (!pth_pqueue_search(&pth_WQ, t))
+                if (!pth_pqueue_search(&pth_SQ, t))
+                    if (!pth_pqueue_search(&pth_DQ, t))
                         return pth_error(FALSE, ESRCH); /* not found */
     return TRUE;
 }
@@ -378,6 +516,13 @@ intern int pth_thread_exists(pth_t t)
 /* cleanup a particular thread */
 intern void pth_thread_cleanup(pth_t thread)
 {
+#ifdef PTH_URING
+    /* abandon the I/O requests of an aborted thread */
+    pth_uring_abandon(thread);
+#endif
+    /* abandon the offloaded jobs of an aborted thread */
+    pth_offload_abandon(thread);
+
     /* run the cleanup handlers */
     if (thread->cleanups != NULL)
         pth_cleanup_popall(thread, TRUE);
@@ -389,6 +534,9 @@ intern void pth_thread_cleanup(pth_t thread)
     /* release still acquired mutex variables */
     pth_mutex_releaseall(thread);
 
+    /* record the stack depth in the stack profile */
+    pth_tcb_stack_record(thread);
+
     return;
 }
 
@@ -448,6 +596,7 @@ void pth_exit(void *value)
          */
         pth_current->join_arg = value;
         pth_current->state = PTH_STATE_DEAD;
+        pth_event_tidnotify(pth_current);
         pth_debug2("pth_exit: switching from thread \"%s\" to scheduler", pth_current->name);
         pth_mctx_switch(&pth_current->mctx, &pth_sched->mctx);
     }
@@ -516,14 +665,14 @@ int pth_yield(pth_t to)
     if (to != NULL && q != NULL)
         pth_pqueue_favorite(q, to);
 
-    /* switch to scheduler */
+    /* hand off control to the next thread */
     if (to != NULL)
-        pth_debug2("pth_yield: give up control to scheduler "
+        pth_debug2("pth_yield: give up control "
                    "in favour of thread \"%s\"", to->name);
     else
-        pth_debug1("pth_yield: give up control to scheduler");
-    pth_mctx_switch(&pth_current->mctx, &pth_sched->mctx);
-    pth_debug1("pth_yield: got back control from scheduler");
+        pth_debug1("pth_yield: give up control");
+    pth_sched_handoff();
+    pth_debug1("pth_yield: got back control");
 
     pth_debug2("pth_yield: leave to thread \"%s\"", pth_current->name);
     return TRUE;
@@ -548,7 +697,10 @@ int pth_suspend(pth_t t)
         return pth_error(FALSE, EPERM);
     if (!pth_pqueue_contains(q, t))
         return pth_error(FALSE, ESRCH);
-    pth_pqueue_delete(q, t);
+    if (q == &pth_WQ)
+        pth_sched_wq_delete(t);
+    else
+        pth_pqueue_delete(q, t);
     pth_pqueue_insert(&pth_SQ, PTH_PRIO_STD, t);
     pth_debug2("pth_suspend: suspend thread \"%s\"\n", t->name);
     return TRUE;
@@ -572,17 +724,207 @@ int pth_resume(pth_t t)
         case PTH_STATE_WAITING: q = &pth_WQ; break;
         default:                q = NULL;
     }
-    pth_pqueue_insert(q, PTH_PRIO_STD, t);
+    if (q == &pth_WQ)
+        pth_sched_wq_insert(t);
+    else
+        pth_pqueue_insert(q, PTH_PRIO_STD, t);
     pth_debug2("pth_resume: resume thread \"%s\"\n", t->name);
     return TRUE;
 }
 
+/*
+ * The I/O mode of filedescriptors can optionally be cached (see
+ * PTH_CTRL_FDCACHE), so the I/O functions determine and switch it
+ * without fcntl(2) round-trips. Additionally the filedescriptors can
+ * be kept in non-blocking mode permanently, while the mode seen by the
+ * threads is maintained in the cache only. This relies on the
+ * filedescriptors being closed, duplicated and switched with the Pth
+ * functions only (which forget the cached mode). Duplicates share the
+ * mode, so it is never cached for them. Whether a filedescriptor refers
+ * to a disk file is remembered in the same table even without caching,
+ * because the I/O functions need it on every call when offloading.
+ */
+typedef struct {
+    int flags;  /* file status flags (-1: unknown)                 */
+    int mode;   /* I/O mode as seen by the threads                 */
+    int disk;   /* whether fd refers to a disk file (-1: unknown)  */
+    int shared; /* whether the flags are shared with a duplicate   */
+} pth_fdmode_ent_t;
+
+static int               pth_fdmode_caching = PTH_FDCACHE_OFF;
+static pth_fdmode_ent_t *pth_fdmode_tab     = NULL;
+static int               pth_fdmode_tabsize = 0;
+
+/* find the table entry of a filedescriptor (growing the table on demand) */
+static pth_fdmode_ent_t *pth_fdmode_slot(int fd, int grow)
+{
+    pth_fdmode_ent_t *tab;
+    int size;
+    int i;
+
+    if (fd < 0)
+        return NULL;
+    if (fd >= pth_fdmode_tabsize) {
+        if (!grow)
+            return NULL;
+        size = (pth_fdmode_tabsize > 0 ? pth_fdmode_tabsize : 64);
+        while (size <= fd)
+            size *= 2;
+        if ((tab = (pth_fdmode_ent_t *)realloc(pth_fdmode_tab, size*sizeof(pth_fdmode_ent_t))) == NULL)
+            return NULL;
+        for (i = pth_fdmode_tabsize; i < size; i++) {
+            tab[i].flags  = -1;
+            tab[i].mode   = PTH_FDMODE_BLOCK;
+            tab[i].disk   = -1;
+            tab[i].shared = FALSE;
+        }
+        pth_fdmode_tab     = tab;
+        pth_fdmode_tabsize = size;
+    }
+    return &pth_fdmode_tab[fd];
+}
+
+/* find the cache entry of a filedescriptor (growing the table on demand) */
+static pth_fdmode_ent_t *pth_fdmode_entry(int fd, int grow)
+{
+    if (pth_fdmode_caching == PTH_FDCACHE_OFF)
+        return NULL;
+    return pth_fdmode_slot(fd, grow);
+}
+
+/* switch the filedescriptors kept in non-blocking mode
+   back to the mode seen by the threads and drop the cache */
+static void pth_fdmode_flush(void)
+{
+    pth_fdmode_ent_t *fe;
+    int fd;
+
+    for (fd = 0; fd < pth_fdmode_tabsize; fd++) {
+        fe = &pth_fdmode_tab[fd];
+        if (   fe->flags != -1 && !fe->shared && !pth_iomux_pinned(fd)
+            && (fe->flags & O_NONBLOCKING) && fe->mode == PTH_FDMODE_BLOCK)
+            fcntl(fd, F_SETFL, (fe->flags & ~(O_NONBLOCKING)));
+    }
+    if (pth_fdmode_tab != NULL)
+        free(pth_fdmode_tab);
+    pth_fdmode_tab     = NULL;
+    pth_fdmode_tabsize = 0;
+    return;
+}
+
+/* configure the caching of the I/O mode of filedescriptors */
+intern int pth_fdmode_ctrl(int caching)
+{
+    if (   caching != PTH_FDCACHE_OFF && caching != PTH_FDCACHE_ON
+        && caching != PTH_FDCACHE_NONBLOCK)
+        return pth_error(FALSE, EINVAL);
+    if (caching != pth_fdmode_caching)
+        pth_fdmode_flush();
+    pth_fdmode_caching = caching;
+    return TRUE;
+}
+
+/* drop the cache (but keep the configuration) */
+intern void pth_fdmode_kill(void)
+{
+    pth_fdmode_flush();
+    return;
+}
+
+/* forget the cached I/O mode of a filedescriptor because it was closed
+   or replaced (shared is FALSE), duplicated, so it is never cached again
+   until it is closed (shared is TRUE) or just switched (shared is -1) */
+intern void pth_fdmode_forget(int fd, int shared)
+{
+    pth_fdmode_ent_t *fe;
+
+    if ((fe = pth_fdmode_slot(fd, (shared == TRUE && pth_fdmode_caching != PTH_FDCACHE_OFF))) == NULL)
+        return;
+    fe->flags = -1;
+    if (shared != -1) {
+        fe->disk   = -1;
+        fe->shared = shared;
+    }
+    return;
+}
+
+/* check whether the filedescriptor is known to be valid from the cache */
+intern int pth_fdmode_cached(int fd)
+{
+    pth_fdmode_ent_t *fe;
+
+    if ((fe = pth_fdmode_entry(fd, FALSE)) == NULL)
+        return FALSE;
+    return (fe->flags != -1 || fe->disk != -1);
+}
+
+/* check whether a filedescriptor refers to a disk file, i.e., a regular
+   file or block device (for which readiness is meaningless) */
+intern int pth_fdmode_disk(int fd)
+{
+    pth_fdmode_ent_t *fe;
+    struct stat sb;
+    int disk;
+
+    fe = pth_fdmode_slot(fd, TRUE);
+    if (fe != NULL && fe->disk != -1)
+        return fe->disk;
+    if (fstat(fd, &sb) == -1)
+        return FALSE;
+    disk = (S_ISREG(sb.st_mode) || S_ISBLK(sb.st_mode));
+    if (fe != NULL)
+        fe->disk = disk;
+    return disk;
+}
+
+/* check whether a filedescriptor is kept in non-blocking mode
+   although the threads see it in blocking mode */
+intern int pth_fdmode_kept(int fd)
+{
+    pth_fdmode_ent_t *fe;
+
+    if ((fe = pth_fdmode_entry(fd, FALSE)) == NULL)
+        return FALSE;
+    return (   fe->flags != -1 && (fe->flags & O_NONBLOCKING)
+            && fe->mode == PTH_FDMODE_BLOCK);
+}
+
 /* switch a filedescriptor's I/O mode */
 int pth_fdmode(int fd, int newmode)
 {
+    pth_fdmode_ent_t *fe;
     int fdmode;
     int oldmode;
 
+    /* pinned filedescriptors stay in non-blocking mode
+       and have their mode just switched for the threads */
+    if (pth_iomux_pinned(fd))
+        return pth_iomux_fdmode(fd, newmode);
+
+    /* use and maintain the cached mode */
+    if ((fe = pth_fdmode_entry(fd, TRUE)) != NULL && !fe->shared) {
+        if (fe->flags == -1) {
+            if ((fe->flags = fcntl(fd, F_GETFL, NULL)) == -1)
+                return PTH_FDMODE_ERROR;
+            fe->mode = ((fe->flags & O_NONBLOCKING) ? PTH_FDMODE_NONBLOCK : PTH_FDMODE_BLOCK);
+        }
+        oldmode = fe->mode;
+        fdmode = fe->flags;
+        if (newmode == PTH_FDMODE_NONBLOCK)
+            fdmode |= O_NONBLOCKING;
+        else if (newmode == PTH_FDMODE_BLOCK && pth_fdmode_caching != PTH_FDCACHE_NONBLOCK)
+            fdmode &= ~(O_NONBLOCKING);
+        if (newmode == PTH_FDMODE_BLOCK || newmode == PTH_FDMODE_NONBLOCK)
+            fe->mode = newmode;
+        if (fdmode != fe->flags) {
+            if (fcntl(fd, F_SETFL, fdmode) == -1)
+                fe->flags = -1;
+            else
+                fe->flags = fdmode;
+        }
+        return oldmode;
+    }
+
     /* retrieve old mode (usually a very cheap operation) */
     if ((fdmode = fcntl(fd, F_GETFL, NULL)) == -1)
         oldmode = PTH_FDMODE_ERROR;
@@ -601,6 +943,40 @@ int pth_fdmode(int fd, int newmode)
     return oldmode;
 }
 
+/* pin the readiness interest in a filedescriptor */
+int pth_fdpin(int fd)
+{
+    int fdmode;
+
+    pth_implicit_init();
+    if (!pth_util_fd_valid(fd))
+        return pth_error(FALSE, EBADF);
+    if (pth_iomux_pinned(fd))
+        return pth_error(FALSE, EBUSY);
+
+    /* the I/O functions rely on the cached readiness only,
+       so the filedescriptor has to be in non-blocking mode */
+    if ((fdmode = pth_fdmode(fd, PTH_FDMODE_NONBLOCK)) == PTH_FDMODE_ERROR)
+        return pth_error(FALSE, EBADF);
+    if (!pth_iomux_pin(fd, fdmode)) {
+        pth_shield { pth_fdmode(fd, fdmode); }
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* unpin the readiness interest in a filedescriptor */
+int pth_fdunpin(int fd)
+{
+    int fdmode;
+
+    pth_implicit_init();
+    if ((fdmode = pth_iomux_unpin(fd)) == PTH_FDMODE_ERROR)
+        return pth_error(FALSE, EINVAL);
+    pth_shield { pth_fdmode(fd, fdmode); }
+    return TRUE;
+}
+
 /* wait for specific amount of time */
 int pth_nap(pth_time_t naptime)
 {
@@ -36,13 +36,20 @@
  * pointer and (usually) the signals mask is stored. When the
  * signal mask cannot be implicitly stored in `jb', it's
  * alternatively stored explicitly in `sigs'. The `error' stores
- * the value of `errno'.
+ * the value of `errno'. For the assembly method only the stack pointer
+ * is stored in `sp' (the registers are on the stack) and `sigsown'
+ * flags whether `sigs' holds an own signal mask of the context.
  */
 
 #if PTH_MCTX_MTH(mcsc)
 #include <ucontext.h>
 #endif
 
+#if PTH_MCTX_MTH(asm)
+#define pth_mctx_asm_switch __pth_mctx_asm_switch
+extern void pth_mctx_asm_switch(void **, void *);
+#endif
+
 typedef struct pth_mctx_st pth_mctx_t;
 struct pth_mctx_st {
 #if PTH_MCTX_MTH(mcsc)
@@ -50,6 +57,9 @@ struct pth_mctx_st {
     int restored;
 #elif PTH_MCTX_MTH(sjlj)
     pth_sigjmpbuf jb;
+#elif PTH_MCTX_MTH(asm)
+    void *sp;
+    int sigsown;
 #else
 #error "unknown mctx method"
 #endif
@@ -82,6 +92,8 @@ struct pth_mctx_st {
 #define pth_mctx_save(mctx) \
         ( (mctx)->error = errno, \
           pth_sigsetjmp((mctx)->jb) )
+#elif PTH_MCTX_MTH(asm)
+/* (not required, the context is saved by pth_mctx_switch only) */
 #else
 #error "unknown mctx method"
 #endif
@@ -99,6 +111,9 @@ struct pth_mctx_st {
 #define pth_mctx_restore(mctx) \
         ( errno = (mctx)->error, \
           (void)pth_siglongjmp((mctx)->jb, 1) )
+#elif PTH_MCTX_MTH(asm)
+#define pth_mctx_restore(mctx) \
+        pth_mctx_asm_restore(mctx)
 #else
 #error "unknown mctx method"
 #endif
@@ -135,12 +150,103 @@ struct pth_mctx_st {
     if (pth_mctx_save(old) == 0) \
         pth_mctx_restore(new); \
     pth_mctx_restored(old);
+#elif PTH_MCTX_MTH(asm)
+#define pth_mctx_switch(old,new) \
+    _pth_mctx_switch_debug \
+    if ((old)->sigsown || (new)->sigsown) \
+        pth_mctx_asm_sigswitch(old, new); \
+    (old)->error = errno; \
+    pth_mctx_asm_switch(&((old)->sp), (new)->sp); \
+    errno = (old)->error;
 #else
 #error "unknown mctx method"
 #endif
 
+/*
+ * initialize a machine context which is saved
+ * on the first switch away from it (the main thread)
+ */
+#if PTH_MCTX_MTH(asm)
+#define pth_mctx_init(mctx) \
+        ((mctx)->sigsown = FALSE)
+#else
+#define pth_mctx_init(mctx) \
+        ((void)(mctx))
+#endif
+
 #endif /* cpp */
 
+/*
+** ____ MACHINE STATE SIGNAL MASK ____________________________________
+*/
+
+#if PTH_MCTX_MTH(asm)
+intern sigset_t pth_mctx_sigcommon; /* signal mask shared by contexts without an own one */
+#endif
+
+/* change the signal mask of the current machine context */
+intern int pth_mctx_sigmask(pth_mctx_t *mctx, int how, const sigset_t *set, sigset_t *oset)
+{
+    int rv;
+#if PTH_MCTX_MTH(asm)
+    sigset_t ss;
+
+    /*
+     * The assembly switching does not switch the signal mask, so all
+     * contexts share the signal mask of the process. Only a context
+     * which changes its signal mask gets an own one, which then is
+     * installed whenever the context is entered (and the shared one
+     * is installed again whenever it is left).
+     */
+    if ((rv = pth_sc(sigprocmask)(how, set, &ss)) != 0)
+        return rv;
+    if (oset != NULL)
+        memcpy(oset, &ss, sizeof(sigset_t));
+    if (set != NULL) {
+        if (!mctx->sigsown) {
+            memcpy(&pth_mctx_sigcommon, &ss, sizeof(sigset_t));
+            mctx->sigsown = TRUE;
+        }
+        pth_sc(sigprocmask)(SIG_SETMASK, NULL, &mctx->sigs);
+    }
+#else
+    /* change the real (per-thread saved/restored) signal mask */
+    if ((rv = pth_sc(sigprocmask)(how, set, oset)) != 0)
+        return rv;
+
+    /* update the explicitly remembered signal mask copy for the scheduler */
+    if (set != NULL)
+        pth_sc(sigprocmask)(SIG_SETMASK, NULL, &(mctx->sigs));
+#endif
+    return rv;
+}
+
+/* let the current machine context use the signal mask shared by the contexts again */
+intern void pth_mctx_sigshare(pth_mctx_t *mctx, const sigset_t *sigs)
+{
+#if PTH_MCTX_MTH(asm)
+    /* (the shared signal mask is the one remembered on the first change) */
+    if (mctx->sigsown) {
+        pth_sc(sigprocmask)(SIG_SETMASK, &pth_mctx_sigcommon, NULL);
+        mctx->sigsown = FALSE;
+    }
+#else
+    /* (every context switches its own signal mask, so install the given one) */
+    pth_mctx_sigmask(mctx, SIG_SETMASK, sigs, NULL);
+#endif
+    return;
+}
+
+/* let a new machine context start with the signal mask of the current one */
+intern void pth_mctx_siginherit(pth_mctx_t *mctx)
+{
+    pth_sc(sigprocmask)(SIG_SETMASK, NULL, &mctx->sigs);
+#if PTH_MCTX_MTH(asm)
+    mctx->sigsown = TRUE;
+#endif
+    return;
+}
+
 /*
 ** ____ MACHINE STATE INITIALIZATION ________________________________
 */
@@ -555,6 +661,173 @@ pth_mctx_set(pth_mctx_t *mctx, void (*func)(void),
 }
 */
 
+#elif PTH_MCTX_MTH(asm)
+
+/*
+ * VARIANT 6: HAND-WRITTEN ASSEMBLY CONTEXT SWITCHING
+ *
+ * The makecontext(2)/swapcontext(2) and sigsetjmp(3)/siglongjmp(3)
+ * approaches switch the signal mask, too, i.e., they perform a
+ * sigprocmask(2) system call on every context switch. But as the
+ * context switching is a regular function call, only the registers
+ * the C calling convention requires to be preserved across calls
+ * have to be switched. So here the switching just pushes the
+ * callee-saved registers onto the current stack, saves the stack
+ * pointer, loads the stack pointer of the new context and pops its
+ * registers. The signal mask is switched separately and only for
+ * contexts which have changed their own signal mask.
+ *
+ * A new context gets a stack which looks like the context was just
+ * switched away from, except that its return address points to a
+ * bootstrap routine which calls the startup function.
+ */
+
+#if PTH_STACKGROWTH >= 0
+#error "assembly machine context switching requires a downwards growing stack"
+#endif
+
+#if defined(__x86_64__)
+__asm__ (
+    ".text\n"
+    ".globl __pth_mctx_asm_switch\n"
+    ".hidden __pth_mctx_asm_switch\n"
+    ".type __pth_mctx_asm_switch,@function\n"
+    ".p2align 4\n"
+    "__pth_mctx_asm_switch:\n"
+    "    pushq %rbp\n"
+    "    pushq %rbx\n"
+    "    pushq %r12\n"
+    "    pushq %r13\n"
+    "    pushq %r14\n"
+    "    pushq %r15\n"
+    "    subq $8, %rsp\n"
+    "    stmxcsr (%rsp)\n"
+    "    fnstcw 4(%rsp)\n"
+    "    movq %rsp, (%rdi)\n"
+    "    movq %rsi, %rsp\n"
+    "    ldmxcsr (%rsp)\n"
+    "    fldcw 4(%rsp)\n"
+    "    addq $8, %rsp\n"
+    "    popq %r15\n"
+    "    popq %r14\n"
+    "    popq %r13\n"
+    "    popq %r12\n"
+    "    popq %rbx\n"
+    "    popq %rbp\n"
+    "    ret\n"
+    ".size __pth_mctx_asm_switch,.-__pth_mctx_asm_switch\n"
+    ".type __pth_mctx_asm_boot,@function\n"
+    ".p2align 4\n"
+    "__pth_mctx_asm_boot:\n"
+    "    callq *%r12\n"
+    "    ud2\n"
+    ".size __pth_mctx_asm_boot,.-__pth_mctx_asm_boot\n"
+);
+#define PTH_MCTX_ASM_FRAME 8  /* mxcsr+fpucw, r15, r14, r13, r12, rbx, rbp, return address */
+#elif defined(__aarch64__)
+__asm__ (
+    ".text\n"
+    ".globl __pth_mctx_asm_switch\n"
+    ".hidden __pth_mctx_asm_switch\n"
+    ".type __pth_mctx_asm_switch,%function\n"
+    ".p2align 4\n"
+    "__pth_mctx_asm_switch:\n"
+    "    sub sp, sp, #160\n"
+    "    stp x19, x20, [sp, #0]\n"
+    "    stp x21, x22, [sp, #16]\n"
+    "    stp x23, x24, [sp, #32]\n"
+    "    stp x25, x26, [sp, #48]\n"
+    "    stp x27, x28, [sp, #64]\n"
+    "    stp x29, x30, [sp, #80]\n"
+    "    stp d8,  d9,  [sp, #96]\n"
+    "    stp d10, d11, [sp, #112]\n"
+    "    stp d12, d13, [sp, #128]\n"
+    "    stp d14, d15, [sp, #144]\n"
+    "    mov x2, sp\n"
+    "    str x2, [x0]\n"
+    "    mov sp, x1\n"
+    "    ldp x19, x20, [sp, #0]\n"
+    "    ldp x21, x22, [sp, #16]\n"
+    "    ldp x23, x24, [sp, #32]\n"
+    "    ldp x25, x26, [sp, #48]\n"
+    "    ldp x27, x28, [sp, #64]\n"
+    "    ldp x29, x30, [sp, #80]\n"
+    "    ldp d8,  d9,  [sp, #96]\n"
+    "    ldp d10, d11, [sp, #112]\n"
+    "    ldp d12, d13, [sp, #128]\n"
+    "    ldp d14, d15, [sp, #144]\n"
+    "    add sp, sp, #160\n"
+    "    ret\n"
+    ".size __pth_mctx_asm_switch,.-__pth_mctx_asm_switch\n"
+    ".type __pth_mctx_asm_boot,%function\n"
+    ".p2align 4\n"
+    "__pth_mctx_asm_boot:\n"
+    "    blr x19\n"
+    "    brk #0\n"
+    ".size __pth_mctx_asm_boot,.-__pth_mctx_asm_boot\n"
+);
+#define PTH_MCTX_ASM_FRAME 20 /* x19-x28, x29, x30 (return address), d8-d15 */
+#else
+#error "unsupported platform for assembly machine context switching"
+#endif
+
+extern void __pth_mctx_asm_boot(void);
+
+/* initialize a machine state */
+intern int pth_mctx_set(
+    pth_mctx_t *mctx, void (*func)(void), char *sk_addr_lo, char *sk_addr_hi)
+{
+    void **sp;
+    int i;
+
+    /* start with an aligned stack (plus some space for the bootstrap routine) */
+    sp = (void **)(((unsigned long)sk_addr_hi & ~(15UL)) - 16);
+
+    /* build the frame pth_mctx_asm_switch() pops from the stack */
+    sp -= PTH_MCTX_ASM_FRAME;
+    for (i = 0; i < PTH_MCTX_ASM_FRAME; i++)
+        sp[i] = NULL;
+#if defined(__x86_64__)
+    sp[0] = (void *)(0x1f80UL | (0x037fUL << 32)); /* default MXCSR and x87 control word */
+    sp[4] = (void *)func;                          /* %r12 */
+    sp[7] = (void *)__pth_mctx_asm_boot;           /* return address */
+#elif defined(__aarch64__)
+    sp[0]  = (void *)func;                         /* x19 */
+    sp[11] = (void *)__pth_mctx_asm_boot;          /* x30 (return address) */
+#endif
+    mctx->sp = (void *)sp;
+
+    /* a new context starts with the shared signal mask */
+    mctx->sigsown = FALSE;
+    pth_sc(sigprocmask)(SIG_SETMASK, NULL, &mctx->sigs);
+    mctx->error = 0;
+    return TRUE;
+}
+
+/* switch the signal mask between contexts where at least one has an own */
+intern void pth_mctx_asm_sigswitch(pth_mctx_t *old, pth_mctx_t *new)
+{
+    if (!old->sigsown)
+        pth_sc(sigprocmask)(SIG_SETMASK, &new->sigs, &pth_mctx_sigcommon);
+    else if (new->sigsown)
+        pth_sc(sigprocmask)(SIG_SETMASK, &new->sigs, NULL);
+    else
+        pth_sc(sigprocmask)(SIG_SETMASK, &pth_mctx_sigcommon, NULL);
+    return;
+}
+
+/* restore a machine context without saving the current one */
+intern void pth_mctx_asm_restore(pth_mctx_t *mctx)
+{
+    void *sp;
+
+    if (mctx->sigsown)
+        pth_sc(sigprocmask)(SIG_SETMASK, &mctx->sigs, NULL);
+    errno = mctx->error;
+    pth_mctx_asm_switch(&sp, mctx->sp);
+    return;
+}
+
 #else
 #error "unknown mctx method"
 #endif
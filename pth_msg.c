@@ -35,6 +35,7 @@ struct pth_msgport_st {
     const char    *mp_name;  /* optional name of message port */
     pth_t          mp_tid;   /* corresponding thread */
     pth_ring_t     mp_queue; /* queue of messages pending on port */
+    pth_ring_t     mp_waitq; /* queue of threads waiting for messages */
 };
 
 #endif /* cpp */
@@ -56,6 +57,7 @@ pth_msgport_t pth_msgport_create(const char *name)
     mp->mp_name  = name;
     mp->mp_tid   = pth_current;
     pth_ring_init(&mp->mp_queue);
+    pth_ring_init(&mp->mp_waitq);
 
     /* insert into list of existing message ports */
     pth_ring_append(&pth_msgport, &mp->mp_node);
@@ -67,6 +69,7 @@ pth_msgport_t pth_msgport_create(const char *name)
 void pth_msgport_destroy(pth_msgport_t mp)
 {
     pth_message_t *m;
+    pth_event_t ev;
 
     /* check input */
     if (mp == NULL)
@@ -76,6 +79,10 @@ void pth_msgport_destroy(pth_msgport_t mp)
     while ((m = pth_msgport_get(mp)) != NULL)
         pth_msgport_reply(m);
 
+    /* then let still waiting threads know that the port is gone */
+    while ((ev = pth_event_waitq_pop(&mp->mp_waitq, PTH_STATUS_FAILED)) != NULL)
+        pth_event_ready(ev);
+
     /* remove from list of existing message ports */
     pth_ring_delete(&pth_msgport, &mp->mp_node);
 
@@ -120,9 +127,15 @@ int pth_msgport_pending(pth_msgport_t mp)
 /* put a message on a port */
 int pth_msgport_put(pth_msgport_t mp, pth_message_t *m)
 {
+    pth_event_t ev;
+
     if (mp == NULL)
         return pth_error(FALSE, EINVAL);
     pth_ring_append(&mp->mp_queue, (pth_ringnode_t *)m);
+
+    /* move all threads waiting for messages to the ready queue */
+    while ((ev = pth_event_waitq_pop(&mp->mp_waitq, PTH_STATUS_OCCURRED)) != NULL)
+        pth_event_ready(ev);
     return TRUE;
 }
 
@@ -0,0 +1,679 @@
+/*
+**  GNU Pth - The GNU Portable Threads
+**  Copyright (c) 1999-2006 Ralf S. Engelschall <rse@engelschall.com>
+**
+**  This file is part of GNU Pth, a non-preemptive thread scheduling
+**  library which can be found at http://www.gnu.org/software/pth/.
+**
+**  This library is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU Lesser General Public
+**  License as published by the Free Software Foundation; either
+**  version 2.1 of the License, or (at your option) any later version.
+**
+**  This library is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**  Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public
+**  License along with this library; if not, write to the Free Software
+**  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+**  USA, or contact Ralf S. Engelschall <rse@engelschall.com>.
+**
+**  pth_offload.c: Pth offloading of blocking operations
+*/
+                             /* ``Many hands make light work.''
+                                    -- John Heywood */
+
+/*
+ * Regular files (and block devices) are always ``ready'' for the I/O
+ * multiplexer, so a read from a cold disk blocks the whole process
+ * with all its threads. Such operations (as well as any blocking or
+ * long-running functions of the application) are therefore offloaded to
+ * a small pool of kernel threads (the ``workers''), while the calling
+ * thread just waits for their completion. The jobs are passed to the
+ * workers as pointers through a request pipe and are passed back the
+ * same way through a completion pipe, which is permanently watched by
+ * the I/O multiplexer and drained by the event manager (so neither side
+ * needs any locking). The workers are started on demand and run with
+ * all signals blocked, so they never interfere with the scheduler.
+ *
+ * The workers are created with the system's POSIX threads (which are
+ * looked up dynamically, as pthread_create(3) can be our own when Pth
+ * is used as the Pthread library), so if they are not available the
+ * callers just perform the operations themselves as before.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* for RTLD_NEXT and preadv2(2) */
+#endif
+#include "pth_p.h"
+
+#if cpp
+
+    /* offloaded operations */
+#define PTH_OFFLOAD_READ   1
+#define PTH_OFFLOAD_WRITE  2
+#define PTH_OFFLOAD_FSYNC  3
+#define PTH_OFFLOAD_OPEN   4
+#define PTH_OFFLOAD_STAT   5
+#define PTH_OFFLOAD_FUNC   6
+#define PTH_OFFLOAD_READV  7
+#define PTH_OFFLOAD_WRITEV 8
+#define PTH_OFFLOAD_SENDFILE 9
+#define PTH_OFFLOAD_SPLICE 10
+
+    /* an offloaded job (filled by the caller, performed by a worker) */
+typedef struct {
+    int          op;    /* operation (PTH_OFFLOAD_XXX)   */
+    int          fd;    /* filedescriptor                */
+    void        *buf;   /* buffer (or struct stat)       */
+    size_t       len;   /* length of buffer              */
+    off_t        off;   /* file offset (-1: current one) */
+    int          fd2;   /* second filedescriptor         */
+    off_t        off2;  /* second file offset (ditto)    */
+    const char  *path;  /* path name                     */
+    int          flags; /* open(2) flags                 */
+    mode_t       mode;  /* open(2) mode                  */
+    void      *(*func)(void *); /* function to run       */
+    void        *arg;   /* argument of function          */
+    void        *ret;   /* return value of function      */
+    long         res;   /* result (-1 on error)          */
+    int          err;   /* errno on error                */
+} pth_offload_job_t;
+
+#endif /* cpp */
+
+#if defined(__GNUC__) && defined(HAVE_DLOPEN) && defined(RTLD_NEXT)
+#define PTH_OFFLOAD_WORKERS
+#endif
+
+#define PTH_OFFLOAD_MAXTHREADS 256  /* maximum number of workers           */
+#define PTH_OFFLOAD_MAXDEPTH   4096 /* maximum number of outstanding jobs
+                                       (their pointers fit into a pipe)     */
+
+    /* job states (switched atomically between caller and worker) */
+#define PTH_OFFLOAD_QUEUED    0
+#define PTH_OFFLOAD_RUNNING   1
+#define PTH_OFFLOAD_DONE      2
+#define PTH_OFFLOAD_CANCELLED 3
+
+/* the record of an outstanding job */
+typedef struct {
+    pth_ringnode_t    node;   /* ring linkage (has to be first!)               */
+    pth_t             thread; /* thread waiting for completion (NULL: aborted) */
+    pth_t             orphan; /* aborted thread whose stack is still in use    */
+    int               state;  /* state of the job (PTH_OFFLOAD_XXX)            */
+    int               reaped; /* whether the completion was reaped             */
+    pth_offload_job_t job;    /* the job itself                                */
+} pth_offload_rec_t;
+
+static int        pth_offload_max      = 4;  /* number of workers to run            */
+static int        pth_offload_depth    = 64; /* maximum number of outstanding jobs  */
+static int        pth_offload_state    = 0;  /* 0: untried, 1: usable, -1: unusable */
+static int        pth_offload_req[2]   = { -1, -1 }; /* request pipe              */
+static int        pth_offload_cpl[2]   = { -1, -1 }; /* completion pipe           */
+static int        pth_offload_workers  = 0;  /* workers running (not told to exit)  */
+static int        pth_offload_alive    = 0;  /* workers not yet confirmed their exit */
+static int        pth_offload_queued   = 0;  /* jobs submitted but not yet reaped   */
+static pth_ring_t pth_offload_jobs;          /* records of outstanding jobs         */
+static pth_ring_t pth_offload_slotq;         /* records waiting for a free slot     */
+static pth_ring_t pth_offload_free;          /* recycled records                    */
+
+/* initialize the offloading (the workers are started on demand) */
+intern void pth_offload_init(void)
+{
+    pth_offload_state   = 0;
+    pth_offload_workers = 0;
+    pth_offload_alive   = 0;
+    pth_offload_queued  = 0;
+    pth_ring_init(&pth_offload_jobs);
+    pth_ring_init(&pth_offload_slotq);
+    pth_ring_init(&pth_offload_free);
+    return;
+}
+
+/* configure the number of workers and the maximum number of outstanding jobs */
+intern int pth_offload_ctrl(int nthreads, int depth)
+{
+    pth_offload_rec_t *rec;
+
+    if (   nthreads < 0 || nthreads > PTH_OFFLOAD_MAXTHREADS
+        || depth < 1 || depth > PTH_OFFLOAD_MAXDEPTH)
+        return pth_error(FALSE, EINVAL);
+    pth_offload_max   = nthreads;
+    pth_offload_depth = depth;
+
+    /* let superfluous workers exit (after the jobs already queued) */
+    rec = NULL;
+    while (pth_offload_state > 0 && pth_offload_workers > pth_offload_max) {
+        pth_sc(write)(pth_offload_req[1], &rec, sizeof(rec));
+        pth_offload_workers--;
+    }
+    return TRUE;
+}
+
+/* perform a job */
+static void pth_offload_perform(pth_offload_job_t *job)
+{
+    switch (job->op) {
+        case PTH_OFFLOAD_READ:
+            if (job->off == (off_t)-1)
+                job->res = (long)pth_sc(read)(job->fd, job->buf, job->len);
+            else
+                job->res = (long)pth_sc(pread)(job->fd, job->buf, job->len, job->off);
+            break;
+        case PTH_OFFLOAD_WRITE:
+            if (job->off == (off_t)-1)
+                job->res = (long)pth_sc(write)(job->fd, job->buf, job->len);
+            else
+                job->res = (long)pth_sc(pwrite)(job->fd, job->buf, job->len, job->off);
+            break;
+#if defined(HAVE_PREADV) && defined(HAVE_PWRITEV)
+        case PTH_OFFLOAD_READV:
+            job->res = (long)pth_sc(preadv)(job->fd, (const struct iovec *)job->buf,
+                                            (int)job->len, job->off);
+            break;
+        case PTH_OFFLOAD_WRITEV:
+            job->res = (long)pth_sc(pwritev)(job->fd, (const struct iovec *)job->buf,
+                                             (int)job->len, job->off);
+            break;
+#endif
+#if defined(HAVE_SYS_SENDFILE_H) && defined(HAVE_SENDFILE)
+        case PTH_OFFLOAD_SENDFILE:
+            job->res = (long)sendfile(job->fd, job->fd2,
+                                      (job->off != (off_t)-1 ? &job->off : NULL), job->len);
+            break;
+#endif
+#ifdef HAVE_SPLICE
+        case PTH_OFFLOAD_SPLICE: {
+            loff_t loff;
+            loff_t loff2;
+
+            loff  = (loff_t)job->off;
+            loff2 = (loff_t)job->off2;
+            job->res = (long)splice(job->fd,  (job->off  != (off_t)-1 ? &loff  : NULL),
+                                    job->fd2, (job->off2 != (off_t)-1 ? &loff2 : NULL),
+                                    job->len, (unsigned int)job->flags);
+            job->off  = (off_t)loff;
+            job->off2 = (off_t)loff2;
+            break;
+        }
+#endif
+        case PTH_OFFLOAD_FSYNC:
+            job->res = (long)fsync(job->fd);
+            break;
+        case PTH_OFFLOAD_OPEN:
+            job->res = (long)open(job->path, job->flags, job->mode);
+            break;
+        case PTH_OFFLOAD_STAT:
+            job->res = (long)stat(job->path, (struct stat *)job->buf);
+            break;
+        case PTH_OFFLOAD_FUNC:
+            job->ret = job->func(job->arg);
+            job->res = 0;
+            break;
+        default:
+            job->res = -1;
+            errno = EINVAL;
+            break;
+    }
+    job->err = (job->res == -1 ? errno : 0);
+    return;
+}
+
+#ifdef PTH_OFFLOAD_WORKERS
+
+/* the system's pthread_t is handled as an opaque pointer-sized value,
+   because <pthread.h> may be our own Pthread API */
+typedef int   (*pth_offload_create_t)(void **, const void *, void *(*)(void *), void *);
+typedef void *(*pth_offload_self_t)(void);
+typedef int   (*pth_offload_detach_t)(void *);
+
+static pth_offload_create_t pth_offload_create = NULL;
+static pth_offload_self_t   pth_offload_self   = NULL;
+static pth_offload_detach_t pth_offload_detach = NULL;
+
+/* the main loop of a worker */
+static void *pth_offload_worker(void *arg)
+{
+    pth_offload_rec_t *rec;
+    int reqfd;
+    int cplfd;
+    ssize_t n;
+
+    reqfd = ((int *)arg)[0];
+    cplfd = ((int *)arg)[1];
+    free(arg);
+    pth_offload_detach(pth_offload_self());
+    for (;;) {
+        /* fetch the next job (or the request to exit) */
+        if ((n = pth_sc(read)(reqfd, &rec, sizeof(rec))) < 0 && errno == EINTR)
+            continue;
+        if (n != sizeof(rec) || rec == NULL)
+            break;
+
+        /* perform the job unless it was cancelled meanwhile */
+        if (__sync_bool_compare_and_swap(&rec->state, PTH_OFFLOAD_QUEUED, PTH_OFFLOAD_RUNNING)) {
+            pth_offload_perform(&rec->job);
+            rec->state = PTH_OFFLOAD_DONE;
+        }
+        while (pth_sc(write)(cplfd, &rec, sizeof(rec)) < 0 && errno == EINTR)
+            ;
+    }
+
+    /* confirm the exit */
+    rec = NULL;
+    while (pth_sc(write)(cplfd, &rec, sizeof(rec)) < 0 && errno == EINTR)
+        ;
+    return NULL;
+}
+
+/* start another worker */
+static int pth_offload_spawn(void)
+{
+    sigset_t ss, oss;
+    void *tid;
+    int *fds;
+    int rc;
+
+    if ((fds = (int *)malloc(2 * sizeof(int))) == NULL)
+        return FALSE;
+    fds[0] = pth_offload_req[0];
+    fds[1] = pth_offload_cpl[1];
+    sigfillset(&ss);
+    pth_sc(sigprocmask)(SIG_SETMASK, &ss, &oss);
+    rc = pth_offload_create(&tid, NULL, pth_offload_worker, fds);
+    pth_sc(sigprocmask)(SIG_SETMASK, &oss, NULL);
+    if (rc != 0) {
+        free(fds);
+        return FALSE;
+    }
+    pth_offload_workers++;
+    pth_offload_alive++;
+    return TRUE;
+}
+
+#endif /* PTH_OFFLOAD_WORKERS */
+
+/* close the pipes */
+static void pth_offload_close(void)
+{
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        pth_fdmode_forget(pth_offload_req[i], FALSE);
+        pth_fdmode_forget(pth_offload_cpl[i], FALSE);
+        if (pth_offload_req[i] != -1)
+            close(pth_offload_req[i]);
+        if (pth_offload_cpl[i] != -1)
+            close(pth_offload_cpl[i]);
+        pth_offload_req[i] = -1;
+        pth_offload_cpl[i] = -1;
+    }
+    return;
+}
+
+/* set up the pipes */
+static int pth_offload_open(void)
+{
+#ifdef PTH_OFFLOAD_WORKERS
+    int i;
+
+    if (pth_offload_create == NULL) {
+        pth_offload_create = (pth_offload_create_t)dlsym(RTLD_NEXT, "pthread_create");
+        pth_offload_self   = (pth_offload_self_t)dlsym(RTLD_NEXT, "pthread_self");
+        pth_offload_detach = (pth_offload_detach_t)dlsym(RTLD_NEXT, "pthread_detach");
+    }
+    if (pth_offload_create == NULL || pth_offload_self == NULL || pth_offload_detach == NULL)
+        return FALSE;
+    if (pipe(pth_offload_req) == -1 || pipe(pth_offload_cpl) == -1)
+        return FALSE;
+    for (i = 0; i < 2; i++) {
+        fcntl(pth_offload_req[i], F_SETFD, FD_CLOEXEC);
+        fcntl(pth_offload_cpl[i], F_SETFD, FD_CLOEXEC);
+    }
+    if (pth_fdmode(pth_offload_cpl[0], PTH_FDMODE_NONBLOCK) == PTH_FDMODE_ERROR)
+        return FALSE;
+    return pth_iomux_watch(pth_offload_cpl[0], PTH_UNTIL_FD_READABLE);
+#else
+    return FALSE;
+#endif
+}
+
+/* check whether jobs can be offloaded (and start the workers on demand) */
+static int pth_offload_usable(void)
+{
+    if (pth_offload_max == 0)
+        return FALSE;
+    if (pth_offload_state == 0) {
+        if (pth_offload_open())
+            pth_offload_state = 1;
+        else {
+            pth_offload_close();
+            pth_offload_state = -1;
+        }
+    }
+    if (pth_offload_state < 0)
+        return FALSE;
+#ifdef PTH_OFFLOAD_WORKERS
+    while (pth_offload_workers < pth_offload_max)
+        if (!pth_offload_spawn())
+            break;
+#endif
+    return (pth_offload_workers > 0);
+}
+
+/* check whether operations on a filedescriptor should be offloaded */
+intern int pth_offload_file(int fd)
+{
+    if (pth_offload_max == 0 || pth_offload_state < 0)
+        return FALSE;
+    return pth_fdmode_disk(fd);
+}
+
+#ifdef RWF_NOWAIT
+static int pth_offload_nowait[2] = { TRUE, TRUE }; /* reads, writes */
+
+/* try to read/write without blocking on the disk, i.e., from/to the page cache only */
+static int pth_offload_try(pth_offload_job_t *job)
+{
+    struct iovec iov;
+    const struct iovec *iovp;
+    int iovcnt;
+    int reading;
+    ssize_t n;
+
+    if (job->op == PTH_OFFLOAD_READ || job->op == PTH_OFFLOAD_WRITE) {
+        iov.iov_base = job->buf;
+        iov.iov_len  = job->len;
+        iovp   = &iov;
+        iovcnt = 1;
+    }
+    else if (job->op == PTH_OFFLOAD_READV || job->op == PTH_OFFLOAD_WRITEV) {
+        iovp   = (const struct iovec *)job->buf;
+        iovcnt = (int)job->len;
+    }
+    else
+        return FALSE;
+    reading = (job->op == PTH_OFFLOAD_READ || job->op == PTH_OFFLOAD_READV);
+    if (!pth_offload_nowait[reading ? 0 : 1])
+        return FALSE;
+    if (reading)
+        n = preadv2(job->fd, iovp, iovcnt, job->off, RWF_NOWAIT);
+    else
+        n = pwritev2(job->fd, iovp, iovcnt, job->off, RWF_NOWAIT);
+    if (n >= 0) {
+        job->res = (long)n;
+        job->err = 0;
+        return TRUE;
+    }
+    if (errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP)
+        /* not supported by kernel (or filesystem), so never try again */
+        pth_offload_nowait[reading ? 0 : 1] = FALSE;
+    return FALSE;
+}
+#endif
+
+/*
+ * Offload a job to the workers and let the current thread wait for its
+ * completion. Returns FALSE (without doing anything) if there are no
+ * workers, so the caller has to perform the job itself. Else the result
+ * is stored in the job (-1 and errno on errors, EINTR if one of the
+ * extra events occurred before a worker picked up the job). A job
+ * already picked up has to be awaited even if an extra event occurs or
+ * the thread is cancelled meanwhile, as it uses the caller's buffers.
+ */
+intern int pth_offload_submit(pth_offload_job_t *job, pth_event_t ev_extra)
+{
+    pth_offload_rec_t *rec;
+    int cancelstate;
+    int interrupted;
+
+#ifdef RWF_NOWAIT
+    if (pth_offload_try(job))
+        return TRUE;
+#endif
+    if (!pth_offload_usable())
+        return FALSE;
+    if ((rec = (pth_offload_rec_t *)pth_ring_pop(&pth_offload_free)) == NULL)
+        if ((rec = (pth_offload_rec_t *)malloc(sizeof(pth_offload_rec_t))) == NULL)
+            return FALSE;
+    rec->thread = pth_current;
+    rec->orphan = NULL;
+    rec->state  = PTH_OFFLOAD_QUEUED;
+    rec->reaped = FALSE;
+    rec->job    = *job;
+
+    pth_cancel_state(PTH_CANCEL_DISABLE, &cancelstate);
+    interrupted = FALSE;
+
+    /* wait for a free slot (in order of arrival) */
+    if (   pth_offload_queued >= pth_offload_depth
+        || pth_ring_first(&pth_offload_slotq) != NULL) {
+        pth_ring_append(&pth_offload_slotq, &(rec->node));
+        while (pth_offload_queued >= pth_offload_depth && !interrupted)
+            if (   pth_wait_wakeup(ev_extra)
+                || (pth_current->cancelreq && (cancelstate & PTH_CANCEL_ENABLE)))
+                interrupted = TRUE;
+        pth_ring_delete(&pth_offload_slotq, &(rec->node));
+    }
+
+    /* pass the job to the workers and wait for its completion */
+    if (!interrupted) {
+        pth_ring_append(&pth_offload_jobs, &(rec->node));
+        pth_offload_queued++;
+        while (pth_sc(write)(pth_offload_req[1], &rec, sizeof(rec)) < 0 && errno == EINTR)
+            ;
+        while (!rec->reaped) {
+            if (   !pth_wait_wakeup(interrupted ? NULL : ev_extra)
+                && !(pth_current->cancelreq && (cancelstate & PTH_CANCEL_ENABLE)))
+                continue;
+            if (rec->reaped || interrupted)
+                continue;
+            interrupted = TRUE;
+            __sync_bool_compare_and_swap(&rec->state, PTH_OFFLOAD_QUEUED, PTH_OFFLOAD_CANCELLED);
+        }
+    }
+    if (rec->state == PTH_OFFLOAD_DONE)
+        *job = rec->job;
+    else {
+        job->res = -1;
+        job->err = EINTR;
+    }
+    pth_ring_append(&pth_offload_free, &(rec->node));
+    pth_cancel_state(cancelstate, NULL);
+    pth_cancel_point();
+    if (job->res == -1)
+        errno = job->err;
+    return TRUE;
+}
+
+/* reap the completed jobs and wake up the threads waiting for them */
+intern void pth_offload_dispatch(void)
+{
+    pth_offload_rec_t *recs[64];
+    pth_offload_rec_t *rec;
+    ssize_t n;
+    pth_t t;
+    int i;
+
+    if (pth_offload_state <= 0 || !pth_iomux_ready(pth_offload_cpl[0]))
+        return;
+    while ((n = pth_sc(read)(pth_offload_cpl[0], recs, sizeof(recs))) > 0) {
+        for (i = 0; i < (int)(n / sizeof(recs[0])); i++) {
+            if ((rec = recs[i]) == NULL) {
+                /* a worker confirmed its exit */
+                pth_offload_alive--;
+                continue;
+            }
+            pth_ring_delete(&pth_offload_jobs, &(rec->node));
+            pth_offload_queued--;
+            if ((t = rec->thread) == NULL) {
+                /* the thread was aborted meanwhile */
+                if (rec->orphan != NULL) {
+                    pth_tcb_stack_unref(rec->orphan);
+                    rec->orphan = NULL;
+                }
+                pth_ring_append(&pth_offload_free, &(rec->node));
+                continue;
+            }
+            rec->reaped = TRUE;
+            if (t->state == PTH_STATE_WAITING && pth_pqueue_contains(&pth_WQ, t))
+                pth_sched_wakeup(t);
+        }
+    }
+
+    /* let the threads waiting for a free slot submit their jobs */
+    i = pth_offload_depth - pth_offload_queued;
+    for (rec = (pth_offload_rec_t *)pth_ring_first(&pth_offload_slotq); rec != NULL && i > 0;
+         rec = (pth_offload_rec_t *)pth_ring_next(&pth_offload_slotq, &(rec->node)), i--) {
+        t = rec->thread;
+        if (t->state == PTH_STATE_WAITING && pth_pqueue_contains(&pth_WQ, t))
+            pth_sched_wakeup(t);
+    }
+    return;
+}
+
+/* abandon the outstanding jobs of a terminating thread (those not yet
+   picked up by a worker are cancelled, but the others can still use the
+   buffers of the thread, which may be on its stack, so the stack is kept
+   until their completions are reaped) */
+intern void pth_offload_abandon(pth_t t)
+{
+    pth_offload_rec_t *rec;
+    pth_offload_rec_t *next;
+
+    for (rec = (pth_offload_rec_t *)pth_ring_first(&pth_offload_jobs); rec != NULL;
+         rec = (pth_offload_rec_t *)pth_ring_next(&pth_offload_jobs, &(rec->node))) {
+        if (rec->thread == t) {
+            rec->thread = NULL;
+            if (!__sync_bool_compare_and_swap(&rec->state, PTH_OFFLOAD_QUEUED, PTH_OFFLOAD_CANCELLED)) {
+                rec->orphan = t;
+                pth_tcb_stack_ref(t);
+            }
+        }
+    }
+    for (rec = (pth_offload_rec_t *)pth_ring_first(&pth_offload_slotq); rec != NULL; rec = next) {
+        next = (pth_offload_rec_t *)pth_ring_next(&pth_offload_slotq, &(rec->node));
+        if (rec->thread == t) {
+            pth_ring_delete(&pth_offload_slotq, &(rec->node));
+            pth_ring_append(&pth_offload_free, &(rec->node));
+        }
+    }
+    return;
+}
+
+/* release all records */
+static void pth_offload_drop(void)
+{
+    pth_offload_rec_t *rec;
+
+    while ((rec = (pth_offload_rec_t *)pth_ring_pop(&pth_offload_jobs)) != NULL)
+        free(rec);
+    while ((rec = (pth_offload_rec_t *)pth_ring_pop(&pth_offload_slotq)) != NULL)
+        free(rec);
+    while ((rec = (pth_offload_rec_t *)pth_ring_pop(&pth_offload_free)) != NULL)
+        free(rec);
+    return;
+}
+
+/* kill the offloading: cancel the queued jobs and wait
+   until all workers exited (all threads are dropped already) */
+intern void pth_offload_kill(void)
+{
+    pth_offload_rec_t *recs[64];
+    pth_offload_rec_t *rec;
+    ssize_t n;
+    int i;
+
+    if (pth_offload_state > 0) {
+        for (rec = (pth_offload_rec_t *)pth_ring_first(&pth_offload_jobs); rec != NULL;
+             rec = (pth_offload_rec_t *)pth_ring_next(&pth_offload_jobs, &(rec->node)))
+            __sync_bool_compare_and_swap(&rec->state, PTH_OFFLOAD_QUEUED, PTH_OFFLOAD_CANCELLED);
+        pth_fdmode_forget(pth_offload_req[1], FALSE);
+        close(pth_offload_req[1]);
+        pth_offload_req[1] = -1;
+        pth_fdmode(pth_offload_cpl[0], PTH_FDMODE_BLOCK);
+        while (pth_offload_alive > 0) {
+            if ((n = pth_sc(read)(pth_offload_cpl[0], recs, sizeof(recs))) <= 0) {
+                if (n < 0 && errno == EINTR)
+                    continue;
+                break;
+            }
+            for (i = 0; i < (int)(n / sizeof(recs[0])); i++)
+                if (recs[i] == NULL)
+                    pth_offload_alive--;
+        }
+    }
+    pth_offload_close();
+    pth_offload_drop();
+    pth_offload_init();
+    return;
+}
+
+/* forget the workers in a forked child (which does not inherit them),
+   so the child starts its own ones on demand (has to be called before
+   pth_iomux_atfork() re-registers the watched filedescriptors) */
+intern void pth_offload_atfork(void)
+{
+    pth_offload_rec_t *rec;
+
+    if (pth_offload_cpl[0] != -1)
+        pth_iomux_watch(pth_offload_cpl[0], 0);
+    pth_offload_close();
+    while ((rec = (pth_offload_rec_t *)pth_ring_pop(&pth_offload_jobs)) != NULL) {
+        if (rec->orphan != NULL) {
+            pth_tcb_stack_unref(rec->orphan);
+            rec->orphan = NULL;
+        }
+        pth_ring_append(&pth_offload_free, &(rec->node));
+    }
+    while ((rec = (pth_offload_rec_t *)pth_ring_pop(&pth_offload_slotq)) != NULL)
+        pth_ring_append(&pth_offload_free, &(rec->node));
+    pth_offload_state   = 0;
+    pth_offload_workers = 0;
+    pth_offload_alive   = 0;
+    pth_offload_queued  = 0;
+    return;
+}
+
+/* dump out the state of the offloading */
+intern void pth_offload_dump(FILE *fp)
+{
+    fprintf(fp, "| Offload Workers: %d of %d (%d jobs outstanding, at most %d)\n",
+            pth_offload_workers, pth_offload_max, pth_offload_queued, pth_offload_depth);
+    return;
+}
+
+/* run a function on a kernel thread and wait for its result */
+int pth_offload(void *(*func)(void *), void *arg, void **result)
+{
+    return pth_offload_ev(func, arg, result, NULL);
+}
+
+/* run a function on a kernel thread and wait for its result or extra event(s) */
+int pth_offload_ev(void *(*func)(void *), void *arg, void **result, pth_event_t ev_extra)
+{
+    pth_offload_job_t job;
+    void *ret;
+
+    pth_implicit_init();
+    if (func == NULL)
+        return pth_error(FALSE, EINVAL);
+    job.op   = PTH_OFFLOAD_FUNC;
+    job.func = func;
+    job.arg  = arg;
+    if (pth_offload_submit(&job, ev_extra)) {
+        if (job.res == -1)
+            return pth_error(FALSE, job.err);
+        ret = job.ret;
+    }
+    else
+        /* without workers the function has to block us all */
+        ret = func(arg);
+    if (result != NULL)
+        *result = ret;
+    return TRUE;
+}
+
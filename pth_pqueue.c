@@ -27,147 +27,220 @@
                                                    -- Unknown */
 #include "pth_p.h"
 
+/*
+ * The priority queues keep all their threads in a single ring which is
+ * ordered by descending (aged) priority and in FIFO order within the
+ * same priority. Additionally the first thread of every priority level
+ * is remembered and a bitmap tells which levels are non-empty, so a
+ * thread can be inserted behind the last thread of its level in O(1)
+ * instead of walking the ring.
+ *
+ * For the aging of pth_pqueue_increase() a queue counts its increases
+ * and every thread remembers this counter at insertion time, so the
+ * current level of a thread is its insertion level plus the number of
+ * increases since then. As the number of levels is limited, aged
+ * threads are merged into the top level, where they are served in FIFO
+ * order. In order to not move all threads on each increase, the level
+ * slots are used as a ring buffer, too.
+ */
+
 #if cpp
 
+/* number of (aged) priority levels of a queue */
+#define PTH_PQUEUE_LEVELS 32
+
 /* thread priority queue */
 struct pth_pqueue_st {
-    pth_t q_head;
-    int   q_num;
+    pth_t         q_head;                     /* first thread in queue         */
+    int           q_num;                      /* number of threads in queue    */
+    unsigned long q_map;                      /* bitmap of non-empty levels    */
+    unsigned int  q_age;                      /* number of queue increases     */
+    int           q_rot;                      /* rotation of level slots       */
+    pth_t         q_level[PTH_PQUEUE_LEVELS]; /* first thread of each level    */
 };
 typedef struct pth_pqueue_st pth_pqueue_t;
 
 #endif /* cpp */
 
+#define PTH_PQUEUE_TOP      (PTH_PQUEUE_LEVELS-1)
+#define PTH_PQUEUE_BIT(l)   (1UL << (l))
+#define PTH_PQUEUE_SLOT(q,l) (((l) + (q)->q_rot) % PTH_PQUEUE_LEVELS)
+
 /* initialize a priority queue; O(1) */
 intern void pth_pqueue_init(pth_pqueue_t *q)
 {
+    int i;
+
     if (q != NULL) {
         q->q_head = NULL;
         q->q_num  = 0;
+        q->q_map  = 0;
+        q->q_age  = 0;
+        q->q_rot  = 0;
+        for (i = 0; i < PTH_PQUEUE_LEVELS; i++)
+            q->q_level[i] = NULL;
     }
     return;
 }
 
-/* insert thread into priority queue; O(n) */
+/* determine the highest non-empty level of a (non-zero) bitmap; O(1) */
+static int pth_pqueue_fls(unsigned long map)
+{
+    int l;
+
+    l = 0;
+    if (map & 0xffff0000UL) { map >>= 16; l += 16; }
+    if (map & 0x0000ff00UL) { map >>=  8; l +=  8; }
+    if (map & 0x000000f0UL) { map >>=  4; l +=  4; }
+    if (map & 0x0000000cUL) { map >>=  2; l +=  2; }
+    if (map & 0x00000002UL) {             l +=  1; }
+    return l;
+}
+
+/* determine the current (aged) level of a queued thread; O(1) */
+static int pth_pqueue_level(pth_pqueue_t *q, pth_t t)
+{
+    unsigned int aged;
+
+    aged = q->q_age - t->q_age;
+    if (aged >= (unsigned int)(PTH_PQUEUE_TOP - t->q_prio))
+        return PTH_PQUEUE_TOP;
+    return t->q_prio + (int)aged;
+}
+
+/* insert thread into priority queue; O(1) */
 intern void pth_pqueue_insert(pth_pqueue_t *q, int prio, pth_t t)
 {
-    pth_t c;
-    int p;
+    pth_pqueue_splice(q, prio, &t, 1);
+    return;
+}
+
+/* insert a batch of threads with the same priority into
+   priority queue, keeping their order; O(n) for linking, but
+   the place of insertion is determined only once */
+intern void pth_pqueue_splice(pth_pqueue_t *q, int prio, pth_t *tv, int n)
+{
+    pth_t c, first, last;
+    unsigned long lower;
+    int favorite;
+    int i, l, s;
 
-    if (q == NULL)
+    if (q == NULL || n <= 0)
         return;
-    if (q->q_head == NULL || q->q_num == 0) {
-        /* add as first element */
-        t->q_prev = t;
-        t->q_next = t;
-        t->q_prio = prio;
-        q->q_head = t;
-    }
-    else if (q->q_head->q_prio < prio) {
+
+    /* determine level and the thread to insert before */
+    favorite = FALSE;
+    lower = 0;
+    if (prio - PTH_PRIO_MIN > PTH_PQUEUE_TOP) {
         /* add as new head of queue */
-        t->q_prev = q->q_head->q_prev;
-        t->q_next = q->q_head;
-        t->q_prev->q_next = t;
-        t->q_next->q_prev = t;
-        t->q_prio = prio;
-        t->q_next->q_prio = prio - t->q_next->q_prio;
-        q->q_head = t;
+        favorite = TRUE;
+        l = PTH_PQUEUE_TOP;
+        c = q->q_head;
     }
     else {
-        /* insert after elements with greater or equal priority */
-        c = q->q_head;
-        p = c->q_prio;
-        while ((p - c->q_next->q_prio) >= prio && c->q_next != q->q_head) {
-            c = c->q_next;
-            p -= c->q_prio;
-        }
-        t->q_prev = c;
-        t->q_next = c->q_next;
-        t->q_prev->q_next = t;
-        t->q_next->q_prev = t;
-        t->q_prio = p - prio;
-        if (t->q_next != q->q_head)
-            t->q_next->q_prio -= t->q_prio;
+        /* insert after elements with greater or equal priority,
+           i.e., before the first thread of the next lower level */
+        l = (prio < PTH_PRIO_MIN ? 0 : prio - PTH_PRIO_MIN);
+        lower = q->q_map & (PTH_PQUEUE_BIT(l) - 1);
+        if (lower != 0)
+            c = q->q_level[PTH_PQUEUE_SLOT(q, pth_pqueue_fls(lower))];
+        else
+            c = q->q_head;
     }
-    q->q_num++;
-    return;
-}
 
-/* remove thread with maximum priority from priority queue; O(1) */
-intern pth_t pth_pqueue_delmax(pth_pqueue_t *q)
-{
-    pth_t t;
+    /* chain the threads together */
+    for (i = 0; i < n; i++) {
+        tv[i]->q_prio  = l;
+        tv[i]->q_age   = q->q_age;
+        tv[i]->q_queue = q;
+        tv[i]->q_prev  = tv[i > 0 ? i-1 : n-1];
+        tv[i]->q_next  = tv[i < n-1 ? i+1 : 0];
+    }
+    first = tv[0];
+    last  = tv[n-1];
 
-    if (q == NULL)
-        return NULL;
+    /* link chain into ring */
     if (q->q_head == NULL)
-        t = NULL;
-    else if (q->q_head->q_next == q->q_head) {
-        /* remove the last element and make queue empty */
-        t = q->q_head;
-        t->q_next = NULL;
-        t->q_prev = NULL;
-        t->q_prio = 0;
-        q->q_head = NULL;
-        q->q_num  = 0;
-    }
+        q->q_head = first;
     else {
-        /* remove head of queue */
-        t = q->q_head;
-        t->q_prev->q_next = t->q_next;
-        t->q_next->q_prev = t->q_prev;
-        t->q_next->q_prio = t->q_prio - t->q_next->q_prio;
-        t->q_prio = 0;
-        q->q_head = t->q_next;
-        q->q_num--;
+        first->q_prev = c->q_prev;
+        last->q_next  = c;
+        first->q_prev->q_next = first;
+        c->q_prev = last;
+        if (c == q->q_head && (favorite || lower != 0))
+            q->q_head = first;
     }
-    return t;
+
+    /* update level information */
+    s = PTH_PQUEUE_SLOT(q, l);
+    if (q->q_level[s] == NULL || favorite)
+        q->q_level[s] = first;
+    q->q_map |= PTH_PQUEUE_BIT(l);
+    q->q_num += n;
+    return;
 }
 
-/* remove thread from priority queue; O(n) */
+/* remove thread from priority queue; O(1) */
 intern void pth_pqueue_delete(pth_pqueue_t *q, pth_t t)
 {
+    int l, s;
+
     if (q == NULL)
         return;
-    if (q->q_head == NULL)
+    if (q->q_head == NULL || t->q_queue != q)
         return;
-    else if (q->q_head == t) {
-        if (t->q_next == t) {
-            /* remove the last element and make queue empty */
-            t->q_next = NULL;
-            t->q_prev = NULL;
-            t->q_prio = 0;
-            q->q_head = NULL;
-            q->q_num  = 0;
-        }
+
+    /* update level information */
+    l = pth_pqueue_level(q, t);
+    s = PTH_PQUEUE_SLOT(q, l);
+    if (q->q_level[s] == t) {
+        if (t->q_next != q->q_head && pth_pqueue_level(q, t->q_next) == l)
+            q->q_level[s] = t->q_next;
         else {
-            /* remove head of queue */
-            t->q_prev->q_next = t->q_next;
-            t->q_next->q_prev = t->q_prev;
-            t->q_next->q_prio = t->q_prio - t->q_next->q_prio;
-            t->q_prio = 0;
-            q->q_head = t->q_next;
-            q->q_num--;
+            q->q_level[s] = NULL;
+            q->q_map &= ~(PTH_PQUEUE_BIT(l));
         }
     }
+
+    /* unlink thread from ring */
+    if (t->q_next == t) {
+        /* remove the last element and make queue empty */
+        q->q_head = NULL;
+        q->q_num  = 0;
+    }
     else {
         t->q_prev->q_next = t->q_next;
         t->q_next->q_prev = t->q_prev;
-        if (t->q_next != q->q_head)
-            t->q_next->q_prio += t->q_prio;
-        t->q_prio = 0;
+        if (q->q_head == t)
+            q->q_head = t->q_next;
         q->q_num--;
     }
+    t->q_next  = NULL;
+    t->q_prev  = NULL;
+    t->q_prio  = 0;
+    t->q_queue = NULL;
     return;
 }
 
+/* remove thread with maximum priority from priority queue; O(1) */
+intern pth_t pth_pqueue_delmax(pth_pqueue_t *q)
+{
+    pth_t t;
+
+    if (q == NULL)
+        return NULL;
+    if ((t = q->q_head) != NULL)
+        pth_pqueue_delete(q, t);
+    return t;
+}
+
 /* determine priority required to favorite a thread; O(1) */
 #if cpp
 #define pth_pqueue_favorite_prio(q) \
-    ((q)->q_head != NULL ? (q)->q_head->q_prio + 1 : PTH_PRIO_MAX)
+    ((q)->q_head != NULL ? PTH_PRIO_MIN + PTH_PQUEUE_LEVELS : PTH_PRIO_MAX)
 #endif
 
-/* move a thread inside queue to the top; O(n) */
+/* move a thread inside queue to the top; O(1) */
 intern int pth_pqueue_favorite(pth_pqueue_t *q, pth_t t)
 {
     if (q == NULL)
@@ -186,12 +259,28 @@ intern int pth_pqueue_favorite(pth_pqueue_t *q, pth_t t)
 /* increase priority of all(!) threads in queue; O(1) */
 intern void pth_pqueue_increase(pth_pqueue_t *q)
 {
+    pth_t t;
+    int s;
+
     if (q == NULL)
         return;
     if (q->q_head == NULL)
         return;
-    /* <grin> yes, that's all ;-) */
-    q->q_head->q_prio += 1;
+
+    /* the threads of the second highest level join the top level
+       (behind the threads already there) and the slot of the top
+       level becomes the slot of the (empty) lowest level */
+    s = PTH_PQUEUE_SLOT(q, PTH_PQUEUE_TOP-1);
+    if ((t = q->q_level[PTH_PQUEUE_SLOT(q, PTH_PQUEUE_TOP)]) != NULL)
+        q->q_level[s] = t;
+    q->q_level[PTH_PQUEUE_SLOT(q, PTH_PQUEUE_TOP)] = NULL;
+    q->q_rot = (q->q_rot + PTH_PQUEUE_TOP) % PTH_PQUEUE_LEVELS;
+    if (q->q_map & PTH_PQUEUE_BIT(PTH_PQUEUE_TOP))
+        q->q_map = ((q->q_map & ~(PTH_PQUEUE_BIT(PTH_PQUEUE_TOP))) << 1)
+                   | PTH_PQUEUE_BIT(PTH_PQUEUE_TOP);
+    else
+        q->q_map <<= 1;
+    q->q_age++;
     return;
 }
 
@@ -237,8 +326,8 @@ intern pth_t pth_pqueue_walk(pth_pqueue_t *q, pth_t t, int direction)
     return tn;
 }
 
-/* check whether a thread is in a queue; O(n) */
-intern int pth_pqueue_contains(pth_pqueue_t *q, pth_t t)
+/* search a thread by walking through a queue; O(n) */
+intern int pth_pqueue_search(pth_pqueue_t *q, pth_t t)
 {
     pth_t tc;
     int found;
@@ -254,3 +343,22 @@ intern int pth_pqueue_contains(pth_pqueue_t *q, pth_t t)
     return found;
 }
 
+/* check whether a thread is in a queue; O(1) */
+intern int pth_pqueue_contains(pth_pqueue_t *q, pth_t t)
+{
+    int found;
+
+    if (q == NULL || t == NULL)
+        return FALSE;
+    found = (t->q_queue == q);
+#ifdef PTH_DEBUG
+    /* cross-check the queue tag of the thread against the queue itself */
+    if (found != pth_pqueue_search(q, t)) {
+        pth_debug3("pth_pqueue_contains: queue tag of thread \"%s\" is %s",
+                   t->name, found ? "stale" : "missing");
+        abort();
+    }
+#endif
+    return found;
+}
+
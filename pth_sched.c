@@ -35,29 +35,45 @@ intern pth_pqueue_t pth_RQ;         /* queue of threads ready to run         */
 intern pth_pqueue_t pth_WQ;         /* queue of threads waiting for an event */
 intern pth_pqueue_t pth_SQ;         /* queue of suspended threads            */
 intern pth_pqueue_t pth_DQ;         /* queue of terminated threads           */
+intern pth_ring_t   pth_DQwaiters;  /* events waiting for any terminated one */
 intern int          pth_favournew;  /* favour new threads on startup         */
 intern float        pth_loadval;    /* average scheduler load value          */
 
-static int          pth_sigpipe[2]; /* internal signal occurrence pipe       */
-static sigset_t     pth_sigpending; /* mask of pending signals               */
-static sigset_t     pth_sigblock;   /* mask of signals we block in scheduler */
-static sigset_t     pth_sigcatch;   /* mask of signals we have to catch      */
-static sigset_t     pth_sigraised;  /* mask of raised signals                */
+static sigset_t     pth_sigpending;    /* mask of pending signals               */
+static sigset_t     pth_sigshared;     /* scheduler mask before raising signals */
+static sigset_t     pth_sigblock;      /* mask of signals we block in scheduler */
+static sigset_t     pth_sigblockdef;   /* same, plus default mask waiters       */
+static sigset_t     pth_sigdefault;    /* signal mask threads start with        */
+static int          pth_sigdefwaiters; /* waiting threads with default mask     */
+static int          pth_sigunblock[PTH_NSIG]; /* waiting threads not blocking a signal */
 
 static pth_time_t   pth_loadticknext;
 static pth_time_t   pth_loadtickgap = PTH_TIME(1,0);
+static pth_time_t   pth_timergap    = PTH_TIME(0,1);    /* minimum timer restart */
+static pth_time_t   pth_pollnext;
+static pth_time_t   pth_pollgap     = PTH_TIME(0,1000); /* maximum poll interval on handoffs */
+
+static pth_t        pth_wakeup_head; /* first thread queued for wakeup       */
+static pth_t        pth_wakeup_tail; /* last thread queued for wakeup        */
 
 /* initialize the scheduler ingredients */
 intern int pth_scheduler_init(void)
 {
-    /* create the internal signal pipe */
-    if (pipe(pth_sigpipe) == -1)
-        return pth_error(FALSE, errno);
-    if (pth_fdmode(pth_sigpipe[0], PTH_FDMODE_NONBLOCK) == PTH_FDMODE_ERROR)
+    /* initialize the I/O multiplexer and the signal
+       multiplexer (which the I/O multiplexer watches) */
+    if (!pth_iomux_init())
         return pth_error(FALSE, errno);
-    if (pth_fdmode(pth_sigpipe[1], PTH_FDMODE_NONBLOCK) == PTH_FDMODE_ERROR)
+    if (!pth_sigmux_init())
         return pth_error(FALSE, errno);
 
+    /* initialize the timer index and the tasks */
+    pth_timer_init();
+    pth_task_init();
+#ifdef PTH_URING
+    pth_uring_init();
+#endif
+    pth_offload_init();
+
     /* initialize the essential threads */
     pth_sched   = NULL;
     pth_current = NULL;
@@ -68,6 +84,16 @@ intern int pth_scheduler_init(void)
     pth_pqueue_init(&pth_WQ);
     pth_pqueue_init(&pth_SQ);
     pth_pqueue_init(&pth_DQ);
+    pth_ring_init(&pth_DQwaiters);
+    pth_wakeup_head = NULL;
+    pth_wakeup_tail = NULL;
+
+    /* no thread is waiting, so the scheduler blocks all signals */
+    sigfillset(&pth_sigblock);
+    memset(pth_sigunblock, 0, sizeof(pth_sigunblock));
+    pth_sc(sigprocmask)(SIG_SETMASK, NULL, &pth_sigdefault);
+    memcpy(&pth_sigblockdef, &pth_sigdefault, sizeof(sigset_t));
+    pth_sigdefwaiters = 0;
 
     /* initialize scheduling hints */
     pth_favournew = 1; /* the default is the original behaviour */
@@ -76,6 +102,9 @@ intern int pth_scheduler_init(void)
     pth_loadval = 1.0;
     pth_time_set(&pth_loadticknext, PTH_TIME_NOW);
 
+    /* initialize the poll interval of the direct handoffs */
+    pth_time_set(&pth_pollnext, PTH_TIME_ZERO);
+
     return TRUE;
 }
 
@@ -95,8 +124,10 @@ intern void pth_scheduler_drop(void)
     pth_pqueue_init(&pth_RQ);
 
     /* clear the waiting queue */
-    while ((t = pth_pqueue_delmax(&pth_WQ)) != NULL)
+    while ((t = pth_pqueue_head(&pth_WQ)) != NULL) {
+        pth_sched_wq_delete(t);
         pth_tcb_free(t);
+    }
     pth_pqueue_init(&pth_WQ);
 
     /* clear the suspend queue */
@@ -108,6 +139,9 @@ intern void pth_scheduler_drop(void)
     while ((t = pth_pqueue_delmax(&pth_DQ)) != NULL)
         pth_tcb_free(t);
     pth_pqueue_init(&pth_DQ);
+
+    /* drop the tasks */
+    pth_task_drop();
     return;
 }
 
@@ -117,9 +151,181 @@ intern void pth_scheduler_kill(void)
     /* drop all threads */
     pth_scheduler_drop();
 
-    /* remove the internal signal pipe */
-    close(pth_sigpipe[0]);
-    close(pth_sigpipe[1]);
+    /* shutdown the multiplexers and the timer index */
+    pth_offload_kill();
+#ifdef PTH_URING
+    pth_uring_kill();
+#endif
+    pth_sigmux_kill();
+    pth_iomux_kill();
+    pth_timer_kill();
+    return;
+}
+
+/*
+ * Account the signals a thread entering (delta 1) or leaving (delta -1)
+ * the waiting queue does not block. The scheduler blocks exactly the
+ * signals all waiting threads block, so a signal is only unblocked while
+ * it is counted for at least one waiting thread. Threads which still have
+ * the signal mask they started with are just counted, only the few which
+ * changed it with pth_sigmask(3) are accounted per signal. A thread can
+ * change its signal mask only while it is running, i.e. never while it
+ * is waiting, so it always leaves the queue with the mask it was
+ * accounted with.
+ */
+static void pth_sched_wq_sigaccount(pth_t t, int delta)
+{
+    int sig;
+
+    if (!t->sigmaskown) {
+        pth_sigdefwaiters += delta;
+        return;
+    }
+    for (sig = 1; sig < PTH_NSIG; sig++) {
+        if (sigismember(&(t->mctx.sigs), sig))
+            continue;
+        if (delta > 0 && pth_sigunblock[sig]++ == 0) {
+            sigdelset(&pth_sigblock, sig);
+            sigdelset(&pth_sigblockdef, sig);
+        }
+        else if (delta < 0 && --pth_sigunblock[sig] == 0) {
+            sigaddset(&pth_sigblock, sig);
+            if (sigismember(&pth_sigdefault, sig))
+                sigaddset(&pth_sigblockdef, sig);
+        }
+    }
+    return;
+}
+
+/*
+ * Insert a thread into the waiting queue. This arms the thread's
+ * events, i.e. registers them with their sources (like the I/O
+ * multiplexer), which then notify the scheduler on occurrence.
+ * A pending cancellation request or thread-specific signals raised
+ * before are noticed right here, as they are not waited for anymore.
+ */
+intern void pth_sched_wq_insert(pth_t t)
+{
+    pth_event_t ev;
+
+    pth_pqueue_insert(&pth_WQ, t->prio, t);
+    pth_sched_wq_sigaccount(t, 1);
+    if ((ev = t->events) != NULL) {
+        do {
+            pth_event_arm(ev, t);
+        } while ((ev = ev->ev_next) != t->events);
+    }
+    if (t->cancelreq == TRUE) {
+        pth_debug2("pth_sched_wq_insert: cancellation request pending for thread \"%s\"", t->name);
+        pth_sched_wakeup(t);
+    }
+    if (t->sigpendcnt > 0)
+        pth_sched_wq_raise(t);
+    return;
+}
+
+/* deliver the thread-specific signals (pth_raise(3)) of a waiting
+   thread to its signal set events (process signals are delivered
+   by the signal multiplexer instead) */
+intern void pth_sched_wq_raise(pth_t t)
+{
+    pth_event_t ev;
+    int occurred;
+    int sig;
+
+    if ((ev = t->events) == NULL)
+        return;
+    do {
+        if (ev->ev_type != PTH_EVENT_SIGS || ev->ev_status != PTH_STATUS_PENDING)
+            continue;
+        occurred = FALSE;
+        for (sig = 1; sig < PTH_NSIG && t->sigpendcnt > 0; sig++) {
+            if (   sigismember(ev->ev_args.SIGS.sigs, sig)
+                && sigismember(&t->sigpending, sig)) {
+                if (ev->ev_args.SIGS.sig != NULL)
+                    *(ev->ev_args.SIGS.sig) = sig;
+                sigdelset(&t->sigpending, sig);
+                t->sigpendcnt--;
+                occurred = TRUE;
+            }
+        }
+        if (occurred) {
+            pth_debug2("pth_sched_wq_raise: thread signal occurred for thread \"%s\"", t->name);
+            ev->ev_status = PTH_STATUS_OCCURRED;
+            pth_sched_wakeup(t);
+        }
+    } while ((ev = ev->ev_next) != t->events);
+    return;
+}
+
+/* remove a thread from the waiting queue and disarm its events */
+intern void pth_sched_wq_delete(pth_t t)
+{
+    pth_event_t ev;
+    pth_t tp;
+
+    pth_pqueue_delete(&pth_WQ, t);
+    pth_sched_wq_sigaccount(t, -1);
+    if ((ev = t->events) != NULL) {
+        do {
+            pth_event_disarm(ev);
+        } while ((ev = ev->ev_next) != t->events);
+    }
+    if (t->wakeup) {
+        /* remove from the wakeup list, too (rare case) */
+        if (pth_wakeup_head == t)
+            pth_wakeup_head = t->wakenext;
+        else {
+            for (tp = pth_wakeup_head; tp->wakenext != t; tp = tp->wakenext)
+                ;
+            tp->wakenext = t->wakenext;
+            if (pth_wakeup_tail == t)
+                pth_wakeup_tail = tp;
+        }
+        if (pth_wakeup_head == NULL)
+            pth_wakeup_tail = NULL;
+        t->wakenext = NULL;
+        t->wakeup = FALSE;
+    }
+    return;
+}
+
+/* queue a waiting thread for being moved to the ready queue */
+intern void pth_sched_wakeup(pth_t t)
+{
+    if (t == NULL || t->wakeup)
+        return;
+    t->wakeup = TRUE;
+    t->wakenext = NULL;
+    if (pth_wakeup_tail != NULL)
+        pth_wakeup_tail->wakenext = t;
+    else
+        pth_wakeup_head = t;
+    pth_wakeup_tail = t;
+    return;
+}
+
+/*
+ * Move a waiting thread immediately from the waiting queue to the
+ * ready queue. This is used directly by the synchronization objects
+ * (which know exactly which threads to wake up) and for the threads
+ * queued for wakeup by the event manager.
+ */
+intern void pth_sched_ready(pth_t t)
+{
+    /*
+     * move thread to ready queue. we insert it with a slightly
+     * increased queue priority to it a better chance to immediately
+     * get scheduled, else the last running thread might immediately
+     * get again the CPU which is usually not what we want, because
+     * we oven use pth_yield() calls to give others a chance.
+     */
+    pth_sched_wq_delete(t);
+    t->state = PTH_STATE_READY;
+    pth_pqueue_insert(&pth_RQ, t->prio+1, t);
+    pth_event_tidnotify(t);
+    pth_debug2("pth_sched_ready: thread \"%s\" moved from waiting "
+               "to ready queue", t->name);
     return;
 }
 
@@ -152,16 +358,190 @@ intern void pth_scheduler_kill(void)
         pth_time_add(&pth_loadticknext, &pth_loadtickgap); \
     }
 
-/* the heart of this library: the thread scheduler */
-intern void *pth_scheduler(void *dummy)
+/* move threads from new queue to ready queue */
+static void pth_sched_newthreads(void)
+{
+    pth_t t;
+
+    /*
+     * Move threads from new queue to ready queue and optionally
+     * give them maximum priority so they start immediately.
+     */
+    while ((t = pth_pqueue_tail(&pth_NQ)) != NULL) {
+        pth_pqueue_delete(&pth_NQ, t);
+        t->state = PTH_STATE_READY;
+        if (pth_favournew)
+            pth_pqueue_insert(&pth_RQ, pth_pqueue_favorite_prio(&pth_RQ), t);
+        else
+            pth_pqueue_insert(&pth_RQ, PTH_PRIO_STD, t);
+        pth_event_tidnotify(t);
+        pth_debug2("pth_scheduler: new thread \"%s\" moved to top of ready queue", t->name);
+    }
+    return;
+}
+
+/* prepare a thread selected from the ready queue for being entered */
+static void pth_sched_enter(pth_t t)
+{
+    sigset_t ss;
+    int sig;
+
+    pth_debug4("pth_scheduler: thread \"%s\" selected (prio=%d, qprio=%d)",
+               t->name, t->prio, t->q_prio);
+
+    /*
+     * Raise additionally thread-specific signals
+     * (they are delivered when we switch the context, so the
+     * scheduler blocks all signals until the thread came back)
+     *
+     * Situation is ('#' = signal pending):
+     *     process pending (pth_sigpending):         ----####
+     *     thread pending (pth_current->sigpending): --##--##
+     * Result has to be:
+     *     process new pending:                      --######
+     */
+    if (t->sigpendcnt > 0) {
+        sigfillset(&ss);
+        pth_mctx_sigmask(&pth_sched->mctx, SIG_SETMASK, &ss, &pth_sigshared);
+        sigpending(&pth_sigpending);
+        for (sig = 1; sig < PTH_NSIG; sig++)
+            if (sigismember(&t->sigpending, sig))
+                if (!sigismember(&pth_sigpending, sig))
+                    kill(getpid(), sig);
+    }
+
+    /* update thread times */
+    pth_time_set(&t->lastran, PTH_TIME_NOW);
+    t->dispatches++;
+    return;
+}
+
+/*
+ * Handle a thread which just gave up the CPU: account the time it was
+ * running, check its thread-specific signals and its stack, and put it
+ * into the queue corresponding to its new state.
+ */
+static void pth_sched_leave(pth_t t, pth_time_t *now)
 {
-    sigset_t sigs;
     pth_time_t running;
-    pth_time_t snapshot;
     struct sigaction sa;
     sigset_t ss;
     int sig;
-    pth_t t;
+
+    /*
+     * Calculate and update the time the previous thread was running
+     */
+    pth_time_set(&running, now);
+    pth_time_sub(&running, &t->lastran);
+    pth_time_add(&t->running, &running);
+    pth_debug3("pth_scheduler: thread \"%s\" ran %.6f",
+               t->name, pth_time_t2d(&running));
+
+    /*
+     * Remove still pending thread-specific signals
+     * (they are re-delivered next time)
+     *
+     * Situation is ('#' = signal pending):
+     *     thread old pending (pth_current->sigpending): --##--##
+     *     process old pending (pth_sigpending):         ----####
+     *     process still pending (sigstillpending):      ---#-#-#
+     * Result has to be:
+     *     process new pending:                          -----#-#
+     *     thread new pending (pth_current->sigpending): ---#---#
+     */
+    if (t->sigpendcnt > 0) {
+        sigset_t sigstillpending;
+        sigpending(&sigstillpending);
+        for (sig = 1; sig < PTH_NSIG; sig++) {
+            if (sigismember(&t->sigpending, sig)) {
+                if (!sigismember(&sigstillpending, sig)) {
+                    /* thread (and perhaps also process) signal delivered */
+                    sigdelset(&t->sigpending, sig);
+                    t->sigpendcnt--;
+                }
+                else if (!sigismember(&pth_sigpending, sig)) {
+                    /* thread signal not delivered */
+                    pth_util_sigdelete(sig);
+                }
+            }
+        }
+        pth_mctx_sigshare(&pth_sched->mctx, &pth_sigshared);
+    }
+
+    /*
+     * Check for stack overflow
+     */
+    if (t->stackguard != NULL) {
+        if (*t->stackguard != 0xDEAD) {
+            pth_debug3("pth_scheduler: stack overflow detected for thread 0x%lx (\"%s\")",
+                       (unsigned long)t, t->name);
+            /*
+             * if the application doesn't catch SIGSEGVs, we terminate
+             * manually with a SIGSEGV now, but output a reasonable message.
+             */
+            if (sigaction(SIGSEGV, NULL, &sa) == 0) {
+                if (sa.sa_handler == SIG_DFL) {
+                    fprintf(stderr, "**Pth** STACK OVERFLOW: thread pid_t=0x%lx, name=\"%s\"\n",
+                            (unsigned long)t, t->name);
+                    kill(getpid(), SIGSEGV);
+                    sigfillset(&ss);
+                    sigdelset(&ss, SIGSEGV);
+                    sigsuspend(&ss);
+                    abort();
+                }
+            }
+            /*
+             * else we terminate the thread only and send us a SIGSEGV
+             * which allows the application to handle the situation...
+             */
+            t->join_arg = (void *)0xDEAD;
+            t->state = PTH_STATE_DEAD;
+            pth_event_tidnotify(t);
+            kill(getpid(), SIGSEGV);
+        }
+    }
+
+    /*
+     * If previous thread is now marked as dead, kick it out
+     */
+    if (t->state == PTH_STATE_DEAD) {
+        pth_debug2("pth_scheduler: marking thread \"%s\" as dead", t->name);
+        if (!t->joinable)
+            pth_tcb_free(t);
+        else {
+            pth_pqueue_insert(&pth_DQ, PTH_PRIO_STD, t);
+            pth_event_tidnotify(NULL);
+        }
+        t = NULL;
+    }
+
+    /*
+     * If thread wants to wait for an event
+     * move it to waiting queue now
+     */
+    if (t != NULL && t->state == PTH_STATE_WAITING) {
+        pth_debug2("pth_scheduler: moving thread \"%s\" to waiting queue",
+                   t->name);
+        pth_sched_wq_insert(t);
+        t = NULL;
+    }
+
+    /*
+     * migrate old treads in ready queue into higher
+     * priorities to avoid starvation and insert last running
+     * thread back into this queue, too.
+     */
+    pth_pqueue_increase(&pth_RQ);
+    if (t != NULL)
+        pth_pqueue_insert(&pth_RQ, t->prio, t);
+    return;
+}
+
+/* the heart of this library: the thread scheduler */
+intern void *pth_scheduler(void *dummy)
+{
+    pth_time_t running;
+    pth_time_t snapshot;
 
     /*
      * bootstrapping
@@ -171,9 +551,8 @@ intern void *pth_scheduler(void *dummy)
     /* mark this thread as the special scheduler thread */
     pth_sched->state = PTH_STATE_SCHEDULER;
 
-    /* block all signals in the scheduler thread */
-    sigfillset(&sigs);
-    pth_sc(sigprocmask)(SIG_SETMASK, &sigs, NULL);
+    /* the scheduler thread keeps the signal mask shared by the threads,
+       signals are blocked only while it waits in the event manager */
 
     /* initialize the snapshot time for bootstrapping the loop */
     pth_time_set(&snapshot, PTH_TIME_NOW);
@@ -183,18 +562,14 @@ intern void *pth_scheduler(void *dummy)
      */
     for (;;) {
         /*
-         * Move threads from new queue to ready queue and optionally
-         * give them maximum priority so they start immediately.
+         * Run the tasks whose events occurred
          */
-        while ((t = pth_pqueue_tail(&pth_NQ)) != NULL) {
-            pth_pqueue_delete(&pth_NQ, t);
-            t->state = PTH_STATE_READY;
-            if (pth_favournew)
-                pth_pqueue_insert(&pth_RQ, pth_pqueue_favorite_prio(&pth_RQ), t);
-            else
-                pth_pqueue_insert(&pth_RQ, PTH_PRIO_STD, t);
-            pth_debug2("pth_scheduler: new thread \"%s\" moved to top of ready queue", t->name);
-        }
+        pth_task_dispatch();
+
+        /*
+         * Move new threads to the ready queue
+         */
+        pth_sched_newthreads();
 
         /*
          * Update average scheduler load
@@ -210,154 +585,37 @@ intern void *pth_scheduler(void *dummy)
                             "no more thread(s) available to schedule!?!?\n");
             abort();
         }
-        pth_debug4("pth_scheduler: thread \"%s\" selected (prio=%d, qprio=%d)",
-                   pth_current->name, pth_current->prio, pth_current->q_prio);
-
-        /*
-         * Raise additionally thread-specific signals
-         * (they are delivered when we switch the context)
-         *
-         * Situation is ('#' = signal pending):
-         *     process pending (pth_sigpending):         ----####
-         *     thread pending (pth_current->sigpending): --##--##
-         * Result has to be:
-         *     process new pending:                      --######
-         */
-        if (pth_current->sigpendcnt > 0) {
-            sigpending(&pth_sigpending);
-            for (sig = 1; sig < PTH_NSIG; sig++)
-                if (sigismember(&pth_current->sigpending, sig))
-                    if (!sigismember(&pth_sigpending, sig))
-                        kill(getpid(), sig);
-        }
 
         /*
          * Set running start time for new thread
          * and perform a context switch to it
          */
+        pth_sched_enter(pth_current);
         pth_debug3("pth_scheduler: switching to thread 0x%lx (\"%s\")",
                    (unsigned long)pth_current, pth_current->name);
 
-        /* update thread times */
-        pth_time_set(&pth_current->lastran, PTH_TIME_NOW);
-
         /* update scheduler times */
         pth_time_set(&running, &pth_current->lastran);
         pth_time_sub(&running, &snapshot);
         pth_time_add(&pth_sched->running, &running);
 
         /* ** ENTERING THREAD ** - by switching the machine context */
-        pth_current->dispatches++;
         pth_mctx_switch(&pth_sched->mctx, &pth_current->mctx);
 
         /* update scheduler times */
         pth_time_set(&snapshot, PTH_TIME_NOW);
-        pth_debug3("pth_scheduler: cameback from thread 0x%lx (\"%s\")",
-                   (unsigned long)pth_current, pth_current->name);
 
         /*
-         * Calculate and update the time the previous thread was running
+         * Handle the thread which came back. If it already handled
+         * itself in pth_sched_handoff() it has left pth_current empty.
          */
-        pth_time_set(&running, &snapshot);
-        pth_time_sub(&running, &pth_current->lastran);
-        pth_time_add(&pth_current->running, &running);
-        pth_debug3("pth_scheduler: thread \"%s\" ran %.6f",
-                   pth_current->name, pth_time_t2d(&running));
-
-        /*
-         * Remove still pending thread-specific signals
-         * (they are re-delivered next time)
-         *
-         * Situation is ('#' = signal pending):
-         *     thread old pending (pth_current->sigpending): --##--##
-         *     process old pending (pth_sigpending):         ----####
-         *     process still pending (sigstillpending):      ---#-#-#
-         * Result has to be:
-         *     process new pending:                          -----#-#
-         *     thread new pending (pth_current->sigpending): ---#---#
-         */
-        if (pth_current->sigpendcnt > 0) {
-            sigset_t sigstillpending;
-            sigpending(&sigstillpending);
-            for (sig = 1; sig < PTH_NSIG; sig++) {
-                if (sigismember(&pth_current->sigpending, sig)) {
-                    if (!sigismember(&sigstillpending, sig)) {
-                        /* thread (and perhaps also process) signal delivered */
-                        sigdelset(&pth_current->sigpending, sig);
-                        pth_current->sigpendcnt--;
-                    }
-                    else if (!sigismember(&pth_sigpending, sig)) {
-                        /* thread signal not delivered */
-                        pth_util_sigdelete(sig);
-                    }
-                }
-            }
-        }
-
-        /*
-         * Check for stack overflow
-         */
-        if (pth_current->stackguard != NULL) {
-            if (*pth_current->stackguard != 0xDEAD) {
-                pth_debug3("pth_scheduler: stack overflow detected for thread 0x%lx (\"%s\")",
-                           (unsigned long)pth_current, pth_current->name);
-                /*
-                 * if the application doesn't catch SIGSEGVs, we terminate
-                 * manually with a SIGSEGV now, but output a reasonable message.
-                 */
-                if (sigaction(SIGSEGV, NULL, &sa) == 0) {
-                    if (sa.sa_handler == SIG_DFL) {
-                        fprintf(stderr, "**Pth** STACK OVERFLOW: thread pid_t=0x%lx, name=\"%s\"\n",
-                                (unsigned long)pth_current, pth_current->name);
-                        kill(getpid(), SIGSEGV);
-                        sigfillset(&ss);
-                        sigdelset(&ss, SIGSEGV);
-                        sigsuspend(&ss);
-                        abort();
-                    }
-                }
-                /*
-                 * else we terminate the thread only and send us a SIGSEGV
-                 * which allows the application to handle the situation...
-                 */
-                pth_current->join_arg = (void *)0xDEAD;
-                pth_current->state = PTH_STATE_DEAD;
-                kill(getpid(), SIGSEGV);
-            }
-        }
-
-        /*
-         * If previous thread is now marked as dead, kick it out
-         */
-        if (pth_current->state == PTH_STATE_DEAD) {
-            pth_debug2("pth_scheduler: marking thread \"%s\" as dead", pth_current->name);
-            if (!pth_current->joinable)
-                pth_tcb_free(pth_current);
-            else
-                pth_pqueue_insert(&pth_DQ, PTH_PRIO_STD, pth_current);
+        if (pth_current != NULL) {
+            pth_debug3("pth_scheduler: cameback from thread 0x%lx (\"%s\")",
+                       (unsigned long)pth_current, pth_current->name);
+            pth_sched_leave(pth_current, &snapshot);
             pth_current = NULL;
         }
 
-        /*
-         * If thread wants to wait for an event
-         * move it to waiting queue now
-         */
-        if (pth_current != NULL && pth_current->state == PTH_STATE_WAITING) {
-            pth_debug2("pth_scheduler: moving thread \"%s\" to waiting queue",
-                       pth_current->name);
-            pth_pqueue_insert(&pth_WQ, pth_current->prio, pth_current);
-            pth_current = NULL;
-        }
-
-        /*
-         * migrate old treads in ready queue into higher
-         * priorities to avoid starvation and insert last running
-         * thread back into this queue, too.
-         */
-        pth_pqueue_increase(&pth_RQ);
-        if (pth_current != NULL)
-            pth_pqueue_insert(&pth_RQ, pth_current->prio, pth_current);
-
         /*
          * Manage the events in the waiting queue, i.e. decide whether their
          * events occurred and move them to the ready queue. But wait only if
@@ -376,209 +634,172 @@ intern void *pth_scheduler(void *dummy)
     return NULL;
 }
 
+/*
+ * Move all threads queued for wakeup (because at least one of their
+ * events occurred or failed or they were cancelled) from the waiting
+ * queue to the ready queue.
+ */
+static void pth_sched_eventmanager_wakeup(void)
+{
+    pth_t t;
+
+    while ((t = pth_wakeup_head) != NULL) {
+        pth_wakeup_head = t->wakenext;
+        if (pth_wakeup_head == NULL)
+            pth_wakeup_tail = NULL;
+        t->wakenext = NULL;
+        t->wakeup = FALSE;
+        pth_sched_ready(t);
+    }
+    return;
+}
+
+/*
+ * Give up the CPU of the current thread. Instead of switching into
+ * the scheduler thread, which then switches to the next thread, the
+ * scheduling decision is made directly on the stack of the current
+ * thread, which then switches straight to its successor. The event
+ * manager (and the custom event functions it calls) runs on the stack
+ * of the scheduler thread only, so while threads or tasks wait for
+ * events the scheduler thread is entered whenever a timer elapsed or
+ * the last poll is longer than pth_pollgap ago. It is entered as well
+ * if there is no successor, tasks have to be run or a thread cannot
+ * be handled here (because it is dead, has overflowed its stack or
+ * deals with thread-specific signals).
+ */
+intern void pth_sched_handoff(void)
+{
+    pth_event_t ev;
+    pth_time_t now;
+    pth_t self;
+    pth_t next;
+
+    self = pth_current;
+    self->stacksp = (char *)&now; /* for pth_tcb_stack_trim() */
+    if (   self->state == PTH_STATE_DEAD
+        || self->sigpendcnt > 0
+        || (self->stackguard != NULL && *self->stackguard != 0xDEAD)) {
+        pth_mctx_switch(&self->mctx, &pth_sched->mctx);
+        return;
+    }
+
+    /* put ourself into the queue corresponding to our new state */
+    pth_time_set(&now, PTH_TIME_NOW);
+    pth_sched_leave(self, &now);
+    pth_sched_newthreads();
+
+    /* move the threads whose events occurred meanwhile to the ready queue */
+    if (pth_wakeup_head != NULL)
+        pth_sched_eventmanager_wakeup();
+
+    /* hand off only if the event manager has nothing to look after yet
+       (no elapsed timer and no poll due for the waiting threads and tasks)
+       and the next thread has no thread-specific signals raised for it */
+    next = pth_pqueue_head(&pth_RQ);
+    ev = pth_timer_next();
+    if (   next == NULL
+        || next->sigpendcnt > 0
+        || pth_task_pending()
+        || (ev != NULL && pth_time_cmp(&(ev->ev_due), &now) <= 0)
+        || (   (pth_pqueue_elements(&pth_WQ) > 0 || pth_ring_elements(&pth_tasks) > 0)
+            && pth_time_cmp(&now, &pth_pollnext) >= 0)) {
+        /* let the scheduler thread do the job */
+        pth_debug2("pth_sched_handoff: thread \"%s\" switches to scheduler",
+                   self->name);
+        pth_current = NULL;
+        pth_mctx_switch(&self->mctx, &pth_sched->mctx);
+        return;
+    }
+
+    /* select and enter the next thread */
+    pth_scheduler_load(&now);
+    pth_pqueue_delete(&pth_RQ, next);
+    pth_current = next;
+    pth_sched_enter(next);
+    if (next != self) {
+        pth_debug3("pth_sched_handoff: thread \"%s\" switches to thread \"%s\"",
+                   self->name, next->name);
+        pth_mctx_switch(&self->mctx, &next->mctx);
+    }
+    return;
+}
+
+/*
+ * Handle the elapsed timers of the timer index. The timer of a custom
+ * function event elapses whenever the function has to be checked
+ * (again), so this calls the function and restarts its check interval
+ * or lets the event occur.
+ */
+static void pth_sched_eventmanager_timers(pth_time_t *now)
+{
+    pth_event_t ev;
+    pth_time_t tv;
+
+    while ((ev = pth_timer_next()) != NULL && pth_time_cmp(&(ev->ev_due), now) <= 0) {
+        if (   ev->ev_type == PTH_EVENT_FUNC
+            && ev->ev_status == PTH_STATUS_PENDING
+            && !ev->ev_args.FUNC.func(ev->ev_args.FUNC.arg)) {
+            /* restart the interval (strictly after now, else a zero
+               interval would let it elapse again and again in this loop) */
+            pth_time_set(&tv, now);
+            pth_time_add(&tv, &(ev->ev_args.FUNC.tv));
+            if (pth_time_cmp(&tv, now) <= 0) {
+                pth_time_add(&tv, &pth_timergap);
+            }
+            pth_timer_update(ev, &tv);
+            continue;
+        }
+        pth_timer_delete(ev);
+        if (ev->ev_status == PTH_STATUS_PENDING) {
+            pth_debug3("pth_sched_eventmanager: [%s] event occurred for thread \"%s\"",
+                       ev->ev_type == PTH_EVENT_FUNC ? "function" : "timeout",
+                       ev->ev_thread->name);
+            ev->ev_status = PTH_STATUS_OCCURRED;
+            pth_event_wakeup(ev);
+        }
+    }
+    return;
+}
+
 /*
  * Look whether some events already occurred (or failed) and move
  * corresponding threads from waiting queue back to ready queue.
+ * In waiting mode (i.e. within the scheduler thread) the tasks whose
+ * events occurred are run meanwhile. Every source of events notifies
+ * the waiters of its events itself (the threads and the cancellation
+ * and thread signal requests on arming and raising, the timers and the
+ * custom functions through the timer index and the rest through the
+ * multiplexers), so a pass only costs the occurred events.
  */
 intern void pth_sched_eventmanager(pth_time_t *now, int dopoll)
 {
-    pth_t nexttimer_thread;
     pth_event_t nexttimer_ev;
-    pth_time_t nexttimer_value;
-    pth_event_t evh;
-    pth_event_t ev;
-    pth_t t;
-    pth_t tlast;
-    int this_occurred;
-    int any_occurred;
-    fd_set rfds;
-    fd_set wfds;
-    fd_set efds;
-    struct timeval delay;
-    struct timeval *pdelay;
-    sigset_t oss;
-    struct sigaction sa;
-    struct sigaction osa[1+PTH_NSIG];
-    char minibuf[128];
+    pth_time_t delay;
+    pth_time_t *pdelay;
+    sigset_t sigmask;
     int loop_repeat;
-    int fdmax;
-    int rc;
-    int sig;
-    int n;
 
     pth_debug2("pth_sched_eventmanager: enter in %s mode",
                dopoll ? "polling" : "waiting");
 
+    /* let the direct handoffs poll again after the poll interval */
+    pth_time_set(&pth_pollnext, now);
+    pth_time_add(&pth_pollnext, &pth_pollgap);
+
     /* entry point for internal looping in event handling */
     loop_entry:
     loop_repeat = FALSE;
 
-    /* initialize fd sets */
-    FD_ZERO(&rfds);
-    FD_ZERO(&wfds);
-    FD_ZERO(&efds);
-    fdmax = -1;
-
-    /* initialize signal status */
-    sigpending(&pth_sigpending);
-    sigfillset(&pth_sigblock);
-    sigemptyset(&pth_sigcatch);
-    sigemptyset(&pth_sigraised);
-
-    /* initialize next timer */
-    pth_time_set(&nexttimer_value, PTH_TIME_ZERO);
-    nexttimer_thread = NULL;
-    nexttimer_ev = NULL;
-
-    /* for all threads in the waiting queue... */
-    any_occurred = FALSE;
-    for (t = pth_pqueue_head(&pth_WQ); t != NULL;
-         t = pth_pqueue_walk(&pth_WQ, t, PTH_WALK_NEXT)) {
-
-        /* determine signals we block */
-        for (sig = 1; sig < PTH_NSIG; sig++)
-            if (!sigismember(&(t->mctx.sigs), sig))
-                sigdelset(&pth_sigblock, sig);
-
-        /* cancellation support */
-        if (t->cancelreq == TRUE)
-            any_occurred = TRUE;
-
-        /* ... and all their events... */
-        if (t->events == NULL)
-            continue;
-        /* ...check whether events occurred */
-        ev = evh = t->events;
-        do {
-            if (ev->ev_status == PTH_STATUS_PENDING) {
-                this_occurred = FALSE;
-
-                /* Filedescriptor I/O */
-                if (ev->ev_type == PTH_EVENT_FD) {
-                    /* filedescriptors are checked later all at once.
-                       Here we only assemble them in the fd sets */
-                    if (ev->ev_goal & PTH_UNTIL_FD_READABLE)
-                        FD_SET(ev->ev_args.FD.fd, &rfds);
-                    if (ev->ev_goal & PTH_UNTIL_FD_WRITEABLE)
-                        FD_SET(ev->ev_args.FD.fd, &wfds);
-                    if (ev->ev_goal & PTH_UNTIL_FD_EXCEPTION)
-                        FD_SET(ev->ev_args.FD.fd, &efds);
-                    if (fdmax < ev->ev_args.FD.fd)
-                        fdmax = ev->ev_args.FD.fd;
-                }
-                /* Filedescriptor Set Select I/O */
-                else if (ev->ev_type == PTH_EVENT_SELECT) {
-                    /* filedescriptors are checked later all at once.
-                       Here we only merge the fd sets. */
-                    pth_util_fds_merge(ev->ev_args.SELECT.nfd,
-                                       ev->ev_args.SELECT.rfds, &rfds,
-                                       ev->ev_args.SELECT.wfds, &wfds,
-                                       ev->ev_args.SELECT.efds, &efds);
-                    if (fdmax < ev->ev_args.SELECT.nfd-1)
-                        fdmax = ev->ev_args.SELECT.nfd-1;
-                }
-                /* Signal Set */
-                else if (ev->ev_type == PTH_EVENT_SIGS) {
-                    for (sig = 1; sig < PTH_NSIG; sig++) {
-                        if (sigismember(ev->ev_args.SIGS.sigs, sig)) {
-                            /* thread signal handling */
-                            if (sigismember(&t->sigpending, sig)) {
-                                *(ev->ev_args.SIGS.sig) = sig;
-                                sigdelset(&t->sigpending, sig);
-                                t->sigpendcnt--;
-                                this_occurred = TRUE;
-                            }
-                            /* process signal handling */
-                            if (sigismember(&pth_sigpending, sig)) {
-                                if (ev->ev_args.SIGS.sig != NULL)
-                                    *(ev->ev_args.SIGS.sig) = sig;
-                                pth_util_sigdelete(sig);
-                                sigdelset(&pth_sigpending, sig);
-                                this_occurred = TRUE;
-                            }
-                            else {
-                                sigdelset(&pth_sigblock, sig);
-                                sigaddset(&pth_sigcatch, sig);
-                            }
-                        }
-                    }
-                }
-                /* Timer */
-                else if (ev->ev_type == PTH_EVENT_TIME) {
-                    if (pth_time_cmp(&(ev->ev_args.TIME.tv), now) < 0)
-                        this_occurred = TRUE;
-                    else {
-                        /* remember the timer which will be elapsed next */
-                        if ((nexttimer_thread == NULL && nexttimer_ev == NULL) ||
-                            pth_time_cmp(&(ev->ev_args.TIME.tv), &nexttimer_value) < 0) {
-                            nexttimer_thread = t;
-                            nexttimer_ev = ev;
-                            pth_time_set(&nexttimer_value, &(ev->ev_args.TIME.tv));
-                        }
-                    }
-                }
-                /* Message Port Arrivals */
-                else if (ev->ev_type == PTH_EVENT_MSG) {
-                    if (pth_ring_elements(&(ev->ev_args.MSG.mp->mp_queue)) > 0)
-                        this_occurred = TRUE;
-                }
-                /* Mutex Release */
-                else if (ev->ev_type == PTH_EVENT_MUTEX) {
-                    if (!(ev->ev_args.MUTEX.mutex->mx_state & PTH_MUTEX_LOCKED))
-                        this_occurred = TRUE;
-                }
-                /* Condition Variable Signal */
-                else if (ev->ev_type == PTH_EVENT_COND) {
-                    if (ev->ev_args.COND.cond->cn_state & PTH_COND_SIGNALED) {
-                        if (ev->ev_args.COND.cond->cn_state & PTH_COND_BROADCAST)
-                            this_occurred = TRUE;
-                        else {
-                            if (!(ev->ev_args.COND.cond->cn_state & PTH_COND_HANDLED)) {
-                                ev->ev_args.COND.cond->cn_state |= PTH_COND_HANDLED;
-                                this_occurred = TRUE;
-                            }
-                        }
-                    }
-                }
-                /* Thread Termination */
-                else if (ev->ev_type == PTH_EVENT_TID) {
-                    if (   (   ev->ev_args.TID.tid == NULL
-                            && pth_pqueue_elements(&pth_DQ) > 0)
-                        || (   ev->ev_args.TID.tid != NULL
-                            && ev->ev_args.TID.tid->state == ev->ev_goal))
-                        this_occurred = TRUE;
-                }
-                /* Custom Event Function */
-                else if (ev->ev_type == PTH_EVENT_FUNC) {
-                    if (ev->ev_args.FUNC.func(ev->ev_args.FUNC.arg))
-                        this_occurred = TRUE;
-                    else {
-                        pth_time_t tv;
-                        pth_time_set(&tv, now);
-                        pth_time_add(&tv, &(ev->ev_args.FUNC.tv));
-                        if ((nexttimer_thread == NULL && nexttimer_ev == NULL) ||
-                            pth_time_cmp(&tv, &nexttimer_value) < 0) {
-                            nexttimer_thread = t;
-                            nexttimer_ev = ev;
-                            pth_time_set(&nexttimer_value, &tv);
-                        }
-                    }
-                }
+    /* handle the timers (and functions) which already elapsed
+       and determine the timer which will be elapsed next */
+    pth_sched_eventmanager_timers(now);
+    nexttimer_ev = pth_timer_next();
 
-                /* tag event if it has occurred */
-                if (this_occurred) {
-                    pth_debug2("pth_sched_eventmanager: [non-I/O] event occurred for thread \"%s\"", t->name);
-                    ev->ev_status = PTH_STATUS_OCCURRED;
-                    any_occurred = TRUE;
-                }
-            }
-        } while ((ev = ev->ev_next) != evh);
-    }
-    if (any_occurred)
+    if (pth_wakeup_head != NULL)
         dopoll = TRUE;
 
     /* now decide how to poll for fd I/O and timers */
-    if (dopoll) {
+    if (dopoll || pth_task_pending()) {
         /* do a polling with immediate timeout,
            i.e. check the fd sets only without blocking */
         pth_time_set(&delay, PTH_TIME_ZERO);
@@ -587,7 +808,7 @@ intern void pth_sched_eventmanager(pth_time_t *now, int dopoll)
     else if (nexttimer_ev != NULL) {
         /* do a polling with a timeout set to the next timer,
            i.e. wait for the fd sets or the next timer */
-        pth_time_set(&delay, &nexttimer_value);
+        pth_time_set(&delay, &(nexttimer_ev->ev_due));
         pth_time_sub(&delay, now);
         pdelay = &delay;
     }
@@ -597,237 +818,60 @@ intern void pth_sched_eventmanager(pth_time_t *now, int dopoll)
         pdelay = NULL;
     }
 
-    /* clear pipe and let select() wait for the read-part of the pipe */
-    while (pth_sc(read)(pth_sigpipe[0], minibuf, sizeof(minibuf)) > 0) ;
-    FD_SET(pth_sigpipe[0], &rfds);
-    if (fdmax < pth_sigpipe[0])
-        fdmax = pth_sigpipe[0];
-
-    /* replace signal actions for signals we've to catch for events */
-    for (sig = 1; sig < PTH_NSIG; sig++) {
-        if (sigismember(&pth_sigcatch, sig)) {
-            sa.sa_handler = pth_sched_eventmanager_sighandler;
-            sigfillset(&sa.sa_mask);
-            sa.sa_flags = 0;
-            sigaction(sig, &sa, &osa[sig]);
-        }
-    }
+    /* allow some signals to be delivered while polling: Either
+       to the signal multiplexer or directly to the configured
+       handler for signals not waited for by events (the signals
+       the waiting threads do not block are already accounted) */
+    memcpy(&sigmask, (pth_sigdefwaiters > 0 ? &pth_sigblockdef : &pth_sigblock),
+           sizeof(sigset_t));
+    pth_sigmux_pollmask(&sigmask);
 
-    /* allow some signals to be delivered: Either to our
-       catching handler or directly to the configured
-       handler for signals not catched by events */
-    pth_sc(sigprocmask)(SIG_SETMASK, &pth_sigblock, &oss);
+#ifdef PTH_URING
+    /* pass the I/O requests queued by the threads to the kernel at once */
+    pth_uring_flush();
+#endif
 
     /* now do the polling for filedescriptor I/O and timers
        WHEN THE SCHEDULER SLEEPS AT ALL, THEN HERE!! */
-    rc = -1;
-    if (!(dopoll && fdmax == -1))
-        while ((rc = pth_sc(select)(fdmax+1, &rfds, &wfds, &efds, pdelay)) < 0
-               && errno == EINTR) ;
-
-    /* restore signal mask and actions and handle signals */
-    pth_sc(sigprocmask)(SIG_SETMASK, &oss, NULL);
-    for (sig = 1; sig < PTH_NSIG; sig++)
-        if (sigismember(&pth_sigcatch, sig))
-            sigaction(sig, &osa[sig], NULL);
+    pth_iomux_poll(pdelay, &sigmask);
 
-    /* if the timer elapsed, handle it */
-    if (!dopoll && rc == 0 && nexttimer_ev != NULL) {
-        if (nexttimer_ev->ev_type == PTH_EVENT_FUNC) {
-            /* it was an implicit timer event for a function event,
-               so repeat the event handling for rechecking the function */
-            loop_repeat = TRUE;
-        }
-        else {
-            /* it was an explicit timer event, standing for its own */
-            pth_debug2("pth_sched_eventmanager: [timeout] event occurred for thread \"%s\"",
-                       nexttimer_thread->name);
-            nexttimer_ev->ev_status = PTH_STATUS_OCCURRED;
-        }
-    }
+    /* deliver the caught signals to the waiting events */
+    pth_sigmux_dispatch();
 
-    /* if the internal signal pipe was used, adjust the select() results */
-    if (!dopoll && rc > 0 && FD_ISSET(pth_sigpipe[0], &rfds)) {
-        FD_CLR(pth_sigpipe[0], &rfds);
-        rc--;
-    }
+    /* deliver the completions of the offloaded jobs to the waiting threads */
+    pth_offload_dispatch();
 
-    /* if an error occurred, avoid confusion in the cleanup loop */
-    if (rc <= 0) {
-        FD_ZERO(&rfds);
-        FD_ZERO(&wfds);
-        FD_ZERO(&efds);
+    /* if the timer elapsed, handle it */
+    if (!dopoll && nexttimer_ev != NULL) {
+        pth_time_set(now, PTH_TIME_NOW);
+        pth_sched_eventmanager_timers(now);
     }
 
-    /* now comes the final cleanup loop where we've to
-       do two jobs: first we've to do the late handling of the fd I/O events and
-       additionally if a thread has one occurred event, we move it from the
-       waiting queue to the ready queue */
-
-    /* for all threads in the waiting queue... */
-    t = pth_pqueue_head(&pth_WQ);
-    while (t != NULL) {
-
-        /* do the late handling of the fd I/O and signal
-           events in the waiting event ring */
-        any_occurred = FALSE;
-        if (t->events != NULL) {
-            ev = evh = t->events;
-            do {
-                /*
-                 * Late handling for still not occured events
-                 */
-                if (ev->ev_status == PTH_STATUS_PENDING) {
-                    /* Filedescriptor I/O */
-                    if (ev->ev_type == PTH_EVENT_FD) {
-                        if (   (   ev->ev_goal & PTH_UNTIL_FD_READABLE
-                                && FD_ISSET(ev->ev_args.FD.fd, &rfds))
-                            || (   ev->ev_goal & PTH_UNTIL_FD_WRITEABLE
-                                && FD_ISSET(ev->ev_args.FD.fd, &wfds))
-                            || (   ev->ev_goal & PTH_UNTIL_FD_EXCEPTION
-                                && FD_ISSET(ev->ev_args.FD.fd, &efds)) ) {
-                            pth_debug2("pth_sched_eventmanager: "
-                                       "[I/O] event occurred for thread \"%s\"", t->name);
-                            ev->ev_status = PTH_STATUS_OCCURRED;
-                        }
-                        else if (rc < 0) {
-                            /* re-check particular filedescriptor */
-                            int rc2;
-                            if (ev->ev_goal & PTH_UNTIL_FD_READABLE)
-                                FD_SET(ev->ev_args.FD.fd, &rfds);
-                            if (ev->ev_goal & PTH_UNTIL_FD_WRITEABLE)
-                                FD_SET(ev->ev_args.FD.fd, &wfds);
-                            if (ev->ev_goal & PTH_UNTIL_FD_EXCEPTION)
-                                FD_SET(ev->ev_args.FD.fd, &efds);
-                            pth_time_set(&delay, PTH_TIME_ZERO);
-                            while ((rc2 = pth_sc(select)(ev->ev_args.FD.fd+1, &rfds, &wfds, &efds, &delay)) < 0
-                                   && errno == EINTR) ;
-                            if (rc2 > 0) {
-                                /* cleanup afterwards for next iteration */
-                                FD_CLR(ev->ev_args.FD.fd, &rfds);
-                                FD_CLR(ev->ev_args.FD.fd, &wfds);
-                                FD_CLR(ev->ev_args.FD.fd, &efds);
-                            } else if (rc2 < 0) {
-                                /* cleanup afterwards for next iteration */
-                                FD_ZERO(&rfds);
-                                FD_ZERO(&wfds);
-                                FD_ZERO(&efds);
-                                ev->ev_status = PTH_STATUS_FAILED;
-                                pth_debug2("pth_sched_eventmanager: "
-                                           "[I/O] event failed for thread \"%s\"", t->name);
-                            }
-                        }
-                    }
-                    /* Filedescriptor Set I/O */
-                    else if (ev->ev_type == PTH_EVENT_SELECT) {
-                        if (pth_util_fds_test(ev->ev_args.SELECT.nfd,
-                                              ev->ev_args.SELECT.rfds, &rfds,
-                                              ev->ev_args.SELECT.wfds, &wfds,
-                                              ev->ev_args.SELECT.efds, &efds)) {
-                            n = pth_util_fds_select(ev->ev_args.SELECT.nfd,
-                                                    ev->ev_args.SELECT.rfds, &rfds,
-                                                    ev->ev_args.SELECT.wfds, &wfds,
-                                                    ev->ev_args.SELECT.efds, &efds);
-                            if (ev->ev_args.SELECT.n != NULL)
-                                *(ev->ev_args.SELECT.n) = n;
-                            ev->ev_status = PTH_STATUS_OCCURRED;
-                            pth_debug2("pth_sched_eventmanager: "
-                                       "[I/O] event occurred for thread \"%s\"", t->name);
-                        }
-                        else if (rc < 0) {
-                            /* re-check particular filedescriptor set */
-                            int rc2;
-                            fd_set *prfds = NULL;
-                            fd_set *pwfds = NULL;
-                            fd_set *pefds = NULL;
-                            fd_set trfds;
-                            fd_set twfds;
-                            fd_set tefds;
-                            if (ev->ev_args.SELECT.rfds) {
-                                memcpy(&trfds, ev->ev_args.SELECT.rfds, sizeof(rfds));
-                                prfds = &trfds;
-                            }
-                            if (ev->ev_args.SELECT.wfds) {
-                                memcpy(&twfds, ev->ev_args.SELECT.wfds, sizeof(wfds));
-                                pwfds = &twfds;
-                            }
-                            if (ev->ev_args.SELECT.efds) {
-                                memcpy(&tefds, ev->ev_args.SELECT.efds, sizeof(efds));
-                                pefds = &tefds;
-                            }
-                            pth_time_set(&delay, PTH_TIME_ZERO);
-                            while ((rc2 = pth_sc(select)(ev->ev_args.SELECT.nfd+1, prfds, pwfds, pefds, &delay)) < 0
-                                   && errno == EINTR) ;
-                            if (rc2 < 0) {
-                                ev->ev_status = PTH_STATUS_FAILED;
-                                pth_debug2("pth_sched_eventmanager: "
-                                           "[I/O] event failed for thread \"%s\"", t->name);
-                            }
-                        }
-                    }
-                    /* Signal Set */
-                    else if (ev->ev_type == PTH_EVENT_SIGS) {
-                        for (sig = 1; sig < PTH_NSIG; sig++) {
-                            if (sigismember(ev->ev_args.SIGS.sigs, sig)) {
-                                if (sigismember(&pth_sigraised, sig)) {
-                                    if (ev->ev_args.SIGS.sig != NULL)
-                                        *(ev->ev_args.SIGS.sig) = sig;
-                                    pth_debug2("pth_sched_eventmanager: "
-                                               "[signal] event occurred for thread \"%s\"", t->name);
-                                    sigdelset(&pth_sigraised, sig);
-                                    ev->ev_status = PTH_STATUS_OCCURRED;
-                                }
-                            }
-                        }
-                    }
-                }
-                /*
-                 * post-processing for already occured events
-                 */
-                else {
-                    /* Condition Variable Signal */
-                    if (ev->ev_type == PTH_EVENT_COND) {
-                        /* clean signal */
-                        if (ev->ev_args.COND.cond->cn_state & PTH_COND_SIGNALED) {
-                            ev->ev_args.COND.cond->cn_state &= ~(PTH_COND_SIGNALED);
-                            ev->ev_args.COND.cond->cn_state &= ~(PTH_COND_BROADCAST);
-                            ev->ev_args.COND.cond->cn_state &= ~(PTH_COND_HANDLED);
-                        }
-                    }
-                }
-
-                /* local to global mapping */
-                if (ev->ev_status != PTH_STATUS_PENDING)
-                    any_occurred = TRUE;
-            } while ((ev = ev->ev_next) != evh);
-        }
-
-        /* cancellation support */
-        if (t->cancelreq == TRUE) {
-            pth_debug2("pth_sched_eventmanager: cancellation request pending for thread \"%s\"", t->name);
-            any_occurred = TRUE;
-        }
-
-        /* walk to next thread in waiting queue */
-        tlast = t;
-        t = pth_pqueue_walk(&pth_WQ, t, PTH_WALK_NEXT);
+    /* deliver the filedescriptor I/O readiness to the waiting events */
+    pth_iomux_dispatch();
+#ifdef PTH_URING
+    /* deliver the I/O completions to the waiting threads */
+    pth_uring_dispatch();
+#endif
+
+    /* in waiting mode run the tasks whose events occurred (they can
+       make threads ready directly, e.g. by sending them messages) */
+    if (!dopoll)
+        pth_task_dispatch();
+
+    /* readiness can be reported although no thread is waiting for it
+       (pinned filedescriptors), so never leave the waiting mode without
+       at least one thread to run, even if the timer elapsed meanwhile.
+       Once there is one, an internal looping must not block anymore. */
+    if (   pth_wakeup_head != NULL
+        || pth_pqueue_elements(&pth_RQ) > 0
+        || pth_pqueue_elements(&pth_NQ) > 0)
+        dopoll = TRUE;
+    else if (!dopoll)
+        loop_repeat = TRUE;
 
-        /*
-         * move last thread to ready queue if any events occurred for it.
-         * we insert it with a slightly increased queue priority to it a
-         * better chance to immediately get scheduled, else the last running
-         * thread might immediately get again the CPU which is usually not
-         * what we want, because we oven use pth_yield() calls to give others
-         * a chance.
-         */
-        if (any_occurred) {
-            pth_pqueue_delete(&pth_WQ, tlast);
-            tlast->state = PTH_STATE_READY;
-            pth_pqueue_insert(&pth_RQ, tlast->prio+1, tlast);
-            pth_debug2("pth_sched_eventmanager: thread \"%s\" moved from waiting "
-                       "to ready queue", tlast->name);
-        }
-    }
+    /* move threads with occurred events to the ready queue */
+    pth_sched_eventmanager_wakeup();
 
     /* perhaps we have to internally loop... */
     if (loop_repeat) {
@@ -839,16 +883,3 @@ intern void pth_sched_eventmanager(pth_time_t *now, int dopoll)
     return;
 }
 
-intern void pth_sched_eventmanager_sighandler(int sig)
-{
-    char c;
-
-    /* remember raised signal */
-    sigaddset(&pth_sigraised, sig);
-
-    /* write signal to signal pipe in order to awake the select() */
-    c = (int)sig;
-    pth_sc(write)(pth_sigpipe[1], &c, sizeof(char));
-    return;
-}
-
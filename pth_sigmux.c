@@ -0,0 +1,358 @@
+/*
+**  GNU Pth - The GNU Portable Threads
+**  Copyright (c) 1999-2006 Ralf S. Engelschall <rse@engelschall.com>
+**
+**  This file is part of GNU Pth, a non-preemptive thread scheduling
+**  library which can be found at http://www.gnu.org/software/pth/.
+**
+**  This library is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU Lesser General Public
+**  License as published by the Free Software Foundation; either
+**  version 2.1 of the License, or (at your option) any later version.
+**
+**  This library is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**  Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public
+**  License along with this library; if not, write to the Free Software
+**  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+**  USA, or contact Ralf S. Engelschall <rse@engelschall.com>.
+**
+**  pth_sigmux.c: Pth signal multiplexing
+*/
+                             /* ``It is not enough to be busy;
+                                  so are the ants. The question is:
+                                  What are we busy about?''
+                                        -- Henry David Thoreau */
+
+/*
+ * This is the signal multiplexer of the scheduler. The threads waiting
+ * for signals (PTH_EVENT_SIGS) are indexed by signal number: when an
+ * event is armed, one wait node per signal of its set is appended to
+ * the FIFO of waiters of that signal, and when the event is disarmed
+ * the nodes are removed again. The kernel side is only changed when a
+ * signal gains its first or loses its last waiter, so the scheduler
+ * loop itself neither has to scan the events of all waiting threads
+ * for signals nor to install and remove signal actions on every pass.
+ *
+ * Two backends exist: signalfd(2) where available, whose mask holds
+ * exactly the signals with waiters and whose filedescriptor is watched
+ * permanently by the I/O multiplexer (the signals stay blocked while
+ * the scheduler polls and are read from the filedescriptor), and the
+ * portable fallback, a catching handler which is installed as long as
+ * a signal has waiters and which writes the signal number into the
+ * internal signal pipe (the signals are unblocked while the scheduler
+ * polls). An occurred signal is delivered to its first waiter only.
+ */
+
+#include "pth_p.h"
+
+#if defined(HAVE_SYS_SIGNALFD_H) && defined(HAVE_SIGNALFD)
+#define PTH_SIGMUX_SIGNALFD_AVAILABLE 1
+#endif
+
+/* the available backends */
+#define PTH_SIGMUX_HANDLER  1
+#define PTH_SIGMUX_SIGNALFD 2
+
+/* the per-signal waiter record */
+typedef struct {
+    pth_ring_t       waiters; /* wait nodes of the events armed for the signal */
+    struct sigaction osa;     /* handler: original action of the signal        */
+} pth_sigmux_sig_t;
+
+static int              pth_sigmux_type    = 0;    /* backend in use                   */
+static pth_sigmux_sig_t pth_sigmux_tab[PTH_NSIG];  /* waiter records indexed by signal */
+static sigset_t         pth_sigmux_caught;         /* signals with at least one waiter */
+static int              pth_sigmux_ncaught = 0;    /* number of signals with waiters   */
+static int              pth_sigmux_fd      = -1;   /* filedescriptor watched for signals */
+static int              pth_sigmux_pipe[2] = { -1, -1 }; /* handler: internal signal pipe */
+
+/* handler: catch a signal by writing its number into the signal pipe */
+static void pth_sigmux_sighandler(int sig)
+{
+    unsigned char c;
+    int errno_saved;
+
+    errno_saved = errno;
+    c = (unsigned char)sig;
+    pth_sc(write)(pth_sigmux_pipe[1], &c, sizeof(c));
+    errno = errno_saved;
+    return;
+}
+
+/* create the kernel side of the backend */
+static int pth_sigmux_open(void)
+{
+#ifdef PTH_SIGMUX_SIGNALFD_AVAILABLE
+    if ((pth_sigmux_fd = signalfd(-1, &pth_sigmux_caught, 0)) != -1) {
+        fcntl(pth_sigmux_fd, F_SETFD, FD_CLOEXEC);
+        if (pth_fdmode(pth_sigmux_fd, PTH_FDMODE_NONBLOCK) == PTH_FDMODE_ERROR)
+            return pth_error(FALSE, errno);
+        pth_sigmux_type = PTH_SIGMUX_SIGNALFD;
+        return TRUE;
+    }
+#endif
+    if (pipe(pth_sigmux_pipe) == -1)
+        return pth_error(FALSE, errno);
+    if (pth_fdmode(pth_sigmux_pipe[0], PTH_FDMODE_NONBLOCK) == PTH_FDMODE_ERROR)
+        return pth_error(FALSE, errno);
+    if (pth_fdmode(pth_sigmux_pipe[1], PTH_FDMODE_NONBLOCK) == PTH_FDMODE_ERROR)
+        return pth_error(FALSE, errno);
+    pth_sigmux_fd = pth_sigmux_pipe[0];
+    pth_sigmux_type = PTH_SIGMUX_HANDLER;
+    return TRUE;
+}
+
+/* destroy the kernel side of the backend */
+static void pth_sigmux_close(void)
+{
+    pth_fdmode_forget(pth_sigmux_pipe[0], FALSE);
+    pth_fdmode_forget(pth_sigmux_pipe[1], FALSE);
+    pth_fdmode_forget(pth_sigmux_fd, FALSE);
+    if (pth_sigmux_type == PTH_SIGMUX_HANDLER) {
+        close(pth_sigmux_pipe[0]);
+        close(pth_sigmux_pipe[1]);
+    }
+    else if (pth_sigmux_fd != -1)
+        close(pth_sigmux_fd);
+    pth_sigmux_pipe[0] = -1;
+    pth_sigmux_pipe[1] = -1;
+    pth_sigmux_fd      = -1;
+    return;
+}
+
+/* initialize the multiplexer and let the I/O multiplexer
+   permanently watch its filedescriptor */
+intern int pth_sigmux_init(void)
+{
+    int sig;
+
+    for (sig = 0; sig < PTH_NSIG; sig++)
+        pth_ring_init(&pth_sigmux_tab[sig].waiters);
+    sigemptyset(&pth_sigmux_caught);
+    pth_sigmux_ncaught = 0;
+    if (!pth_sigmux_open())
+        return FALSE;
+    return pth_iomux_watch(pth_sigmux_fd, PTH_UNTIL_FD_READABLE);
+}
+
+/* kill the multiplexer (all events have to be disarmed already) */
+intern void pth_sigmux_kill(void)
+{
+    pth_sigmux_close();
+    sigemptyset(&pth_sigmux_caught);
+    pth_sigmux_ncaught = 0;
+    pth_sigmux_type    = 0;
+    return;
+}
+
+/* re-create the kernel side in a forked child (which shares it with
+   the parent), but under the same filedescriptor numbers, so the
+   watch of the I/O multiplexer stays valid (has to be called before
+   pth_iomux_atfork() re-registers the watched filedescriptors) */
+intern void pth_sigmux_atfork(void)
+{
+    int fds[2];
+
+    if (pth_sigmux_type == PTH_SIGMUX_HANDLER) {
+        if (pipe(fds) == -1)
+            return;
+        dup2(fds[0], pth_sigmux_pipe[0]);
+        dup2(fds[1], pth_sigmux_pipe[1]);
+        close(fds[0]);
+        close(fds[1]);
+        pth_fdmode_forget(pth_sigmux_pipe[0], FALSE);
+        pth_fdmode_forget(pth_sigmux_pipe[1], FALSE);
+        pth_fdmode(pth_sigmux_pipe[0], PTH_FDMODE_NONBLOCK);
+        pth_fdmode(pth_sigmux_pipe[1], PTH_FDMODE_NONBLOCK);
+    }
+#ifdef PTH_SIGMUX_SIGNALFD_AVAILABLE
+    else if (pth_sigmux_type == PTH_SIGMUX_SIGNALFD) {
+        if ((fds[0] = signalfd(-1, &pth_sigmux_caught, 0)) == -1)
+            return;
+        dup2(fds[0], pth_sigmux_fd);
+        close(fds[0]);
+        fcntl(pth_sigmux_fd, F_SETFD, FD_CLOEXEC);
+        pth_fdmode_forget(pth_sigmux_fd, FALSE);
+        pth_fdmode(pth_sigmux_fd, PTH_FDMODE_NONBLOCK);
+    }
+#endif
+    return;
+}
+
+/* return the name of the backend in use */
+intern const char *pth_sigmux_name(void)
+{
+    if (pth_sigmux_type == PTH_SIGMUX_SIGNALFD)
+        return "signalfd";
+    return "handler";
+}
+
+/* start catching a signal which gained its first waiter */
+static void pth_sigmux_catch(int sig)
+{
+    struct sigaction sa;
+
+    sigaddset(&pth_sigmux_caught, sig);
+    pth_sigmux_ncaught++;
+#ifdef PTH_SIGMUX_SIGNALFD_AVAILABLE
+    if (pth_sigmux_type == PTH_SIGMUX_SIGNALFD) {
+        signalfd(pth_sigmux_fd, &pth_sigmux_caught, 0);
+        return;
+    }
+#endif
+    sa.sa_handler = pth_sigmux_sighandler;
+    sigfillset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(sig, &sa, &pth_sigmux_tab[sig].osa);
+    return;
+}
+
+/* stop catching a signal which lost its last waiter */
+static void pth_sigmux_release(int sig)
+{
+    sigdelset(&pth_sigmux_caught, sig);
+    pth_sigmux_ncaught--;
+#ifdef PTH_SIGMUX_SIGNALFD_AVAILABLE
+    if (pth_sigmux_type == PTH_SIGMUX_SIGNALFD) {
+        signalfd(pth_sigmux_fd, &pth_sigmux_caught, 0);
+        return;
+    }
+#endif
+    sigaction(sig, &pth_sigmux_tab[sig].osa, NULL);
+    return;
+}
+
+/* arm a signal related event */
+intern int pth_sigmux_arm(pth_event_t ev)
+{
+    pth_evnode_t *en;
+    int sig;
+    int n;
+
+    /* count the signals of the set */
+    n = 0;
+    for (sig = 1; sig < PTH_NSIG; sig++)
+        if (sigismember(ev->ev_args.SIGS.sigs, sig))
+            n++;
+    ev->ev_nodes  = NULL;
+    ev->ev_nnodes = 0;
+    if (n == 0)
+        return TRUE;
+
+    /* the usual single signal needs no extra wait nodes */
+    if (n == 1)
+        ev->ev_nodes = &ev->ev_node;
+    else if ((ev->ev_nodes = (pth_evnode_t *)malloc(n*sizeof(pth_evnode_t))) == NULL)
+        return pth_error(FALSE, ENOMEM);
+
+    /* register one wait node per signal */
+    for (sig = 1; sig < PTH_NSIG; sig++) {
+        if (!sigismember(ev->ev_args.SIGS.sigs, sig))
+            continue;
+        en = &ev->ev_nodes[ev->ev_nnodes++];
+        en->en_event = ev;
+        en->en_fd    = sig;
+        en->en_mask  = 0;
+        pth_ring_append(&pth_sigmux_tab[sig].waiters, &en->en_node);
+        if (pth_ring_elements(&pth_sigmux_tab[sig].waiters) == 1)
+            pth_sigmux_catch(sig);
+    }
+    return TRUE;
+}
+
+/* disarm a signal related event */
+intern void pth_sigmux_disarm(pth_event_t ev)
+{
+    pth_evnode_t *en;
+    int i;
+
+    for (i = 0; i < ev->ev_nnodes; i++) {
+        en = &ev->ev_nodes[i];
+        pth_ring_delete(&pth_sigmux_tab[en->en_fd].waiters, &en->en_node);
+        if (pth_ring_elements(&pth_sigmux_tab[en->en_fd].waiters) == 0)
+            pth_sigmux_release(en->en_fd);
+    }
+    if (ev->ev_nodes != NULL && ev->ev_nodes != &ev->ev_node)
+        free(ev->ev_nodes);
+    ev->ev_nodes  = NULL;
+    ev->ev_nnodes = 0;
+    return;
+}
+
+/*
+ * Adjust the signal mask the scheduler polls with: the signals with
+ * waiters have to stay blocked for signalfd(2) (or they would not be
+ * queued for reading) but have to be unblocked for the handler.
+ */
+intern void pth_sigmux_pollmask(sigset_t *mask)
+{
+    int sig;
+
+    if (pth_sigmux_ncaught == 0)
+        return;
+    for (sig = 1; sig < PTH_NSIG; sig++) {
+        if (sigismember(&pth_sigmux_caught, sig)) {
+            if (pth_sigmux_type == PTH_SIGMUX_SIGNALFD)
+                sigaddset(mask, sig);
+            else
+                sigdelset(mask, sig);
+        }
+    }
+    return;
+}
+
+/* deliver an occurred signal to its first still pending waiter */
+static void pth_sigmux_deliver(int sig)
+{
+    pth_ringnode_t *rn;
+    pth_event_t ev;
+
+    if (sig <= 0 || sig >= PTH_NSIG)
+        return;
+    rn = pth_ring_first(&pth_sigmux_tab[sig].waiters);
+    while (rn != NULL) {
+        ev = ((pth_evnode_t *)rn)->en_event;
+        if (ev->ev_status == PTH_STATUS_PENDING) {
+            if (ev->ev_args.SIGS.sig != NULL)
+                *(ev->ev_args.SIGS.sig) = sig;
+            pth_debug2("pth_sigmux_deliver: [signal] event occurred for thread \"%s\"",
+                       ev->ev_thread->name);
+            ev->ev_status = PTH_STATUS_OCCURRED;
+            pth_event_wakeup(ev);
+            return;
+        }
+        rn = pth_ring_next(&pth_sigmux_tab[sig].waiters, rn);
+    }
+    return;
+}
+
+/* deliver the signals caught since the last poll to their waiters */
+intern void pth_sigmux_dispatch(void)
+{
+#ifdef PTH_SIGMUX_SIGNALFD_AVAILABLE
+    struct signalfd_siginfo si[16];
+#endif
+    unsigned char buf[128];
+    ssize_t n;
+    int i;
+
+    if (!pth_iomux_ready(pth_sigmux_fd))
+        return;
+#ifdef PTH_SIGMUX_SIGNALFD_AVAILABLE
+    if (pth_sigmux_type == PTH_SIGMUX_SIGNALFD) {
+        while ((n = pth_sc(read)(pth_sigmux_fd, si, sizeof(si))) > 0)
+            for (i = 0; i < (int)(n / sizeof(struct signalfd_siginfo)); i++)
+                pth_sigmux_deliver((int)si[i].ssi_signo);
+        return;
+    }
+#endif
+    while ((n = pth_sc(read)(pth_sigmux_pipe[0], buf, sizeof(buf))) > 0)
+        for (i = 0; i < (int)n; i++)
+            pth_sigmux_deliver((int)buf[i]);
+    return;
+}
+
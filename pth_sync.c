@@ -28,6 +28,13 @@
                                           -- Unknown  */
 #include "pth_p.h"
 
+#if cpp
+
+/* internal event goal: the waiting thread wants to own the mutex */
+#define PTH_UNTIL_MUTEX_OWNED _BIT(19)
+
+#endif /* cpp */
+
 /*
 **  Mutual Exclusion Locks
 */
@@ -39,9 +46,46 @@ int pth_mutex_init(pth_mutex_t *mutex)
     mutex->mx_state = PTH_MUTEX_INITIALIZED;
     mutex->mx_owner = NULL;
     mutex->mx_count = 0;
+    pth_ring_init(&(mutex->mx_waitq));
     return TRUE;
 }
 
+/* make a thread the owner of an unlocked mutex */
+intern void pth_mutex_grant(pth_mutex_t *mutex, pth_t t)
+{
+    mutex->mx_state |= PTH_MUTEX_LOCKED;
+    mutex->mx_owner = t;
+    mutex->mx_count = 1;
+    pth_ring_append(&(t->mutexring), &(mutex->mx_node));
+    return;
+}
+
+/* completely unlock a mutex and hand it over to the next waiting thread */
+static void pth_mutex_unlock(pth_mutex_t *mutex)
+{
+    pth_event_t ev;
+    pth_t t;
+
+    pth_ring_delete(&(mutex->mx_owner->mutexring), &(mutex->mx_node));
+    mutex->mx_state &= ~(PTH_MUTEX_LOCKED);
+    mutex->mx_owner = NULL;
+    mutex->mx_count = 0;
+
+    /* wake up the waiting threads in FIFO order until one of them
+       wants to own the mutex, which then directly receives it */
+    while ((ev = pth_event_waitq_pop(&(mutex->mx_waitq), PTH_STATUS_OCCURRED)) != NULL) {
+        t = ev->ev_thread;
+        if (ev->ev_goal & PTH_UNTIL_MUTEX_OWNED) {
+            pth_debug2("pth_mutex_release: handing mutex over to thread \"%s\"", t->name);
+            pth_mutex_grant(mutex, t);
+        }
+        pth_event_ready(ev);
+        if (mutex->mx_state & PTH_MUTEX_LOCKED)
+            break;
+    }
+    return;
+}
+
 int pth_mutex_acquire(pth_mutex_t *mutex, int tryonly, pth_event_t ev_extra)
 {
     static pth_key_t ev_key = PTH_KEY_INIT;
@@ -57,10 +101,7 @@ int pth_mutex_acquire(pth_mutex_t *mutex, int tryonly, pth_event_t ev_extra)
 
     /* still not locked, so simply acquire mutex? */
     if (!(mutex->mx_state & PTH_MUTEX_LOCKED)) {
-        mutex->mx_state |= PTH_MUTEX_LOCKED;
-        mutex->mx_owner = pth_current;
-        mutex->mx_count = 1;
-        pth_ring_append(&(pth_current->mutexring), &(mutex->mx_node));
+        pth_mutex_grant(mutex, pth_current);
         pth_debug1("pth_mutex_acquire: immediately locking mutex");
         return TRUE;
     }
@@ -77,28 +118,25 @@ int pth_mutex_acquire(pth_mutex_t *mutex, int tryonly, pth_event_t ev_extra)
     if (tryonly)
         return pth_error(FALSE, EBUSY);
 
-    /* else wait for mutex to become unlocked.. */
-    pth_debug1("pth_mutex_acquire: wait until mutex is unlocked");
+    /* else wait until the releasing thread hands the mutex over to us.. */
+    pth_debug1("pth_mutex_acquire: wait until mutex is handed over");
     for (;;) {
-        ev = pth_event(PTH_EVENT_MUTEX|PTH_MODE_STATIC, &ev_key, mutex);
+        ev = pth_event(PTH_EVENT_MUTEX|PTH_UNTIL_MUTEX_OWNED|PTH_MODE_STATIC, &ev_key, mutex);
         if (ev_extra != NULL)
             pth_event_concat(ev, ev_extra, NULL);
         pth_wait(ev);
-        if (ev_extra != NULL) {
+        if (ev_extra != NULL)
             pth_event_isolate(ev);
-            if (pth_event_status(ev) == PTH_STATUS_PENDING)
-                return pth_error(FALSE, EINTR);
-        }
-        if (!(mutex->mx_state & PTH_MUTEX_LOCKED))
+        if (mutex->mx_owner == pth_current)
             break;
+        if (ev_extra != NULL && pth_event_status(ev) == PTH_STATUS_PENDING)
+            return pth_error(FALSE, EINTR);
+        if (!(mutex->mx_state & PTH_MUTEX_LOCKED)) {
+            pth_mutex_grant(mutex, pth_current);
+            break;
+        }
     }
-
-    /* now it's again unlocked, so acquire mutex */
-    pth_debug1("pth_mutex_acquire: locking mutex");
-    mutex->mx_state |= PTH_MUTEX_LOCKED;
-    mutex->mx_owner = pth_current;
-    mutex->mx_count = 1;
-    pth_ring_append(&(pth_current->mutexring), &(mutex->mx_node));
+    pth_debug1("pth_mutex_acquire: mutex locked");
     return TRUE;
 }
 
@@ -116,29 +154,22 @@ int pth_mutex_release(pth_mutex_t *mutex)
 
     /* decrement recursion counter and release mutex */
     mutex->mx_count--;
-    if (mutex->mx_count <= 0) {
-        mutex->mx_state &= ~(PTH_MUTEX_LOCKED);
-        mutex->mx_owner = NULL;
-        mutex->mx_count = 0;
-        pth_ring_delete(&(pth_current->mutexring), &(mutex->mx_node));
-    }
+    if (mutex->mx_count <= 0)
+        pth_mutex_unlock(mutex);
     return TRUE;
 }
 
 intern void pth_mutex_releaseall(pth_t thread)
 {
-    pth_ringnode_t *rn, *rnf;
+    pth_ringnode_t *rn;
 
     if (thread == NULL)
         return;
-    /* iterate over all mutexes of thread */
-    rn = rnf = pth_ring_first(&(thread->mutexring));
-    while (rn != NULL) {
-        pth_mutex_release((pth_mutex_t *)rn);
-        rn = pth_ring_next(&(thread->mutexring), rn);
-        if (rn == rnf)
-            break;
-    }
+    /* completely release all mutexes of thread (as a released
+       mutex can be handed over to another thread, always
+       take the first one instead of iterating over the ring) */
+    while ((rn = pth_ring_first(&(thread->mutexring))) != NULL)
+        pth_mutex_unlock((pth_mutex_t *)rn);
     return;
 }
 
@@ -232,6 +263,7 @@ int pth_cond_init(pth_cond_t *cond)
         return pth_error(FALSE, EINVAL);
     cond->cn_state   = PTH_COND_INITIALIZED;
     cond->cn_waiters = 0;
+    pth_ring_init(&(cond->cn_waitq));
     return TRUE;
 }
 
@@ -262,11 +294,8 @@ int pth_cond_await(pth_cond_t *cond, pth_mutex_t *mutex, pth_event_t ev_extra)
         return pth_error(FALSE, EDEADLK);
 
     /* check whether we can do a short-circuit wait */
-    if (    (cond->cn_state & PTH_COND_SIGNALED)
-        && !(cond->cn_state & PTH_COND_BROADCAST)) {
+    if (cond->cn_state & PTH_COND_SIGNALED) {
         cond->cn_state &= ~(PTH_COND_SIGNALED);
-        cond->cn_state &= ~(PTH_COND_BROADCAST);
-        cond->cn_state &= ~(PTH_COND_HANDLED);
         return TRUE;
     }
 
@@ -300,6 +329,9 @@ int pth_cond_await(pth_cond_t *cond, pth_mutex_t *mutex, pth_event_t ev_extra)
 
 int pth_cond_notify(pth_cond_t *cond, int broadcast)
 {
+    pth_event_t ev;
+    int woken;
+
     /* consistency checks */
     if (cond == NULL)
         return pth_error(FALSE, EINVAL);
@@ -308,13 +340,18 @@ int pth_cond_notify(pth_cond_t *cond, int broadcast)
 
     /* do something only if there is at least one waiters (POSIX semantics) */
     if (cond->cn_waiters > 0) {
-        /* signal the condition */
-        cond->cn_state |= PTH_COND_SIGNALED;
-        if (broadcast)
-            cond->cn_state |= PTH_COND_BROADCAST;
-        else
-            cond->cn_state &= ~(PTH_COND_BROADCAST);
-        cond->cn_state &= ~(PTH_COND_HANDLED);
+        /* move the first (or all) waiting thread(s) to the ready queue */
+        woken = 0;
+        while ((broadcast || woken == 0)
+               && (ev = pth_event_waitq_pop(&(cond->cn_waitq), PTH_STATUS_OCCURRED)) != NULL) {
+            pth_event_ready(ev);
+            woken++;
+        }
+
+        /* remember a signal nobody could receive right now
+           (a waiter which is currently not in the waiting queue) */
+        if (woken == 0 && !broadcast)
+            cond->cn_state |= PTH_COND_SIGNALED;
 
         /* and give other threads a chance to awake */
         pth_yield(NULL);
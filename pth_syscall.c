@@ -57,6 +57,8 @@
 #define sendto        __pth_sys_sendto
 #define pread         __pth_sys_pread
 #define pwrite        __pth_sys_pwrite
+#define preadv        __pth_sys_preadv
+#define pwritev       __pth_sys_pwritev
 
 /* include the private header and this way system headers */
 #include "pth_p.h"
@@ -108,6 +110,8 @@ int pth_syscall_hard = PTH_SYSCALL_HARD;
 #undef sendto
 #undef pread
 #undef pwrite
+#undef preadv
+#undef pwritev
 
 /* internal data structures */
 #if cpp
@@ -157,6 +161,8 @@ intern pth_syscall_fct_tab_t pth_syscall_fct_tab[] = {
 #define PTH_SCF_sendto        19
 #define PTH_SCF_pread         20
 #define PTH_SCF_pwrite        21
+#define PTH_SCF_preadv        22
+#define PTH_SCF_pwritev       23
     { "fork",        NULL },
     { "waitpid",     NULL },
     { "system",      NULL },
@@ -179,6 +185,8 @@ intern pth_syscall_fct_tab_t pth_syscall_fct_tab[] = {
     { "sendto",      NULL },
     { "pread",       NULL },
     { "pwrite",      NULL },
+    { "preadv",      NULL },
+    { "pwritev",     NULL },
     { NULL,          NULL }
 };
 #endif
@@ -516,8 +524,19 @@ int poll(struct pollfd *pfd, nfds_t nfd, int timeout)
     pth_implicit_init();
     return pth_poll(pfd, nfd, timeout);
 }
-/* NOTICE: internally fully emulated, so still no
-   internal exit point pth_sc_poll necessary! */
+intern int pth_sc_poll(struct pollfd *pfd, nfds_t nfd, int timeout)
+{
+    /* internal exit point for Pth */
+    if (pth_syscall_fct_tab[PTH_SCF_poll].addr != NULL)
+        return ((int (*)(struct pollfd *, nfds_t, int))
+               pth_syscall_fct_tab[PTH_SCF_poll].addr)
+               (pfd, nfd, timeout);
+#if defined(HAVE_SYSCALL) && defined(SYS_poll)
+    else return (int)syscall(SYS_poll, pfd, nfd, timeout);
+#else
+    else PTH_SYSCALL_ERROR(-1, ENOSYS, "poll");
+#endif
+}
 
 /* ==== Pth hard syscall wrapper for read(2) ==== */
 ssize_t read(int, void *, size_t);
@@ -615,8 +634,19 @@ ssize_t pread(int fd, void *buf, size_t nbytes, off_t offset)
     pth_implicit_init();
     return pth_pread(fd, buf, nbytes, offset);
 }
-/* NOTICE: internally fully emulated, so still no
-   internal exit point pth_sc_pread necessary! */
+intern ssize_t pth_sc_pread(int fd, void *buf, size_t nbytes, off_t offset)
+{
+    /* internal exit point for Pth */
+    if (pth_syscall_fct_tab[PTH_SCF_pread].addr != NULL)
+        return ((ssize_t (*)(int, void *, size_t, off_t))
+               pth_syscall_fct_tab[PTH_SCF_pread].addr)
+               (fd, buf, nbytes, offset);
+#if defined(HAVE_SYSCALL) && defined(SYS_pread64)
+    else return (ssize_t)syscall(SYS_pread64, fd, buf, nbytes, offset);
+#else
+    else PTH_SYSCALL_ERROR(-1, ENOSYS, "pread");
+#endif
+}
 
 /* ==== Pth hard syscall wrapper for pwrite(2) ==== */
 ssize_t pwrite(int, const void *, size_t, off_t);
@@ -626,8 +656,67 @@ ssize_t pwrite(int fd, const void *buf, size_t nbytes, off_t offset)
     pth_implicit_init();
     return pth_pwrite(fd, buf, nbytes, offset);
 }
-/* NOTICE: internally fully emulated, so still no
-   internal exit point pth_sc_pwrite necessary! */
+intern ssize_t pth_sc_pwrite(int fd, const void *buf, size_t nbytes, off_t offset)
+{
+    /* internal exit point for Pth */
+    if (pth_syscall_fct_tab[PTH_SCF_pwrite].addr != NULL)
+        return ((ssize_t (*)(int, const void *, size_t, off_t))
+               pth_syscall_fct_tab[PTH_SCF_pwrite].addr)
+               (fd, buf, nbytes, offset);
+#if defined(HAVE_SYSCALL) && defined(SYS_pwrite64)
+    else return (ssize_t)syscall(SYS_pwrite64, fd, buf, nbytes, offset);
+#else
+    else PTH_SYSCALL_ERROR(-1, ENOSYS, "pwrite");
+#endif
+}
+
+/* ==== Pth hard syscall wrapper for preadv(2) ==== */
+ssize_t preadv(int, const struct iovec *, int, off_t);
+ssize_t preadv(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    /* external entry point for application */
+    pth_implicit_init();
+    return pth_preadv(fd, iov, iovcnt, offset);
+}
+intern ssize_t pth_sc_preadv(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    /* internal exit point for Pth */
+    if (pth_syscall_fct_tab[PTH_SCF_preadv].addr != NULL)
+        return ((ssize_t (*)(int, const struct iovec *, int, off_t))
+               pth_syscall_fct_tab[PTH_SCF_preadv].addr)
+               (fd, iov, iovcnt, offset);
+#if defined(HAVE_SYSCALL) && defined(SYS_preadv)
+    /* the kernel expects the offset split into its low and high word */
+    else return (ssize_t)syscall(SYS_preadv, fd, iov, iovcnt, (unsigned long)offset,
+                                 (unsigned long)((unsigned long long)offset >> 32));
+#else
+    else PTH_SYSCALL_ERROR(-1, ENOSYS, "preadv");
+#endif
+}
+
+/* ==== Pth hard syscall wrapper for pwritev(2) ==== */
+ssize_t pwritev(int, const struct iovec *, int, off_t);
+ssize_t pwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    /* external entry point for application */
+    pth_implicit_init();
+    return pth_pwritev(fd, iov, iovcnt, offset);
+}
+intern ssize_t pth_sc_pwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    /* internal exit point for Pth */
+    if (pth_syscall_fct_tab[PTH_SCF_pwritev].addr != NULL)
+        return ((ssize_t (*)(int, const struct iovec *, int, off_t))
+               pth_syscall_fct_tab[PTH_SCF_pwritev].addr)
+               (fd, iov, iovcnt, offset);
+#if defined(HAVE_SYSCALL) && defined(SYS_pwritev)
+    /* the kernel expects the offset split into its low and high word */
+    else return (ssize_t)syscall(SYS_pwritev, fd, iov, iovcnt, (unsigned long)offset,
+                                 (unsigned long)((unsigned long long)offset >> 32));
+#else
+    else PTH_SYSCALL_ERROR(-1, ENOSYS, "pwritev");
+#endif
+}
 
 /* ==== Pth hard syscall wrapper for recv(2) ==== */
 ssize_t recv(int, void *, size_t, int);
@@ -0,0 +1,264 @@
+/*
+**  GNU Pth - The GNU Portable Threads
+**  Copyright (c) 1999-2006 Ralf S. Engelschall <rse@engelschall.com>
+**
+**  This file is part of GNU Pth, a non-preemptive thread scheduling
+**  library which can be found at http://www.gnu.org/software/pth/.
+**
+**  This library is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU Lesser General Public
+**  License as published by the Free Software Foundation; either
+**  version 2.1 of the License, or (at your option) any later version.
+**
+**  This library is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**  Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public
+**  License along with this library; if not, write to the Free Software
+**  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+**  USA, or contact Ralf S. Engelschall <rse@engelschall.com>.
+**
+**  pth_task.c: Pth stackless tasks
+*/
+                             /* ``Perfection is achieved, not when
+                                  there is nothing more to add, but
+                                  when there is nothing left to take
+                                  away.''
+                                    -- Antoine de Saint-Exupery */
+
+/*
+ * A task is a run-to-completion callback without a stack and machine
+ * context of its own. It waits for an event ring exactly like a thread
+ * does in pth_wait(3), i.e., its events are armed with their sources,
+ * but with the scheduler thread standing in as the waiting thread and
+ * the task recorded in the events. Once one of its events occurred
+ * (or failed), the task is queued for dispatching and the scheduler
+ * thread calls it on its own stack. The callback then returns the
+ * event ring to wait for next (which is usually the same ring again)
+ * or NULL to end the task.
+ */
+
+#include "pth_p.h"
+
+#if cpp
+
+    /* task states */
+#define PTH_TASK_WAITING 0 /* events armed, waiting for one of them  */
+#define PTH_TASK_READY   1 /* queued for dispatching                 */
+#define PTH_TASK_RUNNING 2 /* callback currently running             */
+
+    /* task control block */
+struct pth_task_st {
+    pth_ringnode_t   tk_node;    /* ring linkage of all tasks (has to be first!) */
+    pth_task_t       tk_next;    /* next task queued for dispatching             */
+    pth_event_t    (*tk_func)(void *, pth_event_t); /* task callback            */
+    void            *tk_arg;     /* task callback argument                       */
+    pth_event_t      tk_events;  /* events the task is waiting for (or NULL)     */
+    int              tk_state;   /* current state of task                        */
+    int              tk_cancel;  /* whether task was cancelled while running     */
+};
+
+#endif /* cpp */
+
+intern pth_ring_t  pth_tasks;                /* ring of all tasks           */
+static pth_task_t  pth_task_head = NULL;     /* first task to dispatch      */
+static pth_task_t  pth_task_tail = NULL;     /* last task to dispatch       */
+static int         pth_task_num  = 0;        /* number of tasks to dispatch */
+
+/* initialize the tasks */
+intern void pth_task_init(void)
+{
+    pth_ring_init(&pth_tasks);
+    pth_task_head = NULL;
+    pth_task_tail = NULL;
+    pth_task_num  = 0;
+    return;
+}
+
+/* queue a task for dispatching */
+intern void pth_task_wakeup(pth_task_t task)
+{
+    if (task->tk_state != PTH_TASK_WAITING)
+        return;
+    task->tk_state = PTH_TASK_READY;
+    task->tk_next = NULL;
+    if (pth_task_tail != NULL)
+        pth_task_tail->tk_next = task;
+    else
+        pth_task_head = task;
+    pth_task_tail = task;
+    pth_task_num++;
+    return;
+}
+
+/* check whether tasks are queued for dispatching */
+intern int pth_task_pending(void)
+{
+    return (pth_task_head != NULL);
+}
+
+/* let a task wait for a ring of events */
+static void pth_task_arm(pth_task_t task, pth_event_t ev_ring)
+{
+    pth_event_t ev;
+    int nonpending;
+
+    task->tk_state  = PTH_TASK_WAITING;
+    task->tk_events = ev_ring;
+    if (ev_ring == NULL) {
+        pth_task_wakeup(task);
+        return;
+    }
+
+    /* mark all events in the ring as still pending (as pth_wait(3)
+       does), except for mutex events which would hand over the mutex
+       to the task (only threads can own a mutex) */
+    nonpending = 0;
+    ev = ev_ring;
+    do {
+        if (   ev->ev_type == PTH_EVENT_MUTEX
+            && (ev->ev_goal & PTH_UNTIL_MUTEX_OWNED)) {
+            ev->ev_status = PTH_STATUS_FAILED;
+            nonpending++;
+        }
+        else
+            ev->ev_status = PTH_STATUS_PENDING;
+    } while ((ev = ev->ev_next) != ev_ring);
+    if (nonpending > 0) {
+        pth_task_wakeup(task);
+        return;
+    }
+
+    /* arm the events */
+    ev = ev_ring;
+    do {
+        pth_event_arm_task(ev, task);
+    } while ((ev = ev->ev_next) != ev_ring);
+    return;
+}
+
+/* disarm the events a task is waiting for */
+static void pth_task_disarm(pth_task_t task)
+{
+    pth_event_t ev;
+
+    if ((ev = task->tk_events) != NULL) {
+        do {
+            pth_event_disarm(ev);
+        } while ((ev = ev->ev_next) != task->tk_events);
+    }
+    return;
+}
+
+/* remove a task from the dispatching queue (rare case) */
+static void pth_task_unqueue(pth_task_t task)
+{
+    pth_task_t tp;
+
+    if (pth_task_head == task)
+        pth_task_head = task->tk_next;
+    else {
+        for (tp = pth_task_head; tp->tk_next != task; tp = tp->tk_next)
+            ;
+        tp->tk_next = task->tk_next;
+        if (pth_task_tail == task)
+            pth_task_tail = tp;
+    }
+    if (pth_task_head == NULL)
+        pth_task_tail = NULL;
+    task->tk_next = NULL;
+    pth_task_num--;
+    return;
+}
+
+/* spawn a new task */
+pth_task_t pth_task_spawn(pth_event_t ev_ring, pth_event_t (*func)(void *, pth_event_t), void *arg)
+{
+    pth_task_t task;
+
+    if (func == NULL)
+        return pth_error((pth_task_t)NULL, EINVAL);
+    if ((task = (pth_task_t)malloc(sizeof(struct pth_task_st))) == NULL)
+        return pth_error((pth_task_t)NULL, errno);
+    task->tk_func   = func;
+    task->tk_arg    = arg;
+    task->tk_next   = NULL;
+    task->tk_cancel = FALSE;
+    pth_ring_append(&pth_tasks, &(task->tk_node));
+    pth_task_arm(task, ev_ring);
+    return task;
+}
+
+/* cancel a task */
+int pth_task_cancel(pth_task_t task)
+{
+    if (task == NULL)
+        return pth_error(FALSE, EINVAL);
+    if (task->tk_state == PTH_TASK_RUNNING) {
+        /* the task cancels itself, so end it once its callback returns */
+        task->tk_cancel = TRUE;
+        return TRUE;
+    }
+    if (task->tk_state == PTH_TASK_READY)
+        pth_task_unqueue(task);
+    pth_task_disarm(task);
+    pth_ring_delete(&pth_tasks, &(task->tk_node));
+    free(task);
+    return TRUE;
+}
+
+/*
+ * Run the tasks which were queued for dispatching when entering this
+ * function (tasks queued meanwhile are run on the next call, so a task
+ * re-arming an event which already occurred cannot starve the scheduler).
+ * This is called by the scheduler thread only.
+ */
+intern int pth_task_dispatch(void)
+{
+    pth_task_t task;
+    pth_event_t ev_ring;
+    int num;
+    int n;
+
+    num = pth_task_num;
+    n = 0;
+    while (n < num && (task = pth_task_head) != NULL) {
+        pth_task_head = task->tk_next;
+        if (pth_task_head == NULL)
+            pth_task_tail = NULL;
+        task->tk_next = NULL;
+        pth_task_num--;
+        n++;
+
+        /* run the callback with its events no longer armed */
+        pth_task_disarm(task);
+        task->tk_state = PTH_TASK_RUNNING;
+        ev_ring = task->tk_func(task->tk_arg, task->tk_events);
+
+        /* either end the task or let it wait again */
+        if (ev_ring == NULL || task->tk_cancel) {
+            pth_ring_delete(&pth_tasks, &(task->tk_node));
+            free(task);
+        }
+        else
+            pth_task_arm(task, ev_ring);
+    }
+    return n;
+}
+
+/* drop all tasks */
+intern void pth_task_drop(void)
+{
+    pth_task_t task;
+
+    while ((task = (pth_task_t)pth_ring_pop(&pth_tasks)) != NULL) {
+        pth_task_disarm(task);
+        free(task);
+    }
+    pth_task_head = NULL;
+    pth_task_tail = NULL;
+    pth_task_num  = 0;
+    return;
+}
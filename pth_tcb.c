@@ -35,7 +35,9 @@ struct pth_st {
     /* priority queue handling */
     pth_t          q_next;               /* next thread in pool                         */
     pth_t          q_prev;               /* previous thread in pool                     */
-    int            q_prio;               /* (relative) priority of thread when queued   */
+    int            q_prio;               /* priority level of thread when queued        */
+    unsigned int   q_age;                /* age of queue when thread was queued         */
+    struct pth_pqueue_st *q_queue;       /* queue thread is currently in (or NULL)      */
 
     /* standard thread control block ingredients */
     int            prio;                 /* base priority of thread                     */
@@ -50,17 +52,25 @@ struct pth_st {
 
     /* event handling */
     pth_event_t    events;               /* events the tread is waiting for             */
+    int            wakeup;               /* whether thread is queued for wakeup         */
+    pth_t          wakenext;             /* next thread queued for wakeup               */
+    pth_ring_t     waiters;              /* events waiting for a state of thread        */
 
     /* per-thread signal handling */
     sigset_t       sigpending;           /* set    of pending signals                   */
     int            sigpendcnt;           /* number of pending signals                   */
+    int            sigmaskown;           /* whether signal mask differs from default    */
 
     /* machine context */
     pth_mctx_t     mctx;                 /* last saved machine state of thread          */
     char          *stack;                /* pointer to thread stack                     */
+    char          *stacksp;              /* stack position when thread last gave up CPU */
     unsigned int   stacksize;            /* size of thread stack                        */
     long          *stackguard;           /* stack overflow guard                        */
     int            stackloan;            /* stack type                                  */
+    int            stackprof;            /* whether stack is pre-filled for profiling   */
+    int            stackrefs;            /* abandoned requests still using the stack    */
+    int            stacklimbo;           /* whether freed, but kept for the requests    */
     void        *(*start_func)(void *);  /* start routine                               */
     void          *start_arg;            /* start argument                              */
 
@@ -99,28 +109,298 @@ intern const char *pth_state_names[] = {
 #define SIGSTKSZ 8192
 #endif
 
+/*
+ * Large thread stacks (and with guard pages all of them) are separate
+ * anonymous mappings instead of heap memory, and the page beyond the
+ * end of each such stack is inaccessible. A stack overflow then
+ * immediately faults instead of silently corrupting foreign memory, so
+ * these stacks need no stack guard word. With guard pages a SIGSEGV
+ * handler running on an alternate signal stack additionally reports
+ * the overflowing thread.
+ *
+ * Large stacks are mapped without reserving swap space, so only the
+ * pages a thread actually touches are committed and a huge number of
+ * threads can have large virtual stacks. For a thread waiting for
+ * events the physical memory of the part of its stack beyond its
+ * current stack position can then be released again with
+ * pth_tcb_stack_trim().
+ */
+#define PTH_TCB_LAZYSTACK (256*1024)
+#define PTH_TCB_STACKSLACK 2048
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+#if !defined(MAP_ANON) && defined(MAP_ANONYMOUS)
+#define MAP_ANON MAP_ANONYMOUS
+#endif
+#ifndef MAP_FAILED
+#define MAP_FAILED ((void *)-1)
+#endif
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+#ifdef PTH_GUARDPAGES
+#define PTH_TCB_MAPPED(size) ((void)(size), TRUE)
+#else
+#define PTH_TCB_MAPPED(size) ((size) >= PTH_TCB_LAZYSTACK)
+#endif
+#else
+#define PTH_TCB_MAPPED(size) ((void)(size), FALSE)
+#endif
+#define PTH_TCB_ALTSTACK (32*1024)
+static size_t pth_tcb_pagesize = 0;
+#define PTH_TCB_PAGEALIGN(n) \
+        (((n) + pth_tcb_pagesize - 1) & ~(pth_tcb_pagesize - 1))
+
+/* allocate memory for a thread stack */
+static char *pth_tcb_stack_alloc(unsigned int size)
+{
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+    char *base;
+    char *guard;
+    size_t len;
+    int flags;
+
+    if (PTH_TCB_MAPPED(size)) {
+        if (pth_tcb_pagesize == 0)
+            pth_tcb_pagesize = (size_t)sysconf(_SC_PAGESIZE);
+        len = PTH_TCB_PAGEALIGN(size) + pth_tcb_pagesize;
+        flags = MAP_PRIVATE|MAP_ANON;
+        if (size >= PTH_TCB_LAZYSTACK)
+            flags |= MAP_NORESERVE;
+        base = (char *)mmap(NULL, len, PROT_READ|PROT_WRITE, flags, -1, 0);
+        if (base == (char *)MAP_FAILED)
+            return NULL;
+#if PTH_STACKGROWTH < 0
+        guard = base;
+#else
+        guard = base + len - pth_tcb_pagesize;
+#endif
+        if (mprotect(guard, pth_tcb_pagesize, PROT_NONE) == -1) {
+            pth_shield { munmap(base, len); }
+            return NULL;
+        }
+#if PTH_STACKGROWTH < 0
+        base += pth_tcb_pagesize;
+#endif
+        return base;
+    }
+#endif
+    return (char *)malloc(size);
+}
+
+/* release memory of a thread stack */
+static void pth_tcb_stack_free(char *stack, unsigned int size)
+{
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+    if (PTH_TCB_MAPPED(size)) {
+#if PTH_STACKGROWTH < 0
+        munmap(stack - pth_tcb_pagesize, PTH_TCB_PAGEALIGN(size) + pth_tcb_pagesize);
+#else
+        munmap(stack, PTH_TCB_PAGEALIGN(size) + pth_tcb_pagesize);
+#endif
+        return;
+    }
+#endif
+    free(stack);
+    return;
+}
+
+/* release the physical memory of a range of a mapped stack */
+static int pth_tcb_stack_release(char *lo, char *hi)
+{
+#if defined(HAVE_MADVISE) && defined(MADV_DONTNEED)
+    if (hi <= lo)
+        return FALSE;
+    if (madvise(lo, (size_t)(hi - lo), MADV_DONTNEED) == -1)
+        return FALSE;
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+/*
+ * Terminated threads leave their control block plus stack in a pool,
+ * from where pth_tcb_alloc() recycles them without going through
+ * malloc(3) and free(3) again. The pool is divided into size classes
+ * of stacks with powers of two between 16KB and 1MB (other stacks are
+ * not pooled) and the blocks of a class are chained through their
+ * q_next field. Once a class holds more than the high watermark of
+ * blocks, it is trimmed down to the low watermark. The stack class
+ * of the default thread stack size can be pre-warmed up to the low
+ * watermark.
+ */
+#define PTH_TCB_POOL_MINSTACK (16*1024)
+#define PTH_TCB_POOL_CLASSES  7
+#define PTH_TCB_POOL_SIZE(c)  (PTH_TCB_POOL_MINSTACK << (c))
+
+struct pth_tcb_pool_st {
+    pth_t p_head;                   /* first pooled control block            */
+    int   p_num;                    /* number of pooled control blocks       */
+};
+static struct pth_tcb_pool_st pth_tcb_pool[PTH_TCB_POOL_CLASSES];
+static int pth_tcb_pool_lowat = 0;  /* level to trim to and to pre-warm to */
+static int pth_tcb_pool_hiwat = 32; /* level beyond which a class is trimmed */
+static pth_t pth_tcb_limbo = NULL;  /* freed, but still referenced blocks    */
+
+/*
+ * For stack profiling each thread stack is pre-filled with a byte
+ * pattern, so the maximum depth a thread ever reached can be measured
+ * by looking for the farthest overwritten byte. When threads terminate
+ * their depths are aggregated per thread name (in a small hash table
+ * of histograms with four buckets per octave) and, if requested, the
+ * depth at a certain percentile is used for sizing the stacks of
+ * further threads spawned under the same name.
+ */
+#define PTH_TCB_PROF_FILL       0x5a
+#define PTH_TCB_PROF_HASH       64
+#define PTH_TCB_PROF_BUCKETS    64
+#define PTH_TCB_PROF_MINSAMPLES 16
+#define PTH_TCB_PROF_MINSTACK   (16*1024)
+
+struct pth_tcb_prof_st {
+    struct pth_tcb_prof_st *p_next;            /* next entry in hash chain     */
+    char          p_name[PTH_TCB_NAMELEN];     /* name of threads              */
+    unsigned int  p_count;                     /* number of measured threads   */
+    unsigned int  p_max;                       /* maximum measured stack depth */
+    unsigned int  p_hist[PTH_TCB_PROF_BUCKETS];/* histogram of stack depths    */
+};
+static struct pth_tcb_prof_st *pth_tcb_prof[PTH_TCB_PROF_HASH];
+static int pth_tcb_prof_pct = -1; /* -1 = off, 0 = measure only, else percentile */
+
+/* determine size class of a stack (or -1 if not pooled) */
+static int pth_tcb_pool_class(unsigned int stacksize)
+{
+    int c;
+
+    for (c = 0; c < PTH_TCB_POOL_CLASSES; c++)
+        if (stacksize <= PTH_TCB_POOL_SIZE(c))
+            return c;
+    return -1;
+}
+
+/* determine the allocated size of a (non-loaned) stack */
+static unsigned int pth_tcb_stack_size(unsigned int stacksize)
+{
+    int c;
+
+    c = pth_tcb_pool_class(stacksize);
+    return (c >= 0 ? PTH_TCB_POOL_SIZE(c) : stacksize);
+}
+
+/* release pooled control blocks of a class until n are left */
+static void pth_tcb_pool_trim(int c, int n)
+{
+    pth_t t;
+
+    while (pth_tcb_pool[c].p_num > n) {
+        t = pth_tcb_pool[c].p_head;
+        pth_tcb_pool[c].p_head = t->q_next;
+        pth_tcb_pool[c].p_num--;
+        pth_tcb_stack_free(t->stack, PTH_TCB_POOL_SIZE(c));
+        free(t);
+    }
+    return;
+}
+
+/* fill the pool class of the default stack size up to the low watermark */
+intern void pth_tcb_pool_prewarm(void)
+{
+    pth_t t;
+    int c;
+
+    c = pth_tcb_pool_class(64*1024);
+    while (pth_tcb_pool[c].p_num < pth_tcb_pool_lowat) {
+        if ((t = (pth_t)malloc(sizeof(struct pth_st))) == NULL)
+            break;
+        if ((t->stack = pth_tcb_stack_alloc(PTH_TCB_POOL_SIZE(c))) == NULL) {
+            free(t);
+            break;
+        }
+        t->stackloan = FALSE;
+        t->q_next = pth_tcb_pool[c].p_head;
+        pth_tcb_pool[c].p_head = t;
+        pth_tcb_pool[c].p_num++;
+    }
+    return;
+}
+
+/* set the watermarks of the pool (returns the number
+   of pooled control blocks afterwards or -1 on error) */
+intern int pth_tcb_pool_ctrl(int lowat, int hiwat)
+{
+    int n;
+    int c;
+
+    if (lowat < 0 || hiwat < lowat)
+        return -1;
+    pth_tcb_pool_lowat = lowat;
+    pth_tcb_pool_hiwat = hiwat;
+    for (c = 0; c < PTH_TCB_POOL_CLASSES; c++)
+        if (pth_tcb_pool[c].p_num > hiwat)
+            pth_tcb_pool_trim(c, lowat);
+    pth_tcb_pool_prewarm();
+    n = 0;
+    for (c = 0; c < PTH_TCB_POOL_CLASSES; c++)
+        n += pth_tcb_pool[c].p_num;
+    return n;
+}
+
+/* release the whole pool (and the control blocks still referenced
+   by abandoned requests, which cannot be pending anymore) */
+intern void pth_tcb_pool_kill(void)
+{
+    pth_t t;
+    int c;
+
+    while ((t = pth_tcb_limbo) != NULL) {
+        pth_tcb_limbo = t->q_next;
+        t->stackrefs  = 0;
+        t->stacklimbo = FALSE;
+        pth_tcb_free(t);
+    }
+    for (c = 0; c < PTH_TCB_POOL_CLASSES; c++)
+        pth_tcb_pool_trim(c, 0);
+    return;
+}
+
 /* allocate a thread control block */
 intern pth_t pth_tcb_alloc(unsigned int stacksize, void *stackaddr)
 {
     pth_t t;
+    int c;
 
     if (stacksize > 0 && stacksize < SIGSTKSZ)
         stacksize = SIGSTKSZ;
-    if ((t = (pth_t)malloc(sizeof(struct pth_st))) == NULL)
-        return NULL;
-    t->stacksize  = stacksize;
-    t->stack      = NULL;
-    t->stackguard = NULL;
-    t->stackloan  = (stackaddr != NULL ? TRUE : FALSE);
-    if (stacksize > 0) { /* stacksize == 0 means "main" thread */
-        if (stackaddr != NULL)
-            t->stack = (char *)(stackaddr);
-        else {
-            if ((t->stack = (char *)malloc(stacksize)) == NULL) {
-                pth_shield { free(t); }
-                return NULL;
+    c = (stacksize > 0 && stackaddr == NULL ? pth_tcb_pool_class(stacksize) : -1);
+    if (c >= 0 && pth_tcb_pool[c].p_head != NULL) {
+        /* recycle a pooled control block together with its stack */
+        t = pth_tcb_pool[c].p_head;
+        pth_tcb_pool[c].p_head = t->q_next;
+        pth_tcb_pool[c].p_num--;
+    }
+    else {
+        if ((t = (pth_t)malloc(sizeof(struct pth_st))) == NULL)
+            return NULL;
+        t->stack     = NULL;
+        t->stackloan = (stackaddr != NULL ? TRUE : FALSE);
+        if (stacksize > 0) { /* stacksize == 0 means "main" thread */
+            if (stackaddr != NULL)
+                t->stack = (char *)(stackaddr);
+            else {
+                /* pooled stacks always get the full size of their class */
+                if ((t->stack = pth_tcb_stack_alloc(pth_tcb_stack_size(stacksize))) == NULL) {
+                    pth_shield { free(t); }
+                    return NULL;
+                }
             }
         }
+    }
+    t->q_next     = NULL;
+    t->q_queue    = NULL;
+    t->stacksize  = stacksize;
+    t->stacksp    = NULL;
+    t->stackguard = NULL;
+    if (stacksize > 0 && (t->stackloan || !PTH_TCB_MAPPED(pth_tcb_stack_size(stacksize)))) {
 #if PTH_STACKGROWTH < 0
         /* guard is at lowest address (alignment is guarrantied) */
         t->stackguard = (long *)((long)t->stack); /* double cast to avoid alignment warning */
@@ -128,23 +408,383 @@ intern pth_t pth_tcb_alloc(unsigned int stacksize, void *stackaddr)
         /* guard is at highest address (be careful with alignment) */
         t->stackguard = (long *)(t->stack+(((stacksize/sizeof(long))-1)*sizeof(long)));
 #endif
-        *t->stackguard = 0xDEAD;
     }
+    t->stackprof  = FALSE;
+    t->stackrefs  = 0;
+    t->stacklimbo = FALSE;
+    if (stacksize > 0 && pth_tcb_prof_pct >= 0) {
+        /* pre-fill the stack for measuring its depth later */
+        memset(t->stack, PTH_TCB_PROF_FILL, stacksize);
+        t->stackprof = TRUE;
+    }
+    if (t->stackguard != NULL)
+        *t->stackguard = 0xDEAD;
     return t;
 }
 
 /* free a thread control block */
 intern void pth_tcb_free(pth_t t)
 {
+    int c;
+
     if (t == NULL)
         return;
-    if (t->stack != NULL && !t->stackloan)
-        free(t->stack);
-    if (t->data_value != NULL)
+    if (pth_ring_elements(&t->waiters) > 0) {
+        /* the thread is gone, so its waiters cannot wait any longer */
+        t->state = PTH_STATE_DEAD;
+        pth_event_tidnotify(t);
+    }
+    if (t->data_value != NULL) {
         free(t->data_value);
+        t->data_value = NULL;
+    }
     if (t->cleanups != NULL)
         pth_cleanup_popall(t, FALSE);
+    if (t->stackrefs > 0) {
+        /* abandoned requests of the thread can still use its stack
+           (e.g. as I/O buffer), so keep it until they are reaped */
+        t->stacklimbo = TRUE;
+        t->q_next = pth_tcb_limbo;
+        pth_tcb_limbo = t;
+        return;
+    }
+    c = (t->stack != NULL && !t->stackloan ? pth_tcb_pool_class(t->stacksize) : -1);
+    if (c >= 0 && pth_tcb_pool_hiwat > 0) {
+        /* keep control block and stack for recycling (but
+           not the physical memory of lazily committed stacks) */
+        if (PTH_TCB_MAPPED(PTH_TCB_POOL_SIZE(c)) && PTH_TCB_POOL_SIZE(c) >= PTH_TCB_LAZYSTACK)
+            pth_tcb_stack_release(t->stack, t->stack + PTH_TCB_POOL_SIZE(c));
+        t->q_next = pth_tcb_pool[c].p_head;
+        pth_tcb_pool[c].p_head = t;
+        if (++pth_tcb_pool[c].p_num > pth_tcb_pool_hiwat)
+            pth_tcb_pool_trim(c, pth_tcb_pool_lowat);
+        return;
+    }
+    if (t->stack != NULL && !t->stackloan)
+        pth_tcb_stack_free(t->stack, pth_tcb_stack_size(t->stacksize));
     free(t);
     return;
 }
 
+/* let an abandoned request (of an aborted thread) reference the stack
+   of its thread, i.e., keep it until the request is reaped */
+intern void pth_tcb_stack_ref(pth_t t)
+{
+    t->stackrefs++;
+    return;
+}
+
+/* the same, but drop the reference again (and finally free the
+   control block, if it was freed meanwhile) */
+intern void pth_tcb_stack_unref(pth_t t)
+{
+    pth_t *tp;
+
+    if (--t->stackrefs > 0 || !t->stacklimbo)
+        return;
+    for (tp = &pth_tcb_limbo; *tp != t; tp = &((*tp)->q_next))
+        ;
+    *tp = t->q_next;
+    t->stacklimbo = FALSE;
+    pth_tcb_free(t);
+    return;
+}
+
+/* release the physical memory of the unused part of the stack of a
+   thread which gave up the CPU (and keep some slack for the frames
+   below the recorded stack position), returning the bytes released */
+intern size_t pth_tcb_stack_trim(pth_t t)
+{
+    unsigned int size;
+    char *lo, *hi;
+
+    if (t->stack == NULL || t->stackloan || t->stacksp == NULL || t->stackprof)
+        return 0;
+    size = pth_tcb_stack_size(t->stacksize);
+    if (!PTH_TCB_MAPPED(size))
+        return 0;
+#if PTH_STACKGROWTH < 0
+    lo = t->stack;
+    hi = (char *)((unsigned long)(t->stacksp - PTH_TCB_STACKSLACK) & ~(pth_tcb_pagesize - 1));
+#else
+    lo = (char *)PTH_TCB_PAGEALIGN((unsigned long)(t->stacksp + PTH_TCB_STACKSLACK));
+    hi = t->stack + PTH_TCB_PAGEALIGN(size);
+#endif
+    if (!pth_tcb_stack_release(lo, hi))
+        return 0;
+    return (size_t)(hi - lo);
+}
+
+/* determine the histogram bucket of a stack depth */
+static int pth_tcb_prof_bucket(unsigned int depth)
+{
+    int k, b;
+
+    if (depth < 1024)
+        return 0;
+    for (k = 10; (depth >> (k+1)) != 0; k++)
+        ;
+    b = (k-10)*4 + (int)((depth >> (k-2)) & 3) + 1;
+    return (b < PTH_TCB_PROF_BUCKETS ? b : PTH_TCB_PROF_BUCKETS-1);
+}
+
+/* determine the upper bound of the stack depths of a histogram bucket */
+static unsigned int pth_tcb_prof_bound(int b)
+{
+    if (b == 0)
+        return 1024;
+    return (unsigned int)(4 + ((b-1) & 3) + 1) << ((b-1)/4 + 8);
+}
+
+/* find (and optionally create) the profile entry of a thread name */
+static struct pth_tcb_prof_st *pth_tcb_prof_lookup(const char *name, int create)
+{
+    struct pth_tcb_prof_st *p;
+    unsigned int h;
+    const char *cp;
+
+    h = 0;
+    for (cp = name; *cp != NUL; cp++)
+        h = (h * 31) + (unsigned char)(*cp);
+    h %= PTH_TCB_PROF_HASH;
+    for (p = pth_tcb_prof[h]; p != NULL; p = p->p_next)
+        if (strcmp(p->p_name, name) == 0)
+            return p;
+    if (!create)
+        return NULL;
+    if ((p = (struct pth_tcb_prof_st *)calloc(1, sizeof(struct pth_tcb_prof_st))) == NULL)
+        return NULL;
+    pth_util_cpystrn(p->p_name, name, PTH_TCB_NAMELEN);
+    p->p_next = pth_tcb_prof[h];
+    pth_tcb_prof[h] = p;
+    return p;
+}
+
+/* switch stack profiling off (-1), on (0) or on with automatic
+   sizing of stacks to a percentile of the profile (1...100) */
+intern int pth_tcb_prof_ctrl(int pct)
+{
+    if (pct < -1 || pct > 100)
+        return FALSE;
+    pth_tcb_prof_pct = pct;
+    return TRUE;
+}
+
+/* measure the maximum depth a (pre-filled) stack reached so far */
+intern unsigned int pth_tcb_stack_used(pth_t t)
+{
+    long fill;
+    long *wp, *we;
+    char *cp;
+
+    if (t->stack == NULL || !t->stackprof)
+        return 0;
+    memset(&fill, PTH_TCB_PROF_FILL, sizeof(fill));
+#if PTH_STACKGROWTH < 0
+    wp = (long *)((long)t->stack);
+    we = wp + (t->stacksize / sizeof(long));
+    if (t->stackguard != NULL)
+        wp++;
+    while (wp < we && *wp == fill)
+        wp++;
+    for (cp = (char *)wp; cp < (char *)we && *cp == PTH_TCB_PROF_FILL; cp++)
+        ;
+    return t->stacksize - (unsigned int)(cp - t->stack);
+#else
+    wp = (long *)((long)t->stack);
+    we = wp + (t->stacksize / sizeof(long));
+    if (t->stackguard != NULL)
+        we--;
+    while (we > wp && *(we-1) == fill)
+        we--;
+    for (cp = (char *)we; cp > (char *)wp && *(cp-1) == PTH_TCB_PROF_FILL; cp--)
+        ;
+    return (unsigned int)(cp - t->stack);
+#endif
+}
+
+/* record the stack depth of a terminating thread in the profile */
+intern void pth_tcb_stack_record(pth_t t)
+{
+    struct pth_tcb_prof_st *p;
+    unsigned int depth;
+
+    if (!t->stackprof)
+        return;
+    depth = pth_tcb_stack_used(t);
+    if ((p = pth_tcb_prof_lookup(t->name, TRUE)) == NULL)
+        return;
+    p->p_count++;
+    if (p->p_max < depth)
+        p->p_max = depth;
+    p->p_hist[pth_tcb_prof_bucket(depth)]++;
+    return;
+}
+
+/* determine the maximum recorded stack depth of threads of a name */
+intern unsigned int pth_tcb_prof_max(const char *name)
+{
+    struct pth_tcb_prof_st *p;
+
+    if ((p = pth_tcb_prof_lookup(name, FALSE)) == NULL)
+        return 0;
+    return p->p_max;
+}
+
+/* advise the stack size for a new thread of a name: twice the
+   profiled depth at the configured percentile, but never more than
+   requested (and only once enough threads have been measured) */
+intern unsigned int pth_tcb_stack_advise(const char *name, unsigned int stacksize)
+{
+    struct pth_tcb_prof_st *p;
+    unsigned int need, sum, depth;
+    int b;
+
+    if (pth_tcb_prof_pct <= 0 || stacksize == 0)
+        return stacksize;
+    if ((p = pth_tcb_prof_lookup(name, FALSE)) == NULL)
+        return stacksize;
+    if (p->p_count < PTH_TCB_PROF_MINSAMPLES)
+        return stacksize;
+    need = (p->p_count * (unsigned int)pth_tcb_prof_pct + 99) / 100;
+    sum = 0;
+    for (b = 0; b < PTH_TCB_PROF_BUCKETS-1; b++)
+        if ((sum += p->p_hist[b]) >= need)
+            break;
+    depth = pth_tcb_prof_bound(b);
+    if (depth > p->p_max)
+        depth = p->p_max;
+    depth *= 2;
+    if (depth < PTH_TCB_PROF_MINSTACK)
+        depth = PTH_TCB_PROF_MINSTACK;
+    return (depth < stacksize ? depth : stacksize);
+}
+
+/* dump the stack profile */
+intern void pth_tcb_prof_dump(FILE *fp)
+{
+    struct pth_tcb_prof_st *p;
+    int h;
+
+    if (pth_tcb_prof_pct < 0)
+        return;
+    fprintf(fp, "| Stack Profile:\n");
+    for (h = 0; h < PTH_TCB_PROF_HASH; h++)
+        for (p = pth_tcb_prof[h]; p != NULL; p = p->p_next)
+            fprintf(fp, "|   \"%s\": %u threads, max %u bytes, advised %u bytes\n",
+                    p->p_name, p->p_count, p->p_max,
+                    pth_tcb_stack_advise(p->p_name, 64*1024));
+    return;
+}
+
+/* release the stack profile */
+intern void pth_tcb_prof_kill(void)
+{
+    struct pth_tcb_prof_st *p;
+    int h;
+
+    for (h = 0; h < PTH_TCB_PROF_HASH; h++) {
+        while ((p = pth_tcb_prof[h]) != NULL) {
+            pth_tcb_prof[h] = p->p_next;
+            free(p);
+        }
+    }
+    pth_tcb_prof_pct = -1;
+    return;
+}
+
+#ifdef PTH_GUARDPAGES
+static struct sigaction pth_tcb_guard_osa;
+static char *pth_tcb_guard_altstack = NULL;
+
+/* report a thread stack overflow and pass on the fault */
+static void pth_tcb_guard_handler(int sig, siginfo_t *si, void *uc)
+{
+    char msg[128];
+    char *guard;
+    char *addr;
+    pth_t t;
+
+    t = (pth_initialized ? pth_current : NULL);
+    if (t != NULL && t->stack != NULL && !t->stackloan) {
+#if PTH_STACKGROWTH < 0
+        guard = t->stack - pth_tcb_pagesize;
+#else
+        guard = t->stack + PTH_TCB_PAGEALIGN(pth_tcb_stack_size(t->stacksize));
+#endif
+        addr = (char *)si->si_addr;
+        if (addr >= guard && addr < guard + pth_tcb_pagesize) {
+            pth_snprintf(msg, sizeof(msg), "**Pth** STACK OVERFLOW: thread pid_t=0x%lx, name=\"%s\"\n",
+                         (unsigned long)t, t->name);
+            write(STDERR_FILENO, msg, strlen(msg));
+        }
+    }
+
+    /* let the previous handler deal with the fault, or re-fault
+       with the default action after returning from the handler */
+    if (pth_tcb_guard_osa.sa_flags & SA_SIGINFO)
+        pth_tcb_guard_osa.sa_sigaction(sig, si, uc);
+    else if (   pth_tcb_guard_osa.sa_handler == SIG_DFL
+             || pth_tcb_guard_osa.sa_handler == SIG_IGN)
+        signal(SIGSEGV, SIG_DFL);
+    else
+        pth_tcb_guard_osa.sa_handler(sig);
+    return;
+}
+#endif
+
+/* install the reporting of stack overflows */
+intern void pth_tcb_guard_init(void)
+{
+#ifdef PTH_GUARDPAGES
+    struct sigaction sa;
+    stack_t ss;
+
+    /* the handler cannot run on the overflowed stack itself */
+    if (pth_tcb_guard_altstack == NULL) {
+        if ((pth_tcb_guard_altstack = (char *)malloc(PTH_TCB_ALTSTACK)) == NULL)
+            return;
+        ss.ss_sp    = pth_tcb_guard_altstack;
+        ss.ss_size  = PTH_TCB_ALTSTACK;
+        ss.ss_flags = 0;
+        if (sigaltstack(&ss, NULL) == -1) {
+            free(pth_tcb_guard_altstack);
+            pth_tcb_guard_altstack = NULL;
+            return;
+        }
+    }
+
+    /* install the handler once per process */
+    if (sigaction(SIGSEGV, NULL, &sa) == 0 && sa.sa_sigaction != pth_tcb_guard_handler) {
+        pth_tcb_guard_osa = sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_sigaction = pth_tcb_guard_handler;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = SA_SIGINFO|SA_ONSTACK;
+        sigaction(SIGSEGV, &sa, NULL);
+    }
+#endif
+    return;
+}
+
+/* remove the reporting of stack overflows */
+intern void pth_tcb_guard_kill(void)
+{
+#ifdef PTH_GUARDPAGES
+    struct sigaction sa;
+    stack_t ss;
+
+    /* restore the previous handler (unless replaced by the application) */
+    if (sigaction(SIGSEGV, NULL, &sa) == 0 && sa.sa_sigaction == pth_tcb_guard_handler)
+        sigaction(SIGSEGV, &pth_tcb_guard_osa, NULL);
+    if (pth_tcb_guard_altstack != NULL) {
+        memset(&ss, 0, sizeof(ss));
+        ss.ss_flags = SS_DISABLE;
+        sigaltstack(&ss, NULL);
+        free(pth_tcb_guard_altstack);
+        pth_tcb_guard_altstack = NULL;
+    }
+#endif
+    return;
+}
+
@@ -0,0 +1,184 @@
+/*
+**  GNU Pth - The GNU Portable Threads
+**  Copyright (c) 1999-2006 Ralf S. Engelschall <rse@engelschall.com>
+**
+**  This file is part of GNU Pth, a non-preemptive thread scheduling
+**  library which can be found at http://www.gnu.org/software/pth/.
+**
+**  This library is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU Lesser General Public
+**  License as published by the Free Software Foundation; either
+**  version 2.1 of the License, or (at your option) any later version.
+**
+**  This library is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**  Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public
+**  License along with this library; if not, write to the Free Software
+**  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+**  USA, or contact Ralf S. Engelschall <rse@engelschall.com>.
+**
+**  pth_timer.c: Pth timer index
+*/
+                             /* ``Time is an illusion.
+                                  Lunchtime doubly so.''
+                                       -- Douglas Adams */
+
+/*
+ * This is the timer index of the scheduler. All armed events with a
+ * deadline (the timeouts of PTH_EVENT_TIME and the recheck intervals of
+ * PTH_EVENT_FUNC) are kept in a binary min-heap ordered by deadline.
+ * So the event manager finds the next timer in O(1) and arming or
+ * disarming an event costs O(log n), instead of scanning all events of
+ * all waiting threads on every scheduler pass. Each event remembers its
+ * position in the heap, so it can be removed without searching for it.
+ */
+
+#include "pth_p.h"
+
+static pth_event_t *pth_timer_heap = NULL; /* the heap of timer events      */
+static int          pth_timer_num  = 0;    /* number of events in heap      */
+static int          pth_timer_size = 0;    /* number of allocated slots     */
+
+/* initialize the timer index */
+intern void pth_timer_init(void)
+{
+    pth_timer_heap = NULL;
+    pth_timer_num  = 0;
+    pth_timer_size = 0;
+    return;
+}
+
+/* kill the timer index */
+intern void pth_timer_kill(void)
+{
+    int i;
+
+    for (i = 0; i < pth_timer_num; i++)
+        pth_timer_heap[i]->ev_heapidx = -1;
+    if (pth_timer_heap != NULL)
+        free(pth_timer_heap);
+    pth_timer_heap = NULL;
+    pth_timer_num  = 0;
+    pth_timer_size = 0;
+    return;
+}
+
+/* put an event into a slot of the heap */
+#define pth_timer_place(ev,i) \
+    do { \
+        pth_timer_heap[(i)] = (ev); \
+        (ev)->ev_heapidx = (i); \
+    } while (0)
+
+/* move an event towards the root of the heap until it fits */
+static void pth_timer_siftup(int i)
+{
+    pth_event_t ev;
+    int parent;
+
+    ev = pth_timer_heap[i];
+    while (i > 0) {
+        parent = (i - 1) / 2;
+        if (pth_time_cmp(&(pth_timer_heap[parent]->ev_due), &(ev->ev_due)) <= 0)
+            break;
+        pth_timer_place(pth_timer_heap[parent], i);
+        i = parent;
+    }
+    pth_timer_place(ev, i);
+    return;
+}
+
+/* move an event towards the leaves of the heap until it fits */
+static void pth_timer_siftdown(int i)
+{
+    pth_event_t ev;
+    int child;
+
+    ev = pth_timer_heap[i];
+    for (;;) {
+        child = 2 * i + 1;
+        if (child >= pth_timer_num)
+            break;
+        if (   child + 1 < pth_timer_num
+            && pth_time_cmp(&(pth_timer_heap[child+1]->ev_due),
+                            &(pth_timer_heap[child]->ev_due)) < 0)
+            child++;
+        if (pth_time_cmp(&(ev->ev_due), &(pth_timer_heap[child]->ev_due)) <= 0)
+            break;
+        pth_timer_place(pth_timer_heap[child], i);
+        i = child;
+    }
+    pth_timer_place(ev, i);
+    return;
+}
+
+/* insert an event (with its deadline in ev_due) into the timer index */
+intern int pth_timer_insert(pth_event_t ev)
+{
+    pth_event_t *heap;
+    int size;
+
+    if (ev->ev_heapidx != -1)
+        return pth_error(FALSE, EINVAL);
+    if (pth_timer_num == pth_timer_size) {
+        size = (pth_timer_size > 0 ? pth_timer_size * 2 : 64);
+        if ((heap = (pth_event_t *)realloc(pth_timer_heap, size*sizeof(pth_event_t))) == NULL)
+            return pth_error(FALSE, ENOMEM);
+        pth_timer_heap = heap;
+        pth_timer_size = size;
+    }
+    pth_timer_place(ev, pth_timer_num);
+    pth_timer_num++;
+    pth_timer_siftup(ev->ev_heapidx);
+    return TRUE;
+}
+
+/* remove an event from the timer index */
+intern void pth_timer_delete(pth_event_t ev)
+{
+    int i;
+
+    if ((i = ev->ev_heapidx) == -1)
+        return;
+    ev->ev_heapidx = -1;
+    pth_timer_num--;
+    if (i == pth_timer_num)
+        return;
+    /* fill the gap with the last event and restore the heap order */
+    pth_timer_place(pth_timer_heap[pth_timer_num], i);
+    if (i > 0 && pth_time_cmp(&(pth_timer_heap[(i-1)/2]->ev_due),
+                              &(pth_timer_heap[i]->ev_due)) > 0)
+        pth_timer_siftup(i);
+    else
+        pth_timer_siftdown(i);
+    return;
+}
+
+/* move an event in the timer index to a new deadline */
+intern void pth_timer_update(pth_event_t ev, pth_time_t *due)
+{
+    pth_time_set(&(ev->ev_due), due);
+    if (ev->ev_heapidx == -1)
+        return;
+    pth_timer_siftup(ev->ev_heapidx);
+    pth_timer_siftdown(ev->ev_heapidx);
+    return;
+}
+
+/* return the event which is due next (or NULL) */
+intern pth_event_t pth_timer_next(void)
+{
+    if (pth_timer_num == 0)
+        return NULL;
+    return pth_timer_heap[0];
+}
+
+/* return the number of events in the timer index */
+intern int pth_timer_elements(void)
+{
+    return pth_timer_num;
+}
+
@@ -146,8 +146,13 @@ pth_uctx_make(
     pth_uctx_trampoline_ctx.start_arg   = start_arg;
 
     /* optionally establish temporary signal mask */
-    if (sigmask != NULL)
+    if (sigmask != NULL) {
         sigprocmask(SIG_SETMASK, sigmask, &ss);
+#if PTH_MCTX_MTH(mcsc)
+        /* (setcontext(2) enters the trampoline with the mask of the context) */
+        memcpy(&uctx->uc_mctx.uc.uc_sigmask, sigmask, sizeof(sigset_t));
+#endif
+    }
 
     /* perform the trampoline step */
     pth_mctx_switch(&mctx_parent, &(uctx->uc_mctx));
@@ -156,6 +161,15 @@ pth_uctx_make(
     if (sigmask != NULL)
         sigprocmask(SIG_SETMASK, &ss, NULL);
 
+#if PTH_MCTX_MTH(asm)
+    /* the assembly switching does not save the signal
+       mask, so let the context explicitly own it */
+    if (sigmask != NULL) {
+        memcpy(&uctx->uc_mctx.sigs, sigmask, sizeof(sigset_t));
+        uctx->uc_mctx.sigsown = TRUE;
+    }
+#endif
+
     /* finally flag that the context is now configured */
     uctx->uc_mctx_set = TRUE;
 
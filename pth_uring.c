@@ -0,0 +1,442 @@
+/*
+**  GNU Pth - The GNU Portable Threads
+**  Copyright (c) 1999-2006 Ralf S. Engelschall <rse@engelschall.com>
+**
+**  This file is part of GNU Pth, a non-preemptive thread scheduling
+**  library which can be found at http://www.gnu.org/software/pth/.
+**
+**  This library is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU Lesser General Public
+**  License as published by the Free Software Foundation; either
+**  version 2.1 of the License, or (at your option) any later version.
+**
+**  This library is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**  Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public
+**  License along with this library; if not, write to the Free Software
+**  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+**  USA, or contact Ralf S. Engelschall <rse@engelschall.com>.
+**
+**  pth_uring.c: Pth I/O completion through io_uring
+*/
+                             /* ``It is not enough to be busy;
+                                  so are the ants. The question is:
+                                  What are we busy about?''
+                                    -- Henry David Thoreau */
+
+/*
+ * Instead of waiting for the readiness of a filedescriptor and then
+ * performing the I/O operation itself, a thread can let the kernel
+ * perform the whole operation through io_uring(7) and just wait for
+ * its completion. The submissions of all threads are only queued in
+ * the submission ring and are passed to the kernel at once by the
+ * event manager right before it polls (i.e., one io_uring_enter(2) per
+ * scheduler loop), and the completions are reaped right after the
+ * polling (the ring filedescriptor is permanently watched by the I/O
+ * multiplexer, so a pending completion wakes up the scheduler).
+ *
+ * The ring is set up lazily on first use. If the kernel does not
+ * support io_uring(7) (or a particular operation) or the rings are
+ * exhausted, the callers just fall back to the readiness based I/O.
+ */
+
+#include "pth_p.h"
+
+#ifdef PTH_URING
+
+#define PTH_URING_ENTRIES 256        /* number of submission ring entries */
+#define PTH_URING_MAXOP   64         /* number of operations probed for   */
+#define PTH_URING_MAXLEN  0x7ffff000 /* maximum transfer (as for read(2)) */
+
+/* the record of an outstanding request */
+typedef struct {
+    pth_ringnode_t node;   /* ring linkage (has to be first!)               */
+    pth_t          thread; /* thread waiting for completion (NULL: aborted) */
+    pth_t          orphan; /* aborted thread whose stack is still in use    */
+    int            done;   /* whether the request was completed             */
+    int            res;    /* result of the request (or negated errno)      */
+} pth_uring_req_t;
+
+static int                  pth_uring_state    = 0;  /* 0: untried, 1: usable, -1: unusable */
+static int                  pth_uring_fd       = -1; /* filedescriptor of the ring         */
+static unsigned long long   pth_uring_ops      = 0;  /* mask of the supported operations   */
+static void                *pth_uring_rings    = NULL; /* mapped submission/completion rings */
+static size_t               pth_uring_ringsize = 0;
+static struct io_uring_sqe *pth_uring_sqes     = NULL; /* mapped submission entries         */
+static size_t               pth_uring_sqesize  = 0;
+static unsigned            *pth_uring_sqhead;
+static unsigned            *pth_uring_sqtail;
+static unsigned             pth_uring_sqmask;
+static unsigned            *pth_uring_sqarray;
+static unsigned             pth_uring_sqentries;
+static unsigned            *pth_uring_cqhead;
+static unsigned            *pth_uring_cqtail;
+static unsigned             pth_uring_cqmask;
+static struct io_uring_cqe *pth_uring_cqes;
+static unsigned             pth_uring_cqentries;
+static unsigned             pth_uring_pending  = 0;  /* entries queued but not yet submitted */
+static unsigned             pth_uring_inflight = 0;  /* entries queued but not yet completed */
+static pth_ring_t           pth_uring_reqs;          /* outstanding requests                 */
+static pth_ring_t           pth_uring_free;          /* recycled request records             */
+
+/* initialize the ring (it is set up lazily) */
+intern void pth_uring_init(void)
+{
+    pth_uring_state    = 0;
+    pth_uring_fd       = -1;
+    pth_uring_pending  = 0;
+    pth_uring_inflight = 0;
+    pth_ring_init(&pth_uring_reqs);
+    pth_ring_init(&pth_uring_free);
+    return;
+}
+
+/* release the mappings and the filedescriptor of the ring */
+static void pth_uring_close(void)
+{
+    if (pth_uring_sqes != NULL)
+        munmap((void *)pth_uring_sqes, pth_uring_sqesize);
+    if (pth_uring_rings != NULL)
+        munmap(pth_uring_rings, pth_uring_ringsize);
+    if (pth_uring_fd != -1)
+        close(pth_uring_fd);
+    pth_uring_sqes  = NULL;
+    pth_uring_rings = NULL;
+    pth_uring_fd    = -1;
+    return;
+}
+
+/* set up the ring and determine the supported operations */
+static int pth_uring_open(void)
+{
+    struct io_uring_params p;
+    struct io_uring_probe *probe;
+    size_t cqsize;
+    char *rings;
+    int i;
+
+    memset(&p, 0, sizeof(p));
+    if ((pth_uring_fd = (int)syscall(__NR_io_uring_setup, PTH_URING_ENTRIES, &p)) < 0) {
+        pth_uring_fd = -1;
+        return FALSE;
+    }
+    fcntl(pth_uring_fd, F_SETFD, FD_CLOEXEC);
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP))
+        return FALSE;
+
+    /* map the rings (both share a single mapping) and the entries */
+    pth_uring_ringsize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqsize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (cqsize > pth_uring_ringsize)
+        pth_uring_ringsize = cqsize;
+    rings = (char *)mmap(NULL, pth_uring_ringsize, PROT_READ|PROT_WRITE,
+                         MAP_SHARED|MAP_POPULATE, pth_uring_fd, IORING_OFF_SQ_RING);
+    if (rings == (char *)MAP_FAILED)
+        return FALSE;
+    pth_uring_rings = rings;
+    pth_uring_sqesize = p.sq_entries * sizeof(struct io_uring_sqe);
+    pth_uring_sqes = (struct io_uring_sqe *)mmap(NULL, pth_uring_sqesize, PROT_READ|PROT_WRITE,
+                                                 MAP_SHARED|MAP_POPULATE, pth_uring_fd, IORING_OFF_SQES);
+    if (pth_uring_sqes == (struct io_uring_sqe *)MAP_FAILED) {
+        pth_uring_sqes = NULL;
+        return FALSE;
+    }
+    pth_uring_sqhead     = (unsigned *)(rings + p.sq_off.head);
+    pth_uring_sqtail     = (unsigned *)(rings + p.sq_off.tail);
+    pth_uring_sqmask     = *(unsigned *)(rings + p.sq_off.ring_mask);
+    pth_uring_sqarray    = (unsigned *)(rings + p.sq_off.array);
+    pth_uring_sqentries  = p.sq_entries;
+    pth_uring_cqhead     = (unsigned *)(rings + p.cq_off.head);
+    pth_uring_cqtail     = (unsigned *)(rings + p.cq_off.tail);
+    pth_uring_cqmask     = *(unsigned *)(rings + p.cq_off.ring_mask);
+    pth_uring_cqes       = (struct io_uring_cqe *)(rings + p.cq_off.cqes);
+    pth_uring_cqentries  = p.cq_entries;
+
+    /* determine the supported operations */
+    i = sizeof(struct io_uring_probe) + PTH_URING_MAXOP * sizeof(struct io_uring_probe_op);
+    if ((probe = (struct io_uring_probe *)malloc(i)) == NULL)
+        return FALSE;
+    memset(probe, 0, i);
+    if (syscall(__NR_io_uring_register, pth_uring_fd, IORING_REGISTER_PROBE,
+                probe, PTH_URING_MAXOP) < 0) {
+        free(probe);
+        return FALSE;
+    }
+    pth_uring_ops = 0;
+    for (i = 0; i < probe->ops_len && i < PTH_URING_MAXOP; i++)
+        if (probe->ops[i].flags & IO_URING_OP_SUPPORTED)
+            pth_uring_ops |= (1ULL << probe->ops[i].op);
+    free(probe);
+
+    /* requests have to be cancelable and read(2)/write(2)
+       like operations have to use the current file position */
+    if (!(pth_uring_ops & (1ULL << IORING_OP_ASYNC_CANCEL)))
+        return FALSE;
+    if (!(p.features & IORING_FEAT_RW_CUR_POS))
+        pth_uring_ops &= ~(  (1ULL << IORING_OP_READ)  | (1ULL << IORING_OP_READV)
+                           | (1ULL << IORING_OP_WRITE) | (1ULL << IORING_OP_WRITEV));
+
+    /* let the I/O multiplexer wake up the scheduler on completions */
+    return pth_iomux_watch(pth_uring_fd, PTH_UNTIL_FD_READABLE);
+}
+
+/* kill the ring (all threads have to be dropped already) */
+intern void pth_uring_kill(void)
+{
+    pth_uring_req_t *req;
+
+    pth_uring_close();
+    while ((req = (pth_uring_req_t *)pth_ring_pop(&pth_uring_reqs)) != NULL)
+        free(req);
+    while ((req = (pth_uring_req_t *)pth_ring_pop(&pth_uring_free)) != NULL)
+        free(req);
+    pth_uring_init();
+    return;
+}
+
+/* forget the ring in a forked child (which shares it with the parent,
+   but whose outstanding requests belong to the parent only), so the
+   child sets up its own ring on demand (has to be called before
+   pth_iomux_atfork() re-registers the watched filedescriptors) */
+intern void pth_uring_atfork(void)
+{
+    pth_uring_req_t *req;
+
+    if (pth_uring_fd != -1)
+        pth_iomux_watch(pth_uring_fd, 0);
+    pth_uring_close();
+    while ((req = (pth_uring_req_t *)pth_ring_pop(&pth_uring_reqs)) != NULL) {
+        if (req->orphan != NULL) {
+            pth_tcb_stack_unref(req->orphan);
+            req->orphan = NULL;
+        }
+        pth_ring_append(&pth_uring_free, &(req->node));
+    }
+    pth_uring_state    = 0;
+    pth_uring_pending  = 0;
+    pth_uring_inflight = 0;
+    return;
+}
+
+/* return the name of the completion backend in use */
+intern const char *pth_uring_name(void)
+{
+    if (pth_uring_state > 0)
+        return "io_uring";
+    if (pth_uring_state < 0)
+        return "none (io_uring unusable)";
+    return "none (io_uring not yet used)";
+}
+
+/* pass the queued submissions to the kernel */
+intern void pth_uring_flush(void)
+{
+    int n;
+
+    while (pth_uring_pending > 0) {
+        n = (int)syscall(__NR_io_uring_enter, pth_uring_fd, pth_uring_pending, 0, 0, NULL, 0);
+        if (n < 0) {
+            /* EINTR: just retry, EAGAIN/EBUSY: retry on next loop */
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        pth_uring_pending -= n;
+        if (n == 0)
+            break;
+    }
+    return;
+}
+
+/* check whether an operation can be performed through the ring
+   (besides itself there has to be room for cancelling it) */
+intern int pth_uring_usable(int op)
+{
+    if (pth_uring_state == 0) {
+        if (pth_uring_open())
+            pth_uring_state = 1;
+        else {
+            pth_uring_close();
+            pth_uring_state = -1;
+        }
+    }
+    if (pth_uring_state < 0 || !(pth_uring_ops & (1ULL << op)))
+        return FALSE;
+    if (pth_uring_pending + 2 > pth_uring_sqentries)
+        pth_uring_flush();
+    return (   pth_uring_pending + 2 <= pth_uring_sqentries
+            && pth_uring_inflight + 2 <= pth_uring_cqentries);
+}
+
+/* queue a submission entry */
+static struct io_uring_sqe *pth_uring_sqe(int op, int fd, unsigned long long data)
+{
+    struct io_uring_sqe *sqe;
+    unsigned tail;
+
+    if (pth_uring_pending >= pth_uring_sqentries)
+        pth_uring_flush();
+    if (pth_uring_pending >= pth_uring_sqentries)
+        return NULL;
+    tail = *pth_uring_sqtail;
+    sqe = &pth_uring_sqes[tail & pth_uring_sqmask];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->opcode    = (unsigned char)op;
+    sqe->fd        = fd;
+    sqe->user_data = data;
+    pth_uring_sqarray[tail & pth_uring_sqmask] = tail & pth_uring_sqmask;
+    __atomic_store_n(pth_uring_sqtail, tail + 1, __ATOMIC_RELEASE);
+    pth_uring_pending++;
+    pth_uring_inflight++;
+    return sqe;
+}
+
+/* queue the cancellation of a request (its completion is ignored) */
+static int pth_uring_cancel(pth_uring_req_t *req)
+{
+    struct io_uring_sqe *sqe;
+
+    if ((sqe = pth_uring_sqe(IORING_OP_ASYNC_CANCEL, -1, 0)) == NULL)
+        return FALSE;
+    sqe->addr = (unsigned long long)(unsigned long)req;
+    return TRUE;
+}
+
+/* reap the completions and wake up the threads waiting for them */
+intern void pth_uring_dispatch(void)
+{
+    struct io_uring_cqe *cqe;
+    pth_uring_req_t *req;
+    unsigned head;
+    unsigned tail;
+    pth_t t;
+
+    if (pth_uring_state <= 0 || pth_uring_inflight == 0)
+        return;
+    head = *pth_uring_cqhead;
+    tail = __atomic_load_n(pth_uring_cqtail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        cqe = &pth_uring_cqes[head & pth_uring_cqmask];
+        pth_uring_inflight--;
+        if ((req = (pth_uring_req_t *)(unsigned long)cqe->user_data) != NULL) {
+            pth_ring_delete(&pth_uring_reqs, &(req->node));
+            if ((t = req->thread) == NULL) {
+                /* the thread was aborted meanwhile */
+                pth_tcb_stack_unref(req->orphan);
+                req->orphan = NULL;
+                pth_ring_append(&pth_uring_free, &(req->node));
+            }
+            else {
+                req->res  = cqe->res;
+                req->done = TRUE;
+                if (t->state == PTH_STATE_WAITING && pth_pqueue_contains(&pth_WQ, t))
+                    pth_sched_wakeup(t);
+            }
+        }
+        head++;
+    }
+    __atomic_store_n(pth_uring_cqhead, head, __ATOMIC_RELEASE);
+    return;
+}
+
+/* abandon the outstanding requests of a terminating thread (they are
+   cancelled, but the kernel can still use the buffers of the thread,
+   which may be on its stack, until their completions are reaped, so
+   the stack is kept until then) */
+intern void pth_uring_abandon(pth_t t)
+{
+    pth_uring_req_t *req;
+    int n;
+
+    n = 0;
+    for (req = (pth_uring_req_t *)pth_ring_first(&pth_uring_reqs); req != NULL;
+         req = (pth_uring_req_t *)pth_ring_next(&pth_uring_reqs, &(req->node))) {
+        if (req->thread == t) {
+            req->thread = NULL;
+            req->orphan = t;
+            pth_tcb_stack_ref(t);
+            pth_uring_cancel(req);
+            n++;
+        }
+    }
+    if (n > 0)
+        pth_uring_flush();
+    return;
+}
+
+/*
+ * Perform an I/O operation through the ring and wait for its completion.
+ * Returns FALSE (without doing anything) if the operation cannot be
+ * performed through the ring, so the caller has to fall back to the
+ * readiness based I/O. Else the result is stored into *rv (-1 and errno
+ * on errors, EINTR if one of the extra events occurred first). The
+ * request is in flight while waiting, so cancellation is deferred: an
+ * occurred extra event or cancellation request cancels the request and
+ * waits for its (possibly still successful) completion.
+ */
+intern int pth_uring_io(ssize_t *rv, int op, int fd, void *addr, size_t len,
+                        unsigned long long off, unsigned int flags, pth_event_t ev_extra)
+{
+    pth_uring_req_t *req;
+    struct io_uring_sqe *sqe;
+    pth_event_t ev;
+    int cancelstate;
+    int cancelled;
+    int res;
+
+    /* a filedescriptor kept in non-blocking mode would let the
+       kernel fail the operation instead of waiting for readiness */
+    if (!pth_uring_usable(op) || pth_fdmode_kept(fd))
+        return FALSE;
+    if ((req = (pth_uring_req_t *)pth_ring_pop(&pth_uring_free)) == NULL)
+        if ((req = (pth_uring_req_t *)malloc(sizeof(pth_uring_req_t))) == NULL)
+            return FALSE;
+    req->thread = pth_current;
+    req->orphan = NULL;
+    req->done   = FALSE;
+    req->res    = 0;
+    sqe = pth_uring_sqe(op, fd, (unsigned long long)(unsigned long)req);
+    sqe->addr     = (unsigned long long)(unsigned long)addr;
+    sqe->len      = (unsigned int)pth_util_min(len, PTH_URING_MAXLEN);
+    sqe->off      = off;
+    sqe->rw_flags = flags;
+    pth_ring_append(&pth_uring_reqs, &(req->node));
+
+    /* wait for the completion */
+    pth_cancel_state(PTH_CANCEL_DISABLE, &cancelstate);
+    cancelled = FALSE;
+    ev = ev_extra;
+    while (!req->done) {
+        if (   !pth_wait_wakeup(ev)
+            && !(pth_current->cancelreq && (cancelstate & PTH_CANCEL_ENABLE)))
+            continue;
+        if (req->done || cancelled)
+            continue;
+        if (!pth_uring_cancel(req)) {
+            /* no room in the submission ring, so retry next time */
+            pth_yield(NULL);
+            continue;
+        }
+        cancelled = TRUE;
+        ev = NULL;
+    }
+    res = req->res;
+    pth_ring_append(&pth_uring_free, &(req->node));
+    pth_cancel_state(cancelstate, NULL);
+    pth_cancel_point();
+
+    /* pass the result to the caller */
+    if (res == -ECANCELED)
+        res = -EINTR;
+    if (res < 0)
+        *rv = pth_error((ssize_t)-1, -res);
+    else
+        *rv = (ssize_t)res;
+    return TRUE;
+}
+
+#endif /* PTH_URING */
+
@@ -94,13 +94,48 @@ intern char *pth_util_cpystrn(char *dst, const char *src, size_t dst_size)
 /* check whether a file-descriptor is valid */
 intern int pth_util_fd_valid(int fd)
 {
-    if (fd < 0 || fd >= FD_SETSIZE)
+    if (fd < 0 || (fd >= FD_SETSIZE && !pth_iomux_unbounded()))
         return FALSE;
+    if (pth_fdmode_cached(fd))
+        return TRUE;
     if (fcntl(fd, F_GETFL) == -1 && errno == EBADF)
         return FALSE;
     return TRUE;
 }
 
+/* poll a single filedescriptor for readiness without blocking */
+intern int pth_util_fd_poll(int fd, int goal)
+{
+    struct timeval delay;
+    fd_set rfds;
+    fd_set wfds;
+    fd_set efds;
+    int n;
+
+    /* pinned filedescriptors have their readiness cached */
+    if (pth_iomux_pinned(fd))
+        return (pth_iomux_cached(fd, goal) ? 1 : 0);
+
+    /* filedescriptors outside the range of fd_set are
+       left to the readiness multiplexer of the scheduler */
+    if (fd >= FD_SETSIZE)
+        return 0;
+    FD_ZERO(&rfds);
+    FD_ZERO(&wfds);
+    FD_ZERO(&efds);
+    if (goal & PTH_UNTIL_FD_READABLE)
+        FD_SET(fd, &rfds);
+    if (goal & PTH_UNTIL_FD_WRITEABLE)
+        FD_SET(fd, &wfds);
+    if (goal & PTH_UNTIL_FD_EXCEPTION)
+        FD_SET(fd, &efds);
+    delay.tv_sec  = 0;
+    delay.tv_usec = 0;
+    while ((n = pth_sc(select)(fd+1, &rfds, &wfds, &efds, &delay)) < 0
+           && errno == EINTR) ;
+    return n;
+}
+
 /* merge input fd set into output fds */
 intern void pth_util_fds_merge(int nfd,
                                fd_set *ifds1, fd_set *ofds1,
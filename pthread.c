@@ -1165,3 +1165,15 @@ ssize_t __pthread_pwrite(int fd, const void *buf, size_t nbytes, off_t offset)
     return pth_pwrite(fd, buf, nbytes, offset);
 }
 
+ssize_t __pthread_preadv(int fd, const struct iovec *piovec, int iocnt, off_t offset)
+{
+    pthread_initialize();
+    return pth_preadv(fd, piovec, iocnt, offset);
+}
+
+ssize_t __pthread_pwritev(int fd, const struct iovec *piovec, int iocnt, off_t offset)
+{
+    pthread_initialize();
+    return pth_pwritev(fd, piovec, iocnt, offset);
+}
+
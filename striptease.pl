@@ -78,7 +78,7 @@ close(FP);
 @source = (qw(
     pth_compat.c pth_debug.c pth_syscall.c pth_errno.c pth_ring.c pth_mctx.c
     pth_uctx.c pth_clean.c pth_time.c pth_tcb.c pth_util.c pth_pqueue.c pth_event.c
-    pth_sched.c pth_data.c pth_msg.c pth_cancel.c pth_sync.c pth_attr.c pth_lib.c
+    pth_iomux.c pth_sigmux.c pth_timer.c pth_task.c pth_uring.c pth_offload.c pth_sched.c pth_data.c pth_msg.c pth_cancel.c pth_sync.c pth_attr.c pth_lib.c
     pth_fork.c pth_high.c pth_ext.c pth_string.c
 ));
 
@@ -0,0 +1,307 @@
+/*
+**  GNU Pth - The GNU Portable Threads
+**  Copyright (c) 1999-2006 Ralf S. Engelschall <rse@engelschall.com>
+**
+**  This file is part of GNU Pth, a non-preemptive thread scheduling
+**  library which can be found at http://www.gnu.org/software/pth/.
+**
+**  This library is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU Lesser General Public
+**  License as published by the Free Software Foundation; either
+**  version 2.1 of the License, or (at your option) any later version.
+**
+**  This library is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**  Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public
+**  License along with this library; if not, write to the Free Software
+**  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+**  USA, or contact Ralf S. Engelschall <rse@engelschall.com>.
+**
+**  test_io.c: Pth test program (I/O path microbenchmark)
+*/
+                             /* ``Measure twice, cut once.''
+                                      -- Proverb */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* for RTLD_NEXT */
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <signal.h>
+#include <dlfcn.h>
+
+#include "pth.h"
+
+/*
+ * This measures the cost of passing small messages over a busy
+ * connection (a stream socket pair kept full by the writer) through
+ * the various Pth I/O functions, with and without attempting the
+ * I/O before polling (PTH_CTRL_IOFIRST) and keeping the sockets in
+ * non-blocking mode (PTH_FDCACHE_NONBLOCK). Where the C library
+ * functions can be interposed, it also counts the system calls the
+ * library performs per message, and separately the fstat(2) calls
+ * among them (which the sockets never need).
+ */
+
+#define MESSAGES 100000
+#define MSGSIZE  64
+
+#if defined(__GLIBC__) && defined(RTLD_NEXT)
+#define COUNT_SYSCALLS 1
+#else
+#define COUNT_SYSCALLS 0
+#endif
+#if COUNT_SYSCALLS && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#define COUNT_FSTATS 1 /* (older versions call __fxstat instead) */
+#else
+#define COUNT_FSTATS 0
+#endif
+
+#if COUNT_SYSCALLS
+/* count calls of the system call wrappers the library uses */
+static long syscalls;
+static long fstats;
+#undef read
+#undef write
+#undef readv
+#undef writev
+#undef recv
+#undef recvfrom
+#undef send
+#undef sendto
+#undef select
+#undef poll
+#undef sigprocmask
+#undef fcntl
+#define WRAP(rtype, name, params, args) \
+    rtype name params \
+    { \
+        static rtype (*fn) params = NULL; \
+        if (fn == NULL) \
+            fn = (rtype (*) params)dlsym(RTLD_NEXT, #name); \
+        syscalls++; \
+        return fn args; \
+    }
+WRAP(ssize_t, read, (int fd, void *buf, size_t n), (fd, buf, n))
+WRAP(ssize_t, write, (int fd, const void *buf, size_t n), (fd, buf, n))
+WRAP(ssize_t, readv, (int fd, const struct iovec *iov, int n), (fd, iov, n))
+WRAP(ssize_t, writev, (int fd, const struct iovec *iov, int n), (fd, iov, n))
+WRAP(ssize_t, recv, (int fd, void *buf, size_t n, int fl), (fd, buf, n, fl))
+WRAP(ssize_t, recvfrom, (int fd, void *buf, size_t n, int fl, struct sockaddr *a, socklen_t *al),
+     (fd, buf, n, fl, a, al))
+WRAP(ssize_t, send, (int fd, const void *buf, size_t n, int fl), (fd, buf, n, fl))
+WRAP(ssize_t, sendto, (int fd, const void *buf, size_t n, int fl, const struct sockaddr *a, socklen_t al),
+     (fd, buf, n, fl, a, al))
+WRAP(ssize_t, preadv2, (int fd, const struct iovec *iov, int n, off_t o, int fl), (fd, iov, n, o, fl))
+WRAP(ssize_t, pwritev2, (int fd, const struct iovec *iov, int n, off_t o, int fl), (fd, iov, n, o, fl))
+WRAP(int, select, (int n, fd_set *r, fd_set *w, fd_set *e, struct timeval *t), (n, r, w, e, t))
+WRAP(int, poll, (struct pollfd *p, nfds_t n, int t), (p, n, t))
+WRAP(int, sigprocmask, (int how, const sigset_t *s, sigset_t *o), (how, s, o))
+#ifdef __linux__
+#include <sys/epoll.h>
+WRAP(int, epoll_ctl, (int e, int op, int fd, struct epoll_event *ev), (e, op, fd, ev))
+WRAP(int, epoll_pwait, (int e, struct epoll_event *ev, int n, int t, const sigset_t *s),
+     (e, ev, n, t, s))
+#endif
+#if COUNT_FSTATS
+int fstat(int fd, struct stat *sb)
+{
+    static int (*fn)(int, struct stat *) = NULL;
+
+    if (fn == NULL)
+        fn = (int (*)(int, struct stat *))dlsym(RTLD_NEXT, "fstat");
+    syscalls++;
+    fstats++;
+    return fn(fd, sb);
+}
+#endif
+int fcntl(int fd, int cmd, ...)
+{
+    static int (*fn)(int, int, ...) = NULL;
+    va_list ap;
+    long arg;
+
+    if (fn == NULL)
+        fn = (int (*)(int, int, ...))dlsym(RTLD_NEXT, "fcntl");
+    va_start(ap, cmd);
+    arg = va_arg(ap, long);
+    va_end(ap);
+    syscalls++;
+    return fn(fd, cmd, arg);
+}
+#endif
+
+/* the pairs of Pth I/O functions */
+#define API_RW       0
+#define API_RWV      1
+#define API_SENDRECV 2
+#define API_SENDTO   3
+static const char *api_names[] = { "read/write", "readv/writev", "recv/send", "recvfrom/sendto" };
+
+static int api;
+static int sv[2];
+
+static ssize_t msg_out(int fd, char *buf, size_t len)
+{
+    struct iovec iov;
+
+    switch (api) {
+        case API_RW:
+            return pth_write(fd, buf, len);
+        case API_RWV:
+            iov.iov_base = buf;
+            iov.iov_len  = len;
+            return pth_writev(fd, &iov, 1);
+        case API_SENDRECV:
+            return pth_send(fd, buf, len, 0);
+        default:
+            return pth_sendto(fd, buf, len, 0, NULL, 0);
+    }
+}
+
+static ssize_t msg_in(int fd, char *buf, size_t len)
+{
+    struct iovec iov;
+
+    switch (api) {
+        case API_RW:
+            return pth_read(fd, buf, len);
+        case API_RWV:
+            iov.iov_base = buf;
+            iov.iov_len  = len;
+            return pth_readv(fd, &iov, 1);
+        case API_SENDRECV:
+            return pth_recv(fd, buf, len, 0);
+        default:
+            return pth_recvfrom(fd, buf, len, 0, NULL, NULL);
+    }
+}
+
+static void *writer(void *_arg)
+{
+    char buf[MSGSIZE];
+    int i;
+
+    memset(buf, 'x', sizeof(buf));
+    for (i = 0; i < MESSAGES; i++)
+        if (msg_out(sv[0], buf, sizeof(buf)) != sizeof(buf))
+            break;
+    return NULL;
+}
+
+static int bench(int iofirst, int caching)
+{
+    pth_attr_t attr;
+    pth_t tid;
+    char buf[MSGSIZE];
+    struct timeval tv_start;
+    struct timeval tv_end;
+    double usec;
+    long count;
+    long fcount;
+    long bytes;
+    ssize_t n;
+
+    pth_ctrl(PTH_CTRL_IOFIRST, iofirst);
+    pth_ctrl(PTH_CTRL_FDCACHE, caching);
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == -1) {
+        perror("socketpair");
+        return FALSE;
+    }
+
+    attr = pth_attr_new();
+    pth_attr_set(attr, PTH_ATTR_NAME, "writer");
+    pth_attr_set(attr, PTH_ATTR_STACK_SIZE, 32*1024);
+    tid = pth_spawn(attr, writer, NULL);
+    pth_attr_destroy(attr);
+    if (tid == NULL) {
+        perror("pth_spawn");
+        return FALSE;
+    }
+
+    /* read the messages while the writer keeps the connection busy */
+    gettimeofday(&tv_start, NULL);
+#if COUNT_SYSCALLS
+    syscalls = 0;
+    fstats   = 0;
+#endif
+    bytes = 0;
+    while (bytes < (long)MESSAGES * MSGSIZE) {
+        if ((n = msg_in(sv[1], buf, sizeof(buf))) <= 0) {
+            perror("reading message");
+            return FALSE;
+        }
+        bytes += n;
+    }
+#if COUNT_SYSCALLS
+    count = syscalls;
+#else
+    count = -1;
+#endif
+#if COUNT_FSTATS
+    fcount = fstats;
+#else
+    fcount = -1;
+#endif
+    gettimeofday(&tv_end, NULL);
+    pth_join(tid, NULL);
+    pth_close(sv[0]);
+    pth_close(sv[1]);
+
+    usec = (double)(tv_end.tv_sec - tv_start.tv_sec) * 1000000.0
+           + (double)(tv_end.tv_usec - tv_start.tv_usec);
+    fprintf(stderr, "%-15s %-7s %-8s %9.1f", api_names[api],
+            (iofirst ? "yes" : "no"), (caching ? "nonblock" : "off"),
+            usec * 1000.0 / MESSAGES);
+    if (count >= 0)
+        fprintf(stderr, " %13.2f", (double)count / MESSAGES);
+    else
+        fprintf(stderr, " %13s", "-");
+    if (fcount >= 0)
+        fprintf(stderr, " %11.2f\n", (double)fcount / MESSAGES);
+    else
+        fprintf(stderr, " %11s\n", "-");
+    return TRUE;
+}
+
+int main(int argc, char *argv[])
+{
+    if (!pth_init()) {
+        perror("pth_init");
+        exit(1);
+    }
+
+    fprintf(stderr, "This is TEST_IO, a Pth I/O path microbenchmark.\n");
+    fprintf(stderr, "It measures the cost of passing %d messages of %d bytes\n",
+            MESSAGES, MSGSIZE);
+    fprintf(stderr, "over a busy socket pair with and without attempting the\n");
+    fprintf(stderr, "I/O first (PTH_CTRL_IOFIRST) and keeping the sockets in\n");
+    fprintf(stderr, "non-blocking mode (PTH_CTRL_FDCACHE).\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "functions       iofirst fdcache   ns/msg  syscalls/msg  fstats/msg\n");
+
+    for (api = API_RW; api <= API_SENDTO; api++) {
+        if (   !bench(FALSE, PTH_FDCACHE_OFF)
+            || !bench(TRUE,  PTH_FDCACHE_OFF)
+            || !bench(FALSE, PTH_FDCACHE_NONBLOCK)
+            || !bench(TRUE,  PTH_FDCACHE_NONBLOCK))
+            exit(1);
+    }
+
+    pth_ctrl(PTH_CTRL_IOFIRST, FALSE);
+    pth_ctrl(PTH_CTRL_FDCACHE, PTH_FDCACHE_OFF);
+    pth_kill();
+    return 0;
+}
@@ -0,0 +1,203 @@
+/*
+**  GNU Pth - The GNU Portable Threads
+**  Copyright (c) 1999-2006 Ralf S. Engelschall <rse@engelschall.com>
+**
+**  This file is part of GNU Pth, a non-preemptive thread scheduling
+**  library which can be found at http://www.gnu.org/software/pth/.
+**
+**  This library is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU Lesser General Public
+**  License as published by the Free Software Foundation; either
+**  version 2.1 of the License, or (at your option) any later version.
+**
+**  This library is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**  Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public
+**  License along with this library; if not, write to the Free Software
+**  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+**  USA, or contact Ralf S. Engelschall <rse@engelschall.com>.
+**
+**  test_sched.c: Pth test program (scheduler microbenchmark)
+*/
+                             /* ``Premature optimization is
+                                  the root of all evil.''
+                                      -- Donald E. Knuth */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <signal.h>
+#include <dlfcn.h>
+
+#include "pth.h"
+
+/*
+ * This measures the cost of a pth_yield(3) with a given number of
+ * ready threads. Every yield reinserts the yielding thread into the
+ * ready queue and removes the next thread from it, so this shows how
+ * the ready queue insert/delmax operations scale with the number of
+ * ready threads (on top of the constant context switching costs),
+ * both alone and with a thread waiting (in pth_join(3)) meanwhile.
+ * Where the C library functions can be interposed, it also counts
+ * the signal mask changes per yield, which a steady-state yield loop
+ * should not need at all.
+ */
+
+#define YIELDS 1000000
+
+#if defined(__GLIBC__) && defined(RTLD_NEXT)
+#define COUNT_SIGMASKS 1
+#else
+#define COUNT_SIGMASKS 0
+#endif
+
+#if COUNT_SIGMASKS
+/* count calls of the signal mask function the library uses */
+static long sigmasks;
+#undef sigprocmask
+int sigprocmask(int how, const sigset_t *set, sigset_t *oset)
+{
+    static int (*fn)(int, const sigset_t *, sigset_t *) = NULL;
+
+    if (fn == NULL)
+        fn = (int (*)(int, const sigset_t *, sigset_t *))dlsym(RTLD_NEXT, "sigprocmask");
+    sigmasks++;
+    return fn(how, set, oset);
+}
+#endif
+
+static volatile int done;
+static long yields;
+static long mark_start;
+static long mark_end;
+static int alive;
+static struct timeval tv_start;
+static struct timeval tv_end;
+static long masks_start;
+static long masks_end;
+
+static void *yielder(void *_arg)
+{
+    alive++;
+    while (!done) {
+        yields++;
+        if (yields == mark_start) {
+            gettimeofday(&tv_start, NULL);
+#if COUNT_SIGMASKS
+            masks_start = sigmasks;
+#endif
+        }
+        else if (yields == mark_end) {
+            gettimeofday(&tv_end, NULL);
+#if COUNT_SIGMASKS
+            masks_end = sigmasks;
+#endif
+            done = TRUE;
+        }
+        pth_yield(NULL);
+    }
+    alive--;
+    return NULL;
+}
+
+static void *joiner(void *_arg)
+{
+    pth_join((pth_t)_arg, NULL);
+    return NULL;
+}
+
+static int bench(int threads, int waiting)
+{
+    pth_attr_t attr;
+    pth_t tid;
+    double usec;
+    int i;
+
+    done       = FALSE;
+    yields     = 0;
+    alive      = 0;
+    mark_start = threads;
+    mark_end   = threads + YIELDS;
+    masks_start = 0;
+    masks_end   = -1;
+
+    attr = pth_attr_new();
+    pth_attr_set(attr, PTH_ATTR_NAME, "yielder");
+    pth_attr_set(attr, PTH_ATTR_JOINABLE, FALSE);
+    pth_attr_set(attr, PTH_ATTR_STACK_SIZE, 32*1024);
+    for (i = 0; i < threads; i++) {
+        pth_attr_set(attr, PTH_ATTR_JOINABLE, (waiting && i == 0));
+        if ((tid = pth_spawn(attr, yielder, NULL)) == NULL) {
+            fprintf(stderr, "failed to spawn thread #%d: %s\n", i+1, strerror(errno));
+            done = TRUE;
+            break;
+        }
+        if (waiting && i == 0) {
+            /* let a thread wait for the first one until it terminates */
+            pth_attr_set(attr, PTH_ATTR_NAME, "joiner");
+            pth_attr_set(attr, PTH_ATTR_JOINABLE, FALSE);
+            if (pth_spawn(attr, joiner, tid) == NULL) {
+                fprintf(stderr, "failed to spawn joiner: %s\n", strerror(errno));
+                done = TRUE;
+                break;
+            }
+            pth_attr_set(attr, PTH_ATTR_NAME, "yielder");
+        }
+    }
+    pth_attr_destroy(attr);
+
+    /* let the threads yield until enough yields were measured
+       (and the joiner terminated, too) */
+    while (!done || alive > 0 || (waiting && pth_ctrl(PTH_CTRL_GETTHREADS) > 1))
+        pth_yield(NULL);
+    if (i < threads)
+        return FALSE;
+
+    usec = (double)(tv_end.tv_sec - tv_start.tv_sec) * 1000000.0
+           + (double)(tv_end.tv_usec - tv_start.tv_usec);
+    if (masks_end >= 0)
+        fprintf(stderr, "%13d %8d %10d %12.1f %15.2f\n", threads, waiting, YIELDS,
+                usec * 1000.0 / YIELDS, (double)(masks_end - masks_start) / YIELDS);
+    else
+        fprintf(stderr, "%13d %8d %10d %12.1f %15s\n", threads, waiting, YIELDS,
+                usec * 1000.0 / YIELDS, "-");
+    return TRUE;
+}
+
+int main(int argc, char *argv[])
+{
+    static int defaults[] = { 10, 1000, 100000 };
+    int i;
+
+    if (!pth_init()) {
+        perror("pth_init");
+        exit(1);
+    }
+
+    fprintf(stderr, "This is TEST_SCHED, a Pth scheduler microbenchmark.\n");
+    fprintf(stderr, "It measures the cost of a context switch through the\n");
+    fprintf(stderr, "ready queue (insert plus delmax) for various numbers\n");
+    fprintf(stderr, "of ready threads, alone and with one waiting thread.\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "ready threads  waiting     yields     ns/yield  sigmasks/yield\n");
+
+    if (argc > 1) {
+        for (i = 1; i < argc; i++)
+            if (!bench(atoi(argv[i]), 0) || !bench(atoi(argv[i]), 1))
+                exit(1);
+    }
+    else {
+        for (i = 0; i < (int)(sizeof(defaults)/sizeof(int)); i++)
+            if (!bench(defaults[i], 0) || !bench(defaults[i], 1))
+                exit(1);
+    }
+
+    pth_kill();
+    return 0;
+}
@@ -29,9 +29,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <ctype.h>
 #include <errno.h>
+#include <signal.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
 
 #include "pth.h"
 
@@ -78,6 +84,302 @@ static void *t2_func(void *arg)
     return rval;
 }
 
+static pth_msgport_t t4_mp;
+
+static pth_event_t t4_forward(void *arg, pth_event_t ev)
+{
+    pth_message_t *m;
+
+    while ((m = pth_msgport_get((pth_msgport_t)arg)) != NULL)
+        pth_msgport_put(t4_mp, m);
+    return ev;
+}
+
+static pth_event_t t4_tick(void *arg, pth_event_t ev)
+{
+    int *ticks = (int *)arg;
+
+    if (++(*ticks) == 5)
+        return NULL;
+    return pth_event(PTH_EVENT_TIME|PTH_MODE_REUSE, ev, pth_timeout(0,10000));
+}
+
+static void *t3_func(void *arg)
+{
+    char buf[8192];
+    volatile char *vp;
+    size_t i;
+
+    /* touch the buffer through a volatile pointer,
+       so the optimizer cannot elide the stack usage */
+    vp = buf;
+    for (i = 0; i < sizeof(buf); i++)
+        vp[i] = 0;
+    pth_yield(NULL);
+    return (void *)(long)vp[(long)arg];
+}
+
+static int t18_recurse(int depth)
+{
+    volatile char buf[1024];
+
+    buf[0] = (char)depth;
+    if (depth < 0)
+        return 0;
+    return t18_recurse(depth+1) + buf[0];
+}
+
+static void *t18_func(void *arg)
+{
+    return (void *)(long)t18_recurse((int)(long)arg);
+}
+
+static void *t19_func(void *arg)
+{
+    pth_mutex_t *mutex = (pth_mutex_t *)arg;
+    char buf[32*1024];
+    volatile char *vp;
+    size_t i;
+    long bad;
+
+    vp = buf;
+    for (i = 0; i < sizeof(buf); i++)
+        vp[i] = 0x33;
+    pth_mutex_acquire(mutex, FALSE, NULL);
+    pth_mutex_release(mutex);
+    bad = 0;
+    for (i = 0; i < sizeof(buf); i++)
+        if (vp[i] != 0x33)
+            bad++;
+    return (void *)bad;
+}
+
+static volatile sig_atomic_t t20_caught;
+
+static void t20_handler(int sig)
+{
+    t20_caught++;
+}
+
+static void *t20_func(void *arg)
+{
+    if (arg != NULL)
+        pth_sigmask(SIG_SETMASK, (sigset_t *)arg, NULL);
+    pth_nap(pth_time(0,50000));
+    return NULL;
+}
+
+static void *t21_func(void *arg)
+{
+    sigset_t ss;
+
+    pth_sigmask(SIG_SETMASK, NULL, &ss);
+    return (void *)(long)sigismember(&ss, SIGUSR2);
+}
+
+static int t14_func(void *arg)
+{
+    int *calls = (int *)arg;
+
+    return (++(*calls) == 3);
+}
+
+static volatile int t15_state;
+
+static void *t15_func(void *arg)
+{
+    time_t deadline;
+
+    /* runs on a kernel thread: wait (boundedly) until the stack of
+       the aborted caller could be reused and then write into it */
+    t15_state = 1;
+    deadline = time(NULL) + 2;
+    while (t15_state == 1 && time(NULL) < deadline)
+        ;
+    memset(arg, 0xAA, 4096);
+    t15_state = 3;
+    return NULL;
+}
+
+static void *t16_func(void *arg)
+{
+    char buf[4096];
+
+    pth_offload(t15_func, buf, NULL);
+    return NULL;
+}
+
+static void *t17_func(void *arg)
+{
+    char buf[32*1024];
+    volatile char *vp;
+    long bad;
+    size_t i;
+
+    vp = buf;
+    for (i = 0; i < sizeof(buf); i++)
+        vp[i] = 0x11;
+    t15_state = 2;
+    while (t15_state != 3)
+        pth_nap(pth_time(0,1000));
+    bad = 0;
+    for (i = 0; i < sizeof(buf); i++)
+        if (vp[i] != 0x11)
+            bad++;
+    return (void *)bad;
+}
+
+static void *t13_func(void *arg)
+{
+    int fd = (int)(long)arg;
+    int i;
+
+    for (i = 0; i < 10; i++) {
+        pth_usleep(1000);
+        FAILED_IF(pth_write(fd, "0123456789", 10) != 10)
+    }
+    FAILED_IF(pth_close(fd) == -1)
+    return NULL;
+}
+
+static void *t12_func(void *arg)
+{
+    int fd = (int)(long)arg;
+    char buf[4096];
+    long total;
+    ssize_t n;
+    int i;
+
+    total = 0;
+    while (total < 256*1024) {
+        n = pth_read(fd, buf, sizeof(buf));
+        FAILED_IF(n <= 0)
+        for (i = 0; i < n; i++)
+            FAILED_IF(buf[i] != (char)((total + i) % 251))
+        total += n;
+    }
+    return NULL;
+}
+
+static void *t11_func(void *arg)
+{
+    int fd = (int)((long)arg >> 3);
+    int i = (int)((long)arg & 7);
+    char buf[1024];
+    struct iovec iov[2];
+    ssize_t n;
+    int j, k, l;
+
+    for (j = 0; j < 8; j++) {
+        k = (i + j) % 8;
+        memset(buf, 0, sizeof(buf));
+        if (j % 2 == 0)
+            n = pth_pread(fd, buf, sizeof(buf), (off_t)k*sizeof(buf));
+        else {
+            iov[0].iov_base = buf;
+            iov[0].iov_len  = 300;
+            iov[1].iov_base = buf+300;
+            iov[1].iov_len  = sizeof(buf)-300;
+            n = pth_preadv(fd, iov, 2, (off_t)k*sizeof(buf));
+        }
+        FAILED_IF(n != sizeof(buf))
+        for (l = 0; l < sizeof(buf); l++)
+            FAILED_IF(buf[l] != 'a'+k)
+    }
+    return NULL;
+}
+
+static void *t10_func(void *arg)
+{
+    int fd = (int)((long)arg >> 3);
+    int i = (int)((long)arg & 7);
+    char buf[1024];
+    struct iovec iov[2];
+    ssize_t n;
+
+    memset(buf, 'a'+i, sizeof(buf));
+    if (i % 2 == 0)
+        n = pth_pwrite(fd, buf, sizeof(buf), (off_t)i*sizeof(buf));
+    else {
+        iov[0].iov_base = buf;
+        iov[0].iov_len  = 100;
+        iov[1].iov_base = buf+100;
+        iov[1].iov_len  = sizeof(buf)-100;
+        n = pth_pwritev(fd, iov, 2, (off_t)i*sizeof(buf));
+    }
+    FAILED_IF(n != sizeof(buf))
+    return NULL;
+}
+
+static void *t9_func(void *arg)
+{
+    int fd = (int)(long)arg;
+
+    pth_usleep(20000);
+    FAILED_IF(pth_write(fd, "x", 1) != 1)
+    pth_usleep(20000);
+    FAILED_IF(pth_close(fd) == -1)
+    return NULL;
+}
+
+static void *t8_func(void *arg)
+{
+    int fd = (int)(long)arg;
+    ssize_t n;
+    char c;
+    int i;
+
+    for (i = 0; i < 100; i++) {
+        if (i % 2 == 0)
+            n = pth_read(fd, &c, 1);
+        else
+            n = pth_recv(fd, &c, 1, 0);
+        FAILED_IF(n != 1 || c != (char)i)
+    }
+    return NULL;
+}
+
+static void *t7_func(void *arg)
+{
+    int fd = (int)(long)arg;
+    char c;
+    int i;
+
+    for (i = 0; i < 100; i++)
+        FAILED_IF(pth_read(fd, &c, 1) != 1 || c != (char)i)
+    return NULL;
+}
+
+static void *t6_func(void *arg)
+{
+    return (void *)((long)arg * 2);
+}
+
+static void *t5_func(void *arg)
+{
+    char name[32];
+    char buf[1024];
+    struct stat sb;
+    int fd;
+    int i;
+
+    sprintf(name, "test_std.tmp.%ld", (long)arg);
+    fd = pth_open(name, O_CREAT|O_TRUNC|O_RDWR, 0600);
+    FAILED_IF(fd == -1)
+    memset(buf, 'a'+(int)(long)arg, sizeof(buf));
+    for (i = 0; i < 64; i++)
+        FAILED_IF(pth_write(fd, buf, sizeof(buf)) != sizeof(buf))
+    FAILED_IF(pth_fsync(fd) == -1)
+    FAILED_IF(pth_stat(name, &sb) == -1 || sb.st_size != 64*sizeof(buf))
+    FAILED_IF(lseek(fd, 0, SEEK_SET) == -1)
+    for (i = 0; pth_read(fd, buf, sizeof(buf)) == sizeof(buf); i++)
+        FAILED_IF(buf[i] != 'a'+(int)(long)arg)
+    FAILED_IF(i != 64)
+    close(fd);
+    unlink(name);
+    return NULL;
+}
+
 int main(int argc, char *argv[])
 {
     fprintf(stderr, "\n=== TESTING GLOBAL LIBRARY API ===\n\n");
@@ -146,6 +448,573 @@ int main(int argc, char *argv[])
         FAILED_IF(val != (void *)(1*2*3*4*5*6*7*8*9))
     }
 
+    fprintf(stderr, "\n=== TESTING BATCHED THREAD OPERATION ===\n\n");
+    {
+        pth_t tids[10];
+        void *args[10];
+        void *val;
+        long sum;
+        int rc;
+        int i;
+
+        for (i = 0; i < 10; i++)
+            args[i] = (void *)(123);
+        fprintf(stderr, "Spawning 10 threads at once\n");
+        rc = pth_spawn_n(PTH_ATTR_DEFAULT, t1_func, args, 10, tids);
+        FAILED_IF(rc == FALSE)
+
+        fprintf(stderr, "Joining 10 threads\n");
+        sum = 0;
+        for (i = 0; i < 10; i++) {
+            rc = pth_join(tids[i], &val);
+            FAILED_IF(rc == FALSE)
+            sum += (long)val;
+        }
+        FAILED_IF(sum != 10*1123)
+    }
+
+    fprintf(stderr, "\n=== TESTING CONTROL BLOCK RECYCLING ===\n\n");
+    {
+        pth_t tids[4];
+        int pooled;
+        int n;
+        int rc;
+        int i;
+
+        fprintf(stderr, "Pre-warming the pool\n");
+        FAILED_IF(pth_ctrl(PTH_CTRL_TCBPOOL, 4, 2) != -1)
+        pooled = (int)pth_ctrl(PTH_CTRL_TCBPOOL, 4, 32);
+        FAILED_IF(pooled < 4)
+        fprintf(stderr, "Spawning 4 threads from the pool\n");
+        for (i = 0; i < 4; i++) {
+            tids[i] = pth_spawn(PTH_ATTR_DEFAULT, t6_func, (void *)(long)i);
+            FAILED_IF(tids[i] == NULL)
+        }
+        n = (int)pth_ctrl(PTH_CTRL_TCBPOOL, 0, 32);
+        FAILED_IF(n != pooled-4)
+        fprintf(stderr, "Joining 4 threads back into the pool\n");
+        for (i = 0; i < 4; i++) {
+            rc = pth_join(tids[i], NULL);
+            FAILED_IF(rc == FALSE)
+        }
+        n = (int)pth_ctrl(PTH_CTRL_TCBPOOL, 0, 32);
+        FAILED_IF(n != pooled)
+        fprintf(stderr, "Draining the pool\n");
+        n = (int)pth_ctrl(PTH_CTRL_TCBPOOL, 0, 0);
+        FAILED_IF(n != 0)
+        n = (int)pth_ctrl(PTH_CTRL_TCBPOOL, 0, 32);
+        FAILED_IF(n != 0)
+    }
+
+    fprintf(stderr, "\n=== TESTING STACK PROFILING ===\n\n");
+    {
+        pth_attr_t attr;
+        pth_t tid;
+        unsigned int used, size;
+        int rc;
+        int i;
+
+        rc = (int)pth_ctrl(PTH_CTRL_STACKPROF, 90);
+        FAILED_IF(rc == -1)
+        attr = pth_attr_new();
+        pth_attr_set(attr, PTH_ATTR_NAME, "prof");
+        pth_attr_set(attr, PTH_ATTR_STACK_SIZE, 512*1024);
+        fprintf(stderr, "Spawning and joining 16 profiled threads\n");
+        for (i = 0; i < 16; i++) {
+            tid = pth_spawn(attr, t3_func, (void *)(long)i);
+            FAILED_IF(tid == NULL)
+            pth_yield(tid);
+            rc = pth_attr_get(pth_attr_of(tid), PTH_ATTR_STACK_USED, &used);
+            FAILED_IF(rc == FALSE || used < 8192)
+            rc = pth_join(tid, NULL);
+            FAILED_IF(rc == FALSE)
+        }
+        rc = pth_attr_get(attr, PTH_ATTR_STACK_USED, &used);
+        FAILED_IF(rc == FALSE || used < 8192 || used >= 512*1024)
+        fprintf(stderr, "Maximum stack depth: %u bytes\n", used);
+        tid = pth_spawn(attr, t3_func, (void *)(0));
+        FAILED_IF(tid == NULL)
+        rc = pth_attr_get(pth_attr_of(tid), PTH_ATTR_STACK_SIZE, &size);
+        FAILED_IF(rc == FALSE || size < used || size >= 512*1024)
+        fprintf(stderr, "Automatically sized stack: %u bytes\n", size);
+        rc = pth_join(tid, NULL);
+        FAILED_IF(rc == FALSE)
+        pth_attr_destroy(attr);
+        rc = (int)pth_ctrl(PTH_CTRL_STACKPROF, -1);
+        FAILED_IF(rc == -1)
+    }
+
+    fprintf(stderr, "\n=== TESTING STACK GUARD PAGES ===\n\n");
+    {
+        pth_attr_t attr;
+        pth_t tid;
+        pid_t pid;
+        void *val;
+        int status;
+        int rc;
+
+        attr = pth_attr_new();
+        pth_attr_set(attr, PTH_ATTR_NAME, "guarded");
+        pth_attr_set(attr, PTH_ATTR_STACK_SIZE, 256*1024);
+        fprintf(stderr, "Running a thread on a stack with a guard page\n");
+        tid = pth_spawn(attr, t3_func, (void *)(long)100);
+        FAILED_IF(tid == NULL)
+        rc = pth_join(tid, &val);
+        FAILED_IF(rc == FALSE || val != NULL)
+        fprintf(stderr, "Overflowing a stack with a guard page in a child process\n");
+        pid = fork();
+        FAILED_IF(pid == -1)
+        if (pid == 0) {
+            struct rlimit rl;
+
+            rl.rlim_cur = rl.rlim_max = 0;
+            setrlimit(RLIMIT_CORE, &rl);
+            tid = pth_spawn(attr, t18_func, NULL);
+            pth_join(tid, NULL);
+            exit(0);
+        }
+        FAILED_IF(waitpid(pid, &status, 0) != pid)
+        FAILED_IF(!WIFSIGNALED(status) || WTERMSIG(status) != SIGSEGV)
+        pth_attr_destroy(attr);
+    }
+
+    fprintf(stderr, "\n=== TESTING STACK TRIMMING ===\n\n");
+    {
+        pth_attr_t attr;
+        pth_mutex_t mutex;
+        pth_t tids[4];
+        void *val;
+        long bytes;
+        int rc;
+        int i;
+
+        attr = pth_attr_new();
+        pth_attr_set(attr, PTH_ATTR_NAME, "idle");
+        pth_attr_set(attr, PTH_ATTR_STACK_SIZE, 1024*1024);
+        pth_mutex_init(&mutex);
+        pth_mutex_acquire(&mutex, FALSE, NULL);
+        fprintf(stderr, "Blocking 4 threads with large stacks\n");
+        for (i = 0; i < 4; i++) {
+            tids[i] = pth_spawn(attr, t19_func, &mutex);
+            FAILED_IF(tids[i] == NULL)
+        }
+        while (pth_ctrl(PTH_CTRL_GETTHREADS_WAITING) < 4)
+            pth_yield(NULL);
+        FAILED_IF(pth_ctrl(PTH_CTRL_GETTHREADS_WAITING) != 4)
+        bytes = pth_ctrl(PTH_CTRL_TRIMSTACKS);
+        fprintf(stderr, "Trimmed stacks: %ld bytes\n", bytes);
+        FAILED_IF(bytes < 4*512*1024L || bytes > 4*1024*1024L)
+        fprintf(stderr, "Resuming the threads with trimmed stacks\n");
+        pth_mutex_release(&mutex);
+        for (i = 0; i < 4; i++) {
+            rc = pth_join(tids[i], &val);
+            FAILED_IF(rc == FALSE || val != NULL)
+        }
+        pth_attr_destroy(attr);
+    }
+
+    fprintf(stderr, "\n=== TESTING STACKLESS TASKS ===\n\n");
+    {
+        pth_msgport_t mp;
+        pth_message_t msg[3];
+        pth_message_t *m;
+        pth_event_t ev_fwd, ev_tick, ev;
+        pth_task_t task;
+        int ticks;
+        int i;
+
+        mp = pth_msgport_create("in");
+        t4_mp = pth_msgport_create("out");
+        FAILED_IF(mp == NULL || t4_mp == NULL)
+        ev_fwd = pth_event(PTH_EVENT_MSG, mp);
+        task = pth_task_spawn(ev_fwd, t4_forward, mp);
+        FAILED_IF(task == NULL)
+        fprintf(stderr, "Forwarding 3 messages through a task\n");
+        ev = pth_event(PTH_EVENT_MSG, t4_mp);
+        for (i = 0; i < 3; i++) {
+            msg[i].m_size = i;
+            pth_msgport_put(mp, &msg[i]);
+            pth_wait(ev);
+            m = pth_msgport_get(t4_mp);
+            FAILED_IF(m != &msg[i])
+        }
+        FAILED_IF(pth_task_cancel(task) == FALSE)
+        pth_event_free(ev_fwd, PTH_FREE_ALL);
+
+        fprintf(stderr, "Ticking a timer task 5 times\n");
+        ticks = 0;
+        ev_tick = pth_event(PTH_EVENT_TIME, pth_timeout(0,10000));
+        task = pth_task_spawn(ev_tick, t4_tick, &ticks);
+        FAILED_IF(task == NULL)
+        while (ticks < 5)
+            pth_nap(pth_time(0,20000));
+        pth_event_free(ev_tick, PTH_FREE_ALL);
+        pth_event_free(ev, PTH_FREE_ALL);
+        pth_msgport_destroy(t4_mp);
+        pth_msgport_destroy(mp);
+    }
+
+    fprintf(stderr, "\n=== TESTING FILE I/O OFFLOADING ===\n\n");
+    {
+        pth_attr_t attr;
+        pth_t tid[8];
+        void *rval;
+        int rc;
+        int i;
+
+        rc = (int)pth_ctrl(PTH_CTRL_OFFLOAD, 2, 4);
+        FAILED_IF(rc == -1)
+        fprintf(stderr, "Writing and reading 8 files concurrently\n");
+        for (i = 0; i < 8; i++) {
+            tid[i] = pth_spawn(PTH_ATTR_DEFAULT, t5_func, (void *)(long)i);
+            FAILED_IF(tid[i] == NULL)
+        }
+        for (i = 0; i < 8; i++) {
+            rc = pth_join(tid[i], NULL);
+            FAILED_IF(rc == FALSE)
+        }
+        fprintf(stderr, "Running a function on a kernel thread\n");
+        rc = pth_offload(t6_func, (void *)21, &rval);
+        FAILED_IF(rc == FALSE || (long)rval != 42)
+        fprintf(stderr, "Aborting a thread while its function is running\n");
+        attr = pth_attr_new();
+        pth_attr_set(attr, PTH_ATTR_STACK_SIZE, 64*1024);
+        t15_state = 0;
+        tid[0] = pth_spawn(attr, t16_func, NULL);
+        FAILED_IF(tid[0] == NULL)
+        while (t15_state == 0)
+            pth_nap(pth_time(0,1000));
+        rc = pth_abort(tid[0]);
+        FAILED_IF(rc == FALSE)
+        tid[0] = pth_spawn(attr, t17_func, NULL);
+        FAILED_IF(tid[0] == NULL)
+        rc = pth_join(tid[0], &rval);
+        FAILED_IF(rc == FALSE || (long)rval != 0)
+        pth_attr_destroy(attr);
+        rc = (int)pth_ctrl(PTH_CTRL_OFFLOAD, 0, 0);
+        FAILED_IF(rc != -1)
+        rc = (int)pth_ctrl(PTH_CTRL_OFFLOAD, 4, 64);
+        FAILED_IF(rc == -1)
+    }
+
+    fprintf(stderr, "\n=== TESTING FILEDESCRIPTOR MODE CACHING ===\n\n");
+    {
+        pth_t tid;
+        int fds[2];
+        char c;
+        int rc;
+        int i;
+
+        rc = (int)pth_ctrl(PTH_CTRL_FDCACHE, PTH_FDCACHE_NONBLOCK);
+        FAILED_IF(rc == -1)
+        FAILED_IF(pipe(fds) == -1)
+        fprintf(stderr, "Passing 100 bytes through a pipe kept non-blocking\n");
+        tid = pth_spawn(PTH_ATTR_DEFAULT, t7_func, (void *)(long)fds[0]);
+        FAILED_IF(tid == NULL)
+        for (i = 0; i < 100; i++) {
+            c = (char)i;
+            FAILED_IF(pth_write(fds[1], &c, 1) != 1)
+            if (i % 10 == 0)
+                pth_yield(NULL);
+        }
+        rc = pth_join(tid, NULL);
+        FAILED_IF(rc == FALSE)
+        FAILED_IF(pth_fdmode(fds[1], PTH_FDMODE_POLL) != PTH_FDMODE_BLOCK)
+        rc = (int)pth_ctrl(PTH_CTRL_FDCACHE, PTH_FDCACHE_OFF);
+        FAILED_IF(rc == -1)
+        FAILED_IF(pth_fcntl(fds[1], F_GETFL) & O_NONBLOCK)
+        FAILED_IF(pth_close(fds[0]) == -1 || pth_close(fds[1]) == -1)
+    }
+
+    fprintf(stderr, "\n=== TESTING PINNED FILEDESCRIPTORS ===\n\n");
+    {
+        pth_t tid;
+        int fds[2];
+        int fd;
+        char c;
+        int rc;
+
+        fprintf(stderr, "Pinning and unpinning invalid filedescriptors\n");
+        FAILED_IF(pth_fdpin(-1) != FALSE || errno != EBADF)
+        FAILED_IF(pth_fdunpin(-1) != FALSE || errno != EINVAL)
+        FAILED_IF(pipe(fds) == -1)
+        FAILED_IF(pth_fdunpin(fds[0]) != FALSE || errno != EINVAL)
+        fprintf(stderr, "Reading from a pinned pipe\n");
+        FAILED_IF(pth_fdpin(fds[0]) == FALSE)
+        FAILED_IF(pth_fdpin(fds[0]) != FALSE || errno != EBUSY)
+        FAILED_IF(!(pth_fcntl(fds[0], F_GETFL) & O_NONBLOCK))
+        FAILED_IF(pth_fdmode(fds[0], PTH_FDMODE_POLL) != PTH_FDMODE_BLOCK)
+        tid = pth_spawn(PTH_ATTR_DEFAULT, t9_func, (void *)(long)fds[1]);
+        FAILED_IF(tid == NULL)
+        FAILED_IF(pth_read(fds[0], &c, 1) != 1 || c != 'x')
+        FAILED_IF(pth_read(fds[0], &c, 1) != 0)
+        rc = pth_join(tid, NULL);
+        FAILED_IF(rc == FALSE)
+        FAILED_IF(pth_fdunpin(fds[0]) == FALSE)
+        FAILED_IF(pth_fdunpin(fds[0]) != FALSE || errno != EINVAL)
+        FAILED_IF(pth_fcntl(fds[0], F_GETFL) & O_NONBLOCK)
+        fprintf(stderr, "Reading from a pinned pipe across a close and reopen\n");
+        FAILED_IF(pth_fdpin(fds[0]) == FALSE)
+        fd = fds[0];
+        FAILED_IF(pth_close(fds[0]) == -1)
+        FAILED_IF(pipe(fds) == -1)
+        FAILED_IF(fds[0] != fd)
+        FAILED_IF(pth_fdpin(fds[0]) == FALSE)
+        tid = pth_spawn(PTH_ATTR_DEFAULT, t9_func, (void *)(long)fds[1]);
+        FAILED_IF(tid == NULL)
+        FAILED_IF(pth_read(fds[0], &c, 1) != 1 || c != 'x')
+        FAILED_IF(pth_read(fds[0], &c, 1) != 0)
+        rc = pth_join(tid, NULL);
+        FAILED_IF(rc == FALSE)
+        FAILED_IF(pth_close(fds[0]) == -1)
+        FAILED_IF(pth_fdunpin(fds[0]) != FALSE || errno != EINVAL)
+    }
+
+    fprintf(stderr, "\n=== TESTING OPTIMISTIC I/O ===\n\n");
+    {
+        pth_event_t ev;
+        pth_t tid;
+        int fds[2];
+        ssize_t n;
+        char c;
+        int rc;
+        int i;
+
+        rc = (int)pth_ctrl(PTH_CTRL_IOFIRST, TRUE);
+        FAILED_IF(rc == -1)
+        FAILED_IF(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1)
+        fprintf(stderr, "Reading from an idle socket with a timeout\n");
+        ev = pth_event(PTH_EVENT_TIME, pth_timeout(0, 10000));
+        FAILED_IF(pth_read_ev(fds[0], &c, 1, ev) != -1 || errno != EINTR)
+        FAILED_IF(pth_event_status(ev) != PTH_STATUS_OCCURRED)
+        pth_event_free(ev, PTH_FREE_THIS);
+        fprintf(stderr, "Passing 100 bytes through a socket\n");
+        tid = pth_spawn(PTH_ATTR_DEFAULT, t8_func, (void *)(long)fds[0]);
+        FAILED_IF(tid == NULL)
+        for (i = 0; i < 100; i++) {
+            c = (char)i;
+            if (i % 2 == 0)
+                n = pth_write(fds[1], &c, 1);
+            else
+                n = pth_send(fds[1], &c, 1, 0);
+            FAILED_IF(n != 1)
+            if (i % 10 == 0)
+                pth_yield(NULL);
+        }
+        rc = pth_join(tid, NULL);
+        FAILED_IF(rc == FALSE)
+        rc = (int)pth_ctrl(PTH_CTRL_IOFIRST, FALSE);
+        FAILED_IF(rc == -1)
+        FAILED_IF(pth_close(fds[0]) == -1 || pth_close(fds[1]) == -1)
+    }
+
+    fprintf(stderr, "\n=== TESTING POLLING ===\n\n");
+    {
+        struct pollfd pfd;
+        pth_t tid;
+        int fds[2];
+        char c;
+        int rc;
+
+        FAILED_IF(pipe(fds) == -1)
+        tid = pth_spawn(PTH_ATTR_DEFAULT, t9_func, (void *)(long)fds[1]);
+        FAILED_IF(tid == NULL)
+        pfd.fd     = fds[0];
+        pfd.events = POLLIN;
+        fprintf(stderr, "Polling an idle pipe with a timeout\n");
+        rc = pth_poll(&pfd, 1, 5);
+        FAILED_IF(rc != 0 || pfd.revents != 0)
+        fprintf(stderr, "Waiting for data on the pipe\n");
+        rc = pth_poll(&pfd, 1, -1);
+        FAILED_IF(rc != 1 || !(pfd.revents & POLLIN))
+        FAILED_IF(pth_read(fds[0], &c, 1) != 1)
+        fprintf(stderr, "Waiting for the hangup of the pipe\n");
+        rc = pth_poll(&pfd, 1, -1);
+        FAILED_IF(rc != 1)
+        if (strcmp((char *)pth_ctrl(PTH_CTRL_GETBACKEND), "epoll") == 0)
+            FAILED_IF(pfd.revents != POLLHUP)
+        rc = pth_join(tid, NULL);
+        FAILED_IF(rc == FALSE)
+        FAILED_IF(pth_read(fds[0], &c, 1) != 0)
+        if (strcmp((char *)pth_ctrl(PTH_CTRL_GETBACKEND), "epoll") == 0) {
+            fprintf(stderr, "Waiting for a hangup without any events\n");
+            FAILED_IF(pth_close(fds[0]) == -1)
+            FAILED_IF(pipe(fds) == -1)
+            tid = pth_spawn(PTH_ATTR_DEFAULT, t9_func, (void *)(long)fds[1]);
+            FAILED_IF(tid == NULL)
+            pfd.fd     = fds[0];
+            pfd.events = 0;
+            rc = pth_poll(&pfd, 1, -1);
+            FAILED_IF(rc != 1 || pfd.revents != POLLHUP)
+            rc = pth_join(tid, NULL);
+            FAILED_IF(rc == FALSE)
+            pfd.events = POLLIN;
+        }
+        fprintf(stderr, "Polling a closed filedescriptor\n");
+        FAILED_IF(pth_close(fds[0]) == -1)
+        rc = pth_poll(&pfd, 1, -1);
+        FAILED_IF(rc != 1 || pfd.revents != POLLNVAL)
+    }
+
+    fprintf(stderr, "\n=== TESTING POSITIONED I/O ===\n\n");
+    {
+        pth_t tid[8];
+        char c;
+        int fd;
+        int rc;
+        int i;
+
+        fd = pth_open("test_std.tmp", O_CREAT|O_TRUNC|O_RDWR, 0600);
+        FAILED_IF(fd == -1)
+        fprintf(stderr, "Writing 8 blocks of a file concurrently\n");
+        for (i = 0; i < 8; i++) {
+            tid[i] = pth_spawn(PTH_ATTR_DEFAULT, t10_func, (void *)(((long)fd << 3) | i));
+            FAILED_IF(tid[i] == NULL)
+        }
+        for (i = 0; i < 8; i++) {
+            rc = pth_join(tid[i], NULL);
+            FAILED_IF(rc == FALSE)
+        }
+        FAILED_IF(lseek(fd, 0, SEEK_CUR) != 0)
+        fprintf(stderr, "Reading the 8 blocks concurrently\n");
+        for (i = 0; i < 8; i++) {
+            tid[i] = pth_spawn(PTH_ATTR_DEFAULT, t11_func, (void *)(((long)fd << 3) | i));
+            FAILED_IF(tid[i] == NULL)
+        }
+        for (i = 0; i < 8; i++) {
+            rc = pth_join(tid[i], NULL);
+            FAILED_IF(rc == FALSE)
+        }
+        FAILED_IF(lseek(fd, 0, SEEK_CUR) != 0)
+        fprintf(stderr, "Reading beyond the end of the file\n");
+        FAILED_IF(pth_pread(fd, &c, 1, 8*1024) != 0)
+        FAILED_IF(pth_pread(fd, &c, 1, -1) != -1 || errno != EINVAL)
+        FAILED_IF(pth_close(fd) == -1)
+        unlink("test_std.tmp");
+    }
+
+    fprintf(stderr, "\n=== TESTING ZERO-COPY TRANSFERS ===\n\n");
+    {
+        static char buf[256*1024];
+        pth_t tid;
+        off_t off;
+        int fds[2];
+        int pfds[2];
+        ssize_t n;
+        long total;
+        int fd;
+        int rc;
+        int i;
+
+        for (i = 0; i < sizeof(buf); i++)
+            buf[i] = (char)(i % 251);
+        fd = pth_open("test_std.tmp", O_CREAT|O_TRUNC|O_RDWR, 0600);
+        FAILED_IF(fd == -1)
+        FAILED_IF(pth_write(fd, buf, sizeof(buf)) != sizeof(buf))
+        FAILED_IF(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1)
+        fprintf(stderr, "Sending a file of 256 KB through a socket\n");
+        tid = pth_spawn(PTH_ATTR_DEFAULT, t12_func, (void *)(long)fds[1]);
+        FAILED_IF(tid == NULL)
+        off = 0;
+        n = pth_sendfile(fds[0], fd, &off, sizeof(buf));
+        FAILED_IF(n != sizeof(buf) || off != sizeof(buf))
+        rc = pth_join(tid, NULL);
+        FAILED_IF(rc == FALSE)
+        FAILED_IF(lseek(fd, 0, SEEK_CUR) != sizeof(buf))
+        fprintf(stderr, "Splicing 100 bytes from a socket into a pipe\n");
+        FAILED_IF(pipe(pfds) == -1)
+        tid = pth_spawn(PTH_ATTR_DEFAULT, t13_func, (void *)(long)fds[1]);
+        FAILED_IF(tid == NULL)
+        total = 0;
+        while ((n = pth_splice(fds[0], NULL, pfds[1], NULL, sizeof(buf), 0)) > 0)
+            total += n;
+        if (n == -1 && errno == ENOSYS)
+            fprintf(stderr, "(not supported on this platform)\n");
+        else {
+            FAILED_IF(n != 0 || total != 100)
+            fprintf(stderr, "Splicing 100 bytes from the pipe into a file\n");
+            off = 10;
+            n = pth_splice(pfds[0], NULL, fd, &off, 100, 0);
+            FAILED_IF(n != 100 || off != 110)
+            n = pth_pread(fd, buf, 20, 0);
+            FAILED_IF(n != 20 || memcmp(buf+10, "0123456789", 10) != 0)
+        }
+        fprintf(stderr, "Sending the end of the file from its position into the pipe\n");
+        FAILED_IF(lseek(fd, sizeof(buf)-10, SEEK_SET) == -1)
+        n = pth_sendfile(pfds[1], fd, NULL, 100);
+        FAILED_IF(n != 10 || lseek(fd, 0, SEEK_CUR) != sizeof(buf))
+        FAILED_IF(pth_read(pfds[0], buf, 100) != 10)
+        rc = pth_join(tid, NULL);
+        FAILED_IF(rc == FALSE)
+        FAILED_IF(pth_close(fds[0]) == -1)
+        FAILED_IF(pth_close(pfds[0]) == -1 || pth_close(pfds[1]) == -1)
+        FAILED_IF(pth_close(fd) == -1)
+        unlink("test_std.tmp");
+    }
+
+    fprintf(stderr, "\n=== TESTING CUSTOM EVENT FUNCTIONS ===\n\n");
+    {
+        pth_event_t ev;
+        int calls;
+        int rc;
+
+        fprintf(stderr, "Waiting for a function with a zero check interval\n");
+        calls = 0;
+        ev = pth_event(PTH_EVENT_FUNC, t14_func, &calls, pth_time(0,0));
+        FAILED_IF(ev == NULL)
+        rc = pth_wait(ev);
+        FAILED_IF(rc != 1 || calls != 3)
+        FAILED_IF(pth_event_status(ev) != PTH_STATUS_OCCURRED)
+        pth_event_free(ev, PTH_FREE_THIS);
+    }
+
+    fprintf(stderr, "\n=== TESTING SIGNAL MASKS OF WAITING THREADS ===\n\n");
+    {
+        struct sigaction sa, osa;
+        sigset_t ss, oss;
+        pth_t tid;
+        void *val;
+        int rc;
+
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = t20_handler;
+        sigemptyset(&sa.sa_mask);
+        FAILED_IF(sigaction(SIGUSR2, &sa, &osa) == -1)
+        sigemptyset(&ss);
+        sigaddset(&ss, SIGUSR2);
+        t20_caught = 0;
+
+        fprintf(stderr, "Delivering a signal blocked by main to a waiting thread with the default mask\n");
+        tid = pth_spawn(PTH_ATTR_DEFAULT, t20_func, NULL);
+        FAILED_IF(tid == NULL)
+        pth_yield(NULL);
+        FAILED_IF(pth_sigmask(SIG_BLOCK, &ss, &oss) != 0)
+        raise(SIGUSR2);
+        pth_nap(pth_time(0,10000));
+        FAILED_IF(t20_caught != 1)
+        rc = pth_join(tid, NULL);
+        FAILED_IF(rc == FALSE)
+
+        fprintf(stderr, "Delivering it to a waiting thread which changed its mask\n");
+        tid = pth_spawn(PTH_ATTR_DEFAULT, t20_func, &oss);
+        FAILED_IF(tid == NULL)
+        pth_yield(NULL);
+        raise(SIGUSR2);
+        pth_nap(pth_time(0,10000));
+        FAILED_IF(t20_caught != 2)
+        rc = pth_join(tid, NULL);
+        FAILED_IF(rc == FALSE)
+
+        fprintf(stderr, "Inheriting the signal mask of the creating thread\n");
+        tid = pth_spawn(PTH_ATTR_DEFAULT, t21_func, NULL);
+        FAILED_IF(tid == NULL)
+        rc = pth_join(tid, &val);
+        FAILED_IF(rc == FALSE || val != (void *)1)
+
+        FAILED_IF(pth_sigmask(SIG_SETMASK, &oss, NULL) != 0)
+        FAILED_IF(sigaction(SIGUSR2, &osa, NULL) == -1)
+    }
+
     pth_kill();
     fprintf(stderr, "\nOK - ALL TESTS SUCCESSFULLY PASSED.\n\n");
     exit(0);
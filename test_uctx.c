@@ -28,7 +28,9 @@
                                 they knew why cement works.''
                                                         -- Alan Cox */
 #include <stdio.h>
-#include <time.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <sys/time.h>
 
 #include "pth.h"
 
@@ -98,9 +100,9 @@ static void test_working(void)
 
 #define DO_SWITCHES 10000000
 
-time_t       stat_start;
-time_t       stat_end;
-volatile int stat_switched;
+struct timeval stat_start;
+struct timeval stat_end;
+volatile int   stat_switched;
 
 static void dummy(void *ctx)
 {
@@ -114,6 +116,7 @@ static void dummy(void *ctx)
 static void test_performance(void)
 {
     volatile int i;
+    double secs;
 
     pth_uctx_create((pth_uctx_t *)&uctx[0]);
     pth_uctx_create((pth_uctx_t *)&uctx[1]);
@@ -123,29 +126,85 @@ static void test_performance(void)
     fprintf(stderr, "Performing %d user-space context switches... "
             "be patient!\n", DO_SWITCHES);
 
-    stat_start = time(NULL);
+    gettimeofday(&stat_start, NULL);
     stat_switched = 0;
     for (i = 0; i < DO_SWITCHES; i++) {
         stat_switched++;
         pth_uctx_switch(uctx[0], uctx[1]);
     }
-    stat_end = time(NULL);
+    gettimeofday(&stat_end, NULL);
+    secs = (double)(stat_end.tv_sec - stat_start.tv_sec)
+           + (double)(stat_end.tv_usec - stat_start.tv_usec) / 1000000.0;
+    if (secs <= 0.0)
+        secs = 0.000001;
 
     pth_uctx_destroy(uctx[0]);
     pth_uctx_destroy(uctx[1]);
 
-    fprintf(stderr, "We required %d seconds for performing the test, "
-            "so this means we can\n", (int)(stat_end-stat_start));
-    fprintf(stderr, "perform %d user-space context switches per second "
-            "on this platform.\n", DO_SWITCHES/(int)(stat_end-stat_start));
+    fprintf(stderr, "We required %.2f seconds for performing the test, "
+            "so this means we can\n", secs);
+    fprintf(stderr, "perform %.0f user-space context switches per second "
+            "on this platform.\n", (double)DO_SWITCHES/secs);
     fprintf(stderr, "\n");
     return;
 }
 
+/*
+ *  Test 3: signal mask switching
+ */
+
+volatile int sigmask_blocked[2];
+
+static void sigmasked(void *ctx)
+{
+    sigset_t ss;
+
+    while (1) {
+        sigprocmask(SIG_SETMASK, NULL, &ss);
+        sigmask_blocked[1] = sigismember(&ss, SIGUSR1);
+        pth_uctx_switch(uctx[1], uctx[0]);
+    }
+    return;
+}
+
+static int test_sigmask(void)
+{
+    sigset_t ss;
+    volatile int i;
+    volatile int ok;
+
+    fprintf(stderr, "master: create context with SIGUSR1 blocked\n");
+    sigemptyset(&ss);
+    sigaddset(&ss, SIGUSR1);
+    pth_uctx_create((pth_uctx_t *)&uctx[0]);
+    pth_uctx_create((pth_uctx_t *)&uctx[1]);
+    pth_uctx_make(uctx[1], NULL, 32*1024, &ss, sigmasked, NULL, uctx[0]);
+
+    ok = TRUE;
+    for (i = 0; i < 3; i++) {
+        pth_uctx_switch(uctx[0], uctx[1]);
+        sigprocmask(SIG_SETMASK, NULL, &ss);
+        sigmask_blocked[0] = sigismember(&ss, SIGUSR1);
+        fprintf(stderr, "master: SIGUSR1 is %s in master and %s in context\n",
+                sigmask_blocked[0] ? "blocked" : "unblocked",
+                sigmask_blocked[1] ? "blocked" : "unblocked");
+        if (sigmask_blocked[0] || !sigmask_blocked[1])
+            ok = FALSE;
+    }
+
+    pth_uctx_destroy(uctx[0]);
+    pth_uctx_destroy(uctx[1]);
+    return ok;
+}
+
 int main(int argc, char *argv[])
 {
     test_working();
     test_performance();
+    if (!test_sigmask()) {
+        fprintf(stderr, "master: signal mask was not switched\n");
+        exit(1);
+    }
     return 0;
 }
 